@@ -0,0 +1,171 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <set>
+#include <optional>
+#include "../source/CookieJar.h"
+#include "LegacyCookieJar.h"
+
+namespace{
+    int failures = 0;
+
+    void check(bool passed, std::string_view what){
+        if(passed)
+            return;
+
+        failures++;
+        std::cerr << "CookieJar: " << what << std::endl;
+    }
+
+    int64_t now(){
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::optional<int64_t> expiresAt(bank_app::CookieJar& jar, std::string_view name){
+        for(auto& cookie : jar.all()){
+            if(cookie.name() == name)
+                return cookie.expiresAt;
+        }
+        return std::nullopt;
+    }
+
+    // the cookies of a BCA login and what each later page sets again
+    const std::vector<std::string> LOGIN_COOKIES = {
+            "JSESSIONID=0000a1B2c3D4e5F6g7H8i9J0kLmNoPqR:1a2b3c4d5; Path=/; Secure; HttpOnly",
+            "BIGipServerklikbca.com=1234567890.20480.0000; path=/; Httponly; Secure",
+            "TS01a2b3c4=01f2e3d4c5b6a79887766554433221100ffeeddccbbaa99887766; Path=/",
+            "__utma=123456789.987654321.1700000000.1700000000.1700000000.1; Path=/; Expires=Wed, 21 Oct 2037 07:28:00 GMT",
+            "lang=id; Path=/; Max-Age=31536000",
+            "ibcaSession=abcdef0123456789; Path=/; Secure",
+            "cpc=1; Path=/",
+            "tz=Asia-Jakarta; Path=/"
+    };
+    const std::string ROTATING_COOKIE = "TS01a2b3c4=01f2e3d4c5b6a79887766554433221100ffeeddccbbaa99887767; Path=/";
+
+    template<typename Jar>
+    double requestsPerCookieSet(std::size_t requests, std::size_t& sink){
+        auto start = std::chrono::steady_clock::now();
+        Jar jar;
+        for(auto& cookie : LOGIN_COOKIES){
+            jar.set(cookie);
+        }
+
+        // every request sends the Cookie header, one in ten answers rotates a cookie
+        for(std::size_t i = 0; i < requests; i++){
+            sink += jar.toString().size();
+            if(i % 10 == 9)
+                jar.set(i % 20 == 19 ? ROTATING_COOKIE : LOGIN_COOKIES[2]);
+        }
+
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / requests;
+    }
+
+    template<typename Jar>
+    double loginsPerSecond(std::size_t logins, std::size_t& sink){
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < logins; i++){
+            Jar jar;
+            for(auto& cookie : LOGIN_COOKIES){
+                jar.set(cookie);
+            }
+            sink += jar.toString().size();
+        }
+
+        return logins / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(){
+    // date parsing, both forms BCA sends
+    {
+        bank_app::CookieJar jar;
+        jar.set("a=1; Expires=Wed, 21 Oct 2037 07:28:00 GMT");
+        jar.set("b=1; expires=Wed, 21-Oct-37 07:28:00 GMT");
+        jar.set("c=1; Expires=not a date");
+        check(expiresAt(jar, "a") == 2139722880, "Expires in the IMF form");
+        check(expiresAt(jar, "b") == 2139722880, "Expires in the dashed form with a two digit year");
+        check(expiresAt(jar, "c") == bank_app::CookieData::SESSION, "an unreadable Expires leaves a session cookie");
+
+        auto lines = jar.serialize();
+        check(!lines.empty() && lines[0] == "a=1; Expires=Wed, 21 Oct 2037 07:28:00 GMT", "Expires written back in the IMF form");
+    }
+
+    // Max-Age wins over Expires, in either order
+    {
+        bank_app::CookieJar jar;
+        auto before = now();
+        jar.set("a=1; Max-Age=60; Expires=Thu, 01 Jan 1970 00:00:00 GMT");
+        jar.set("b=1; Expires=Thu, 01 Jan 1970 00:00:00 GMT; Max-Age=60");
+        jar.set("c=1; Expires=Wed, 21 Oct 2037 07:28:00 GMT; Max-Age=60");
+        for(auto name : {"a", "b", "c"}){
+            auto at = expiresAt(jar, name);
+            check(at && *at >= before + 60 && *at <= now() + 60, std::string("Max-Age before Expires for ") + name);
+        }
+    }
+
+    // a cookie set to expire deletes the stored one
+    {
+        bank_app::CookieJar jar;
+        jar.set("a=1; Path=/");
+        jar.set("b=2; Path=/");
+        jar.set("c=3; Path=/");
+        jar.set("a=; Max-Age=0");
+        jar.set("b=; Expires=Thu, 01 Jan 1970 00:00:00 GMT");
+        check(jar.toString() == "c=3", "Max-Age=0 and a past Expires delete the cookie");
+    }
+
+    // the header is rebuilt only on a change and keeps what the values hold
+    {
+        bank_app::CookieJar jar;
+        jar.set("a=x=y==; Path=/");
+        jar.set("b=MiXeD; Path=/");
+        check(jar.toString() == "a=x=y==; b=MiXeD", "values keep '=' and their case");
+
+        auto version = jar.version();
+        jar.set("b=MiXeD; Path=/");
+        check(jar.version() == version, "setting the same cookie again changes nothing");
+        jar.set("b=other; Path=/");
+        check(jar.version() != version && jar.toString() == "a=x=y==; b=other", "a changed value rebuilds the header");
+    }
+
+    // the old jar sends the same cookies for the login set
+    {
+        bank_app::CookieJar jar;
+        bank_app::legacy::CookieJar legacy;
+        for(auto& cookie : LOGIN_COOKIES){
+            jar.set(cookie);
+            legacy.set(cookie);
+        }
+
+        auto pairs = [](std::string header){
+            std::set<std::string> result;
+            std::size_t start = 0;
+            while(start < header.size()){
+                auto end = header.find("; ", start);
+                result.insert(header.substr(start, end - start));
+                start = end == std::string::npos ? header.size() : end + 2;
+            }
+            return result;
+        };
+        check(pairs(jar.toString()) == pairs(legacy.toString()), "the Cookie header differs from the old jar");
+    }
+
+    if(failures > 0)
+        return 1;
+    std::cout << "CookieJar: all checks passed" << std::endl;
+
+    std::size_t sink = 0;
+    auto requests = 200000;
+    auto logins = 50000;
+    std::cout << "Cookie header per request, ns: flat " << requestsPerCookieSet<bank_app::CookieJar>(requests, sink)
+              << ", old " << requestsPerCookieSet<bank_app::legacy::CookieJar>(requests, sink) << std::endl;
+    std::cout << "logins per second: flat " << loginsPerSecond<bank_app::CookieJar>(logins, sink)
+              << ", old " << loginsPerSecond<bank_app::legacy::CookieJar>(logins, sink) << std::endl;
+
+    return sink == 0 ? 1 : 0;
+}
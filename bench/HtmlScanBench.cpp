@@ -0,0 +1,230 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <boost/asio/buffer.hpp>
+#include "../source/HtmlParser.h"
+#include "../source/HtmlTokenScanner.h"
+
+#ifndef BANK_APP_BENCH_FIXTURES
+#define BANK_APP_BENCH_FIXTURES "fixtures"
+#endif
+
+namespace{
+    int failures = 0;
+
+    const std::string BALANCE_SELECTOR = "td[align='right'] b";
+    const std::string KEYBCA_ERROR = "ANGKA YANG ANDA MASUKKAN DARI KEYBCA ANDA SALAH.";
+
+    void check(bool passed, std::string_view what){
+        if(passed)
+            return;
+
+        failures++;
+        std::cerr << "HtmlTokenScanner: " << what << std::endl;
+    }
+
+    std::string fixture(std::string_view name){
+        std::ifstream file(std::string(BANK_APP_BENCH_FIXTURES) + "/" + std::string(name), std::ios::binary);
+        if(!file)
+            throw std::runtime_error("missing fixture " + std::string(name));
+
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    // a response body as it arrives, in pieces, counting the pieces the scanner asked for
+    class ChunkedBody{
+        std::vector<boost::asio::const_buffer> chunks_;
+        std::size_t* read_;
+
+    public:
+        class iterator{
+            const boost::asio::const_buffer* at_;
+            std::size_t* read_;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = boost::asio::const_buffer;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const boost::asio::const_buffer*;
+            using reference = const boost::asio::const_buffer&;
+
+            iterator(const boost::asio::const_buffer* at, std::size_t* read) : at_(at), read_(read){
+            }
+
+            reference operator*() const {
+                ++*read_;
+                return *at_;
+            }
+
+            iterator& operator++(){
+                ++at_;
+                return *this;
+            }
+
+            bool operator==(const iterator& other) const {
+                return at_ == other.at_;
+            }
+
+            bool operator!=(const iterator& other) const {
+                return at_ != other.at_;
+            }
+        };
+
+        ChunkedBody(std::string_view page, std::size_t chunkSize, std::size_t* read) : read_(read){
+            for(std::size_t offset = 0; offset < page.size(); offset += chunkSize){
+                chunks_.emplace_back(page.data() + offset, std::min(chunkSize, page.size() - offset));
+            }
+        }
+
+        std::size_t size() const {
+            return chunks_.size();
+        }
+
+        iterator begin() const {
+            return iterator(chunks_.data(), read_);
+        }
+
+        iterator end() const {
+            return iterator(chunks_.data() + chunks_.size(), read_);
+        }
+    };
+
+    // what getBalance did before the scanner, the whole DOM and a selector query over it
+    std::optional<std::string> domBalance(std::string page){
+        lxb_char_t cssNeedle[] = "td[align='right'] b";
+        auto pageParser = std::make_unique<bank_app::HtmlParser>(lxb_string(reinterpret_cast<lxb_char_t*>(page.data()), page.size()));
+
+        auto htmlResult = pageParser->css(cssNeedle)->toArrayString();
+        if(htmlResult->empty())
+            return std::nullopt;
+
+        auto& lineStr = htmlResult->at(0);
+        return std::string(reinterpret_cast<char*>(lineStr.data()), lineStr.size());
+    }
+
+    std::optional<std::string> scannedBalance(std::string_view page){
+        bank_app::HtmlTokenScanner pageScanner;
+        auto balance = pageScanner.text(BALANCE_SELECTOR);
+        pageScanner.scan(page);
+        return pageScanner[balance];
+    }
+
+    bool scannedError(std::string_view page){
+        bank_app::HtmlTokenScanner pageScanner;
+        pageScanner.contains(KEYBCA_ERROR);
+        return pageScanner.scan(page);
+    }
+
+    bool compiles(std::string_view selector){
+        try{
+            bank_app::HtmlTokenScanner pageScanner;
+            pageScanner.text(selector);
+            return true;
+        }
+        catch(bank_app::lexbor_exception&){
+            return false;
+        }
+    }
+
+    template<typename Extract>
+    double microsecondsPerPage(std::size_t pages, Extract extract){
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < pages; i++){
+            extract();
+        }
+
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / pages;
+    }
+}
+
+int main(){
+    auto balancePage = fixture("balance.html");
+    auto expiredPage = fixture("session_expired.html");
+    auto errorPage = fixture("transfer_keybca_error.html");
+    auto confirmPage = fixture("transfer_confirm.html");
+
+    // the selector subset, anything outside it is refused instead of matching something else
+    for(auto selector : {"td[align='right'] b", "td[align=\"right\"] > font > b", "table tr > td[align=right]",
+                         "input[name='value(respondAppli1)'][type]", "B", "td[ALIGN=right]"}){
+        check(compiles(selector), "refused " + std::string(selector));
+    }
+    for(auto selector : {"", " ", ">", "td >", "> b", "td > > b", "td[", "td[align='right]", "td[=right]",
+                         "td.amount", "#saldo", "td, b"}){
+        check(!compiles(selector), "accepted \"" + std::string(selector) + "\"");
+    }
+
+    // the same answers as the DOM path on every page
+    for(auto page : {&balancePage, &expiredPage, &errorPage, &confirmPage}){
+        auto scanned = scannedBalance(*page);
+        auto dom = domBalance(*page);
+        check(scanned == dom, "balance differs from the DOM, scanned \"" + scanned.value_or("none") + "\", DOM \"" +
+                              dom.value_or("none") + "\"");
+        check(scannedError(*page) == (page->find(KEYBCA_ERROR) != std::string::npos), "KeyBCA error differs from the page");
+    }
+    check(scannedBalance(balancePage) == "12,345,678.90", "balance of the balance page");
+    check(!scannedBalance(expiredPage), "balance on an expired session");
+
+    // combinators are exact, a <b> inside a <span> is no child of the cell
+    {
+        auto nested = "<table><tr><td align='right'><span><b>1</b></span></td><td align='right'><b>2</b></td></tr></table>";
+        bank_app::HtmlTokenScanner pageScanner;
+        auto child = pageScanner.text("td[align='right'] > b");
+        auto descendant = pageScanner.text("td[align='right'] b");
+        auto attribute = pageScanner.attribute("td[align] > span", "align");
+        pageScanner.scan(nested);
+        check(pageScanner[child] == "2", "child combinator");
+        check(pageScanner[descendant] == "1", "descendant combinator");
+        check(!pageScanner[attribute], "attribute of an element without it");
+    }
+
+    // the scan stops at the last field, the rest of the body is never read
+    {
+        std::size_t read = 0;
+        ChunkedBody body(balancePage, 512, &read);
+        bank_app::HtmlTokenScanner pageScanner;
+        auto balance = pageScanner.text(BALANCE_SELECTOR);
+        check(pageScanner.scanBuffers(body), "balance found in a chunked body");
+        check(pageScanner[balance] == "12,345,678.90", "balance of a chunked body");
+        check(read > 0 && read < body.size() / 2, "stopped after " + std::to_string(read) + " of " + std::to_string(body.size()) +
+                                                  " chunks");
+
+        read = 0;
+        ChunkedBody missing(expiredPage, 512, &read);
+        check(!pageScanner.scanBuffers(missing) && read == missing.size(), "a page without the balance is read to the end");
+    }
+
+    // the error sentence split between two pieces of the body
+    {
+        auto at = errorPage.find(KEYBCA_ERROR) + KEYBCA_ERROR.size() / 2;
+        std::vector<boost::asio::const_buffer> body{{errorPage.data(), at}, {errorPage.data() + at, errorPage.size() - at}};
+        bank_app::HtmlTokenScanner pageScanner;
+        pageScanner.contains(KEYBCA_ERROR);
+        check(pageScanner.scanBuffers(body), "error sentence across two buffers");
+    }
+
+    if(failures > 0)
+        return 1;
+    std::cout << "HtmlTokenScanner: all checks passed" << std::endl;
+
+    std::size_t pages = 2000;
+    std::size_t sink = 0;
+    std::cout << "balance, us per page: scanner " << microsecondsPerPage(pages, [&]{ sink += scannedBalance(balancePage)->size(); })
+              << ", DOM " << microsecondsPerPage(pages, [&]{ sink += domBalance(balancePage)->size(); }) << std::endl;
+    std::cout << "no balance, us per page: scanner " << microsecondsPerPage(pages, [&]{ sink += scannedBalance(expiredPage).has_value(); })
+              << ", DOM " << microsecondsPerPage(pages, [&]{ sink += domBalance(expiredPage).has_value(); }) << std::endl;
+    std::cout << "KeyBCA error, us per page: scanner " << microsecondsPerPage(pages, [&]{ sink += scannedError(confirmPage); })
+              << ", string search " << microsecondsPerPage(pages, [&]{ sink += confirmPage.find(KEYBCA_ERROR) != std::string::npos; })
+              << std::endl;
+
+    return sink == 0 ? 1 : 0;
+}
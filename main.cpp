@@ -1,107 +1,697 @@
 #include <thread>
 #include <string>
 #include <memory>
+#include <charconv>
+#include <optional>
+#include <cstdlib>
 #include "source/BcaBank.h"
 #include "source/HttpServer.h"
 #include "source/Utility.h"
-#include "source/UUIDGenerator.h"
+#include "source/ClusterRing.h"
+#include "source/TokenService.h"
+#include "source/SessionRegistry.h"
+#include "source/SessionRefresher.h"
+#include "source/SessionEvictor.h"
+#include "source/TransferJournal.h"
+#include "source/WarmSessionPool.h"
+#include "source/ProcessHandoff.h"
+#include "source/FeedHub.h"
+#include "source/Logger.h"
+#include "source/MemoryAccounting.h"
+#include "source/CpuBudget.h"
+#include "source/ConfigFile.h"
 
 int main() {
 
-    auto uuidGen = std::make_unique<bank_app::UUIDGenerator>();
-    auto clientIoc = std::make_unique<boost::asio::io_context>(1);
-    auto serverIoc = std::make_unique<boost::asio::io_context>(std::thread::hardware_concurrency());
-    const unsigned short port = 80;
+    // log records are drained to stderr or BANK_APP_LOG_PATH by a background thread
+    auto logPath = bank_app::Utility::getEnv("BANK_APP_LOG_PATH");
+    if (!logPath.empty() && !bank_app::Logger::instance().open(logPath))
+        bank_app::Logger::warn("log", "can not open, logging to stderr", logPath);
+
+    // Session tokens carry their own MAC, forged or expired ones never reach the registry. Replicas only
+    // accept each other's tokens under a shared BANK_APP_TOKEN_KEY, checked before a running process is
+    // asked to hand over. The key also has to outlive a restart for the snapshot to be of use.
+    const auto tokenKey = bank_app::Utility::getEnv("BANK_APP_TOKEN_KEY");
+    if (tokenKey.empty() && !bank_app::Utility::getEnv("BANK_APP_PEERS").empty()) {
+        bank_app::Logger::error("session_token", "BANK_APP_PEERS is set without BANK_APP_TOKEN_KEY, not starting");
+        bank_app::Logger::instance().flush();
+        return 1;
+    }
+    if (tokenKey.empty())
+        bank_app::Logger::warn("session_token", "BANK_APP_TOKEN_KEY unset, tokens are valid in this process only");
+
+    // Pools are sized from the CPU the cgroup grants, not the cores of the host. The sizes come from the
+    // BANK_APP_CONFIG_PATH file, else the environment, and are applied again whenever the file changes.
+    const auto cpuBudget = bank_app::CpuBudget::detect();
+    const auto configPath = bank_app::Utility::getEnv("BANK_APP_CONFIG_PATH");
+    bank_app::ConfigFile config(configPath);
+    auto poolSize = [&](const std::string& key, const char* environment, std::size_t fallback) {
+        return std::max<std::size_t>(std::stoul(config.get(key, environment, std::to_string(fallback))), 1);
+    };
+    // Route handlers block their server thread on a session mailbox or a forwarded peer for a whole upstream
+    // round trip, so the server pool is sized for waiting rather than for the CPU: a thread for every session
+    // worker a handler may wait on, plus one per CPU for what never waits, /ping and /metrics among it.
+    // The server threads include the one calling HttpServer::run.
+    const auto sessionWorkersDefault = std::max(2u * cpuBudget.effective, 8u);
+    auto serverThreadsDefault = [&] {
+        return poolSize("session_workers", "BANK_APP_SESSION_WORKERS", sessionWorkersDefault) + cpuBudget.effective;
+    };
+    const auto serverThreads = poolSize("server_threads", "BANK_APP_SERVER_THREADS", serverThreadsDefault());
+    const auto clientThreads = poolSize("client_threads", "BANK_APP_CLIENT_THREADS", 2);
+
+    // BANK_APP_PIN_THREADS=1 pins the I/O threads round robin to the CPUs of the budget, server first
+    std::vector<int> serverCpus, clientCpus;
+    if (bank_app::Utility::getEnv("BANK_APP_PIN_THREADS", "0") == "1") {
+        serverCpus = clientCpus = cpuBudget.pinnable();
+        std::rotate(clientCpus.begin(), clientCpus.begin() + serverThreads % clientCpus.size(), clientCpus.end());
+    }
+    bank_app::Logger::info("cpu_budget", cpuBudget.describe(),
+                           "server threads " + std::to_string(serverThreads) + ", client threads " + std::to_string(clientThreads));
+
+    // a hint of 1 tells asio a single thread runs the context, a reload may add more
+    auto clientIoc = std::make_unique<boost::asio::io_context>(std::max<std::size_t>(clientThreads, 2));
+    auto serverIoc = std::make_unique<boost::asio::io_context>(std::max<std::size_t>(serverThreads, 2));
+    bank_app::IoThreads serverRunner(*serverIoc, serverThreads - 1, serverCpus);
+    const unsigned short port = std::stoi(bank_app::Utility::getEnv("BANK_APP_PORT", "80"));
+
+    // A running process serving the handoff socket gives its listening sockets over and keeps accepting on
+    // them until this one is ready, then drains and exits. Only then are the snapshot and journal free to
+    // open, its sessions resume from the snapshot. Between its drain and our first accept nobody accepts,
+    // connections wait in the backlog for up to the drain window plus our restore.
+    const auto handoffPath = bank_app::Utility::getEnv("BANK_APP_HANDOFF_SOCKET");
+    const auto drainTimeout = std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_DRAIN_SECONDS", "10")));
+    std::unique_ptr<bank_app::HandoffTakeover> takeover;
+    std::optional<std::vector<bank_app::InheritedListener>> inheritedListeners;
+    if (!handoffPath.empty()) {
+        try {
+            takeover = bank_app::ProcessHandoff::takeOver(handoffPath);
+        }
+        catch (std::exception& err) {
+            bank_app::Logger::error("handoff", "take over failed", err.what());
+        }
+    }
+
+    // upstream I/O of every session runs here, request threads wait on it with their deadline
+    bank_app::IoThreads clientRunner(*clientIoc, clientThreads, clientCpus);
+    bank_app::KtlsStream::enable(bank_app::Utility::getEnv("BANK_APP_KTLS", "0") == "1");
+    bank_app::HttpClient::pipelining().enable(bank_app::Utility::getEnv("BANK_APP_UPSTREAM_PIPELINING", "1") == "1");
+    bank_app::BcaBank::balanceHedge().enable(bank_app::Utility::getEnv("BANK_APP_HEDGE_BALANCE", "0") == "1");
     const std::string defaultSeparator = ";;";
 
-    std::unordered_map<std::string, std::shared_ptr<bank_app::BcaBank>> bcaInsts;
+    // cluster membership, e.g. BANK_APP_PEERS="node-a=127.0.0.1:8081,node-b=127.0.0.1:8082", an entry ending
+    // in "=bank-a.example.com" names the address clients reach the node at, event streams are redirected there
+    bank_app::ClusterRing ring(bank_app::Utility::getEnv("BANK_APP_NODE_ID", "node-" + std::to_string(port)));
+    ring.setMembers(bank_app::ClusterRing::parseMembers(bank_app::Utility::getEnv("BANK_APP_PEERS")));
+
+    // everything up to here runs while the previous process still serves, what follows needs its locks
+    if (takeover) {
+        inheritedListeners = takeover->listeners();
+        try {
+            takeover->ready(drainTimeout + std::chrono::seconds(10));
+        }
+        catch (std::exception& err) {
+            bank_app::Logger::error("handoff", "take over failed", err.what());
+        }
+        takeover.reset();
+    }
+
+    // sessions are checkpointed so a restart resumes them instead of logging everyone in again
+    std::unique_ptr<bank_app::SessionSnapshot> snapshot;
+    try {
+        snapshot = std::make_unique<bank_app::SessionSnapshot>(
+                bank_app::Utility::getEnv("BANK_APP_SNAPSHOT_PATH", "sessions-" + ring.selfId() + ".snap"),
+                bank_app::Utility::getEnv("BANK_APP_SNAPSHOT_KEY"));
+    }
+    catch (std::exception& err) {
+        bank_app::Logger::warn("session_snapshot", "disabled", err.what());
+    }
+
+    // operations on one session run in order through its mailbox, on a worker pool shared by all sessions
+    bank_app::SessionExecutorConfig executorConfig;
+    executorConfig.workers = poolSize("session_workers", "BANK_APP_SESSION_WORKERS", sessionWorkersDefault);
+    executorConfig.maxQueue = std::stoul(bank_app::Utility::getEnv("BANK_APP_SESSION_QUEUE", "32"));
+    bank_app::SessionExecutor sessionExecutor(executorConfig);
+
+    const bank_app::TokenService tokens(tokenKey,
+            std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_TOKEN_TTL_SECONDS", "86400"))));
+
+    bank_app::SessionRegistry bcaInsts(*clientIoc, sessionExecutor, snapshot.get(), &tokens);
+
+    // transfers with an idempotency key are journaled so a retried request never transfers twice, completed
+    // keys are forgotten after the retention which has to outlast the retries of the clients
+    std::unique_ptr<bank_app::TransferJournal> journal;
+    try {
+        journal = std::make_unique<bank_app::TransferJournal>(
+                bank_app::Utility::getEnv("BANK_APP_JOURNAL_PATH", "transfers-" + ring.selfId() + ".journal"),
+                std::chrono::hours(std::stoi(bank_app::Utility::getEnv("BANK_APP_JOURNAL_RETENTION_HOURS", "72"))));
+    }
+    catch (std::exception& err) {
+        bank_app::Logger::warn("transfer_journal", "disabled", err.what());
+    }
+
+    // logins are renewed in the background shortly before BCA expires them
+    bank_app::SessionRefresherConfig refresherConfig;
+    refresherConfig.lead = std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_REFRESH_LEAD_SECONDS", "45")));
+    refresherConfig.jitter = std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_REFRESH_JITTER_SECONDS", "30")));
+    refresherConfig.ratePerSecond = std::stod(bank_app::Utility::getEnv("BANK_APP_REFRESH_RATE", "5"));
+
+    bank_app::SessionRefresher refresher([&](const std::string& token) {
+        return bcaInsts.refresh(token);
+    }, refresherConfig);
+
+    bcaInsts.setLoginObserver([&](const std::string& token, std::chrono::system_clock::time_point expiry) {
+        refresher.schedule(token, expiry);
+    });
+
+    // idle or excess sessions are evicted and logged out upstream in batches
+    bank_app::SessionLimits sessionLimits;
+    sessionLimits.maxSessions = std::stoul(bank_app::Utility::getEnv("BANK_APP_MAX_SESSIONS", "10000"));
+    sessionLimits.memoryBudget = std::stoul(bank_app::Utility::getEnv("BANK_APP_SESSION_MEMORY_MB", "512")) * 1024 * 1024;
+    sessionLimits.idleTtl = std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_SESSION_IDLE_SECONDS", "1800")));
+
+    // past a budget the sweep sheds the oldest sessions and new logins are turned away, 0 disables one
+    bank_app::MemoryBudgets memoryBudgets;
+    memoryBudgets.process = std::stoul(bank_app::Utility::getEnv("BANK_APP_MEMORY_LIMIT_MB", "0")) * 1024 * 1024;
+    memoryBudgets.lexbor = std::stoul(bank_app::Utility::getEnv("BANK_APP_LEXBOR_MEMORY_MB", "0")) * 1024 * 1024;
+    memoryBudgets.openssl = std::stoul(bank_app::Utility::getEnv("BANK_APP_OPENSSL_MEMORY_MB", "0")) * 1024 * 1024;
+
+    bank_app::SessionEvictorConfig evictorConfig;
+    evictorConfig.batchSize = std::stoul(bank_app::Utility::getEnv("BANK_APP_LOGOUT_BATCH", "10"));
+
+    bank_app::SessionEvictor evictor(evictorConfig);
+    bcaInsts.setLimits(sessionLimits);
+    bcaInsts.setEvictionHandler([&](std::shared_ptr<bank_app::BcaBank> bank, std::shared_ptr<bank_app::SessionMailbox> mailbox) {
+        evictor.enqueue(std::move(bank), std::move(mailbox));
+    });
+    // the usage before the last round of evictions, shedding stops while the sessions evicted since gave nothing back
+    std::optional<std::pair<std::string_view, std::size_t>> lastShed;
+    evictor.setSweep([&] {
+        bcaInsts.sweepIdle();
+
+        if (journal) {
+            try {
+                journal->maintain();
+            }
+            catch (std::exception& err) {
+                bank_app::Logger::warn("transfer_journal", "compaction failed", err.what());
+            }
+        }
+
+        auto exceeded = bank_app::MemoryAccounting::overBudget(memoryBudgets);
+        if (exceeded.empty()) {
+            lastShed.reset();
+            return;
+        }
+
+        auto usage = bank_app::MemoryAccounting::usage(exceeded);
+        if (lastShed && lastShed->first == exceeded && usage >= lastShed->second)
+            return;
+
+        auto gauges = bcaInsts.gauges();
+        auto evicted = bcaInsts.evictOldest(std::max<std::size_t>((gauges.resident + gauges.pendingRestore) / 20, 1));
+        bank_app::MemoryAccounting::trim();
+        lastShed.emplace(exceeded, usage);
+
+        if (evicted > 0)
+            bank_app::Logger::warn("memory_budget", std::string(exceeded) + " over budget, evicted sessions",
+                                   std::to_string(evicted));
+    });
+
+    // sessions which already fetched the login page, a login then only posts the credentials
+    bank_app::WarmSessionPoolConfig warmConfig;
+    warmConfig.minSize = std::stoul(bank_app::Utility::getEnv("BANK_APP_WARM_MIN", "1"));
+    warmConfig.maxSize = std::stoul(bank_app::Utility::getEnv("BANK_APP_WARM_MAX", "32"));
+    warmConfig.ttl = std::chrono::seconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_WARM_TTL_SECONDS", "20")));
+
+    bank_app::WarmSessionPool warmSessions([&] {
+        auto bcaInst = std::make_shared<bank_app::BcaBank>(*clientIoc);
+        bcaInst->prepareLogin();
+        return bcaInst;
+    }, warmConfig);
+
+    // clients subscribed to /feed share one poll of their session, the interval follows how often it changes
+    bank_app::FeedHubConfig feedConfig;
+    feedConfig.minInterval = std::chrono::milliseconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_FEED_MIN_INTERVAL_MS", "3000")));
+    feedConfig.maxInterval = std::chrono::milliseconds(std::stoi(bank_app::Utility::getEnv("BANK_APP_FEED_MAX_INTERVAL_MS", "30000")));
+
+    bank_app::FeedHub feedHub([&](const std::string& token) -> std::optional<bank_app::FeedSnapshot> {
+        // since yesterday, a credit of the last hours may still carry the date before
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+        auto start = std::to_string((now - std::chrono::hours(24)).count());
+        auto end = std::to_string(now.count());
+
+        return bcaInsts.use(token, [&](bank_app::BcaBank& bcaInst) {
+            bank_app::FeedSnapshot snapshot;
+            snapshot.balance = bcaInst.getBalance();
+            for (auto& row : bcaInst.getStatements(start, end)) {
+                snapshot.rows.emplace_back(row);
+            }
+            return snapshot;
+        });
+    }, feedConfig);
+
+    auto restoredSessions = bcaInsts.restore();
     auto serv = std::make_unique<bank_app::HttpServer>(*serverIoc, port);
 
-    serv->setEvent("/ping", [&](std::string payload) -> std::string {
-        return "ok";
+    // clients reach /login over HTTPS directly, BANK_APP_TLS_TICKET_KEYS is shared by the replicas
+    auto tlsCertificate = bank_app::Utility::getEnv("BANK_APP_TLS_CERT");
+    if (!tlsCertificate.empty()) {
+        try {
+            serv->enableTls(std::stoi(bank_app::Utility::getEnv("BANK_APP_TLS_PORT", "443")),
+                            std::make_unique<bank_app::TlsServerContext>(
+                                    tlsCertificate,
+                                    bank_app::Utility::getEnv("BANK_APP_TLS_KEY"),
+                                    bank_app::Utility::getEnv("BANK_APP_TLS_TICKET_KEYS")));
+        }
+        catch (std::exception& err) {
+            bank_app::Logger::warn("tls", "disabled", err.what());
+        }
+    }
+
+    if (inheritedListeners)
+        serv->adoptListeners(*inheritedListeners);
+
+    // /admin/ and /cluster/ need BANK_APP_ADMIN_KEY as a bearer token, without one they are closed
+    bank_app::AdminAccess::setKey(bank_app::Utility::getEnv("BANK_APP_ADMIN_KEY"));
+
+    // the token of a /feed subscription, token=...&... or the bare token
+    auto feedToken = [](std::string_view payload) {
+        if (payload.starts_with("token="))
+            payload.remove_prefix(6);
+
+        return std::string(payload.substr(0, payload.find('&')));
+    };
+
+    serv->setRouter([&](std::string_view target, std::string_view body, int hops) -> bank_app::RouteDecision {
+        bank_app::RouteDecision decision;
+
+        if (target == "/ping" || target == "/login" || target == "/metrics" || bank_app::AdminAccess::covers(target))
+            return decision;
+
+        // a token no replica could have minted is answered here instead of asking every peer
+        auto token = target == "/feed" ? feedToken(body) : std::string(body.substr(0, body.find(defaultSeparator)));
+        if (!tokens.verify(token) || bcaInsts.contains(token))
+            return decision;
+
+        // only the replica which received the request from the client fans out
+        if (hops > 0) {
+            decision.misdirected = true;
+            return decision;
+        }
+
+        for (auto& node : ring.candidates(token)) {
+            decision.peers.push_back({node.host, node.port, node.publicAddress});
+        }
+
+        return decision;
     });
 
-    serv->setEvent("/login", [&](std::string payload) -> std::string {
-        auto cred = bank_app::Utility::split(payload, defaultSeparator);
-        std::string loginResult = "-1";
+    serv->setEvent("/metrics", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto gauges = bcaInsts.gauges();
+        auto bytesPerSession = gauges.resident + gauges.pendingRestore > 0 ? gauges.bytes / (gauges.resident + gauges.pendingRestore) : 0;
+        auto& arenaUpstream = bank_app::ArenaUpstream::instance();
+
+        std::pmr::string metrics(context.arena);
+        auto gauge = [&](std::string_view name, uint64_t value) {
+            metrics.append(name).append(" ").append(std::to_string(value)).append("\n");
+        };
+
+        gauge("bank_app_io_backend{backend=\"" + std::string(bank_app::IO_BACKEND) + "\"}", 1);
+        gauge("bank_app_sessions_resident", gauges.resident);
+        gauge("bank_app_sessions_pending_restore", gauges.pendingRestore);
+        gauge("bank_app_session_bytes_total", gauges.bytes);
+        gauge("bank_app_session_bytes_avg", bytesPerSession);
+        gauge("bank_app_sessions_evicted_total", gauges.evicted);
+        gauge("bank_app_tokens_minted_total", tokens.minted());
+        // every check turning a token away counts, a request may check its token more than once
+        gauge("bank_app_token_rejections_total", tokens.rejected());
+        gauge("bank_app_evicted_logouts_pending", evictor.pending());
+        gauge("bank_app_evicted_logouts_total", evictor.loggedOut());
+        gauge("bank_app_refreshes_scheduled", refresher.scheduled());
+        auto feeds = feedHub.gauges();
+        gauge("bank_app_feeds", feeds.feeds);
+        gauge("bank_app_feed_subscribers", feeds.subscribers);
+        gauge("bank_app_feed_polls_total", feeds.polls);
+        gauge("bank_app_feed_poll_failures_total", feeds.pollFailures);
+        gauge("bank_app_feed_events_total", feeds.events);
+        gauge("bank_app_log_records_dropped_total", bank_app::Logger::instance().dropped());
+        auto mailboxes = sessionExecutor.gauges();
+        gauge("bank_app_cpu_effective", cpuBudget.effective);
+        gauge("bank_app_cpu_quota_millicores", static_cast<uint64_t>(cpuBudget.quota * 1000));
+        gauge("bank_app_server_threads", serverRunner.size() + 1);
+        gauge("bank_app_client_threads", clientRunner.size());
+        gauge("bank_app_session_workers", sessionExecutor.size());
+        gauge("bank_app_session_ops_queued", mailboxes.queued);
+        gauge("bank_app_session_workers_busy", mailboxes.busyWorkers);
+        gauge("bank_app_session_ops_total", mailboxes.completed);
+        gauge("bank_app_session_ops_rejected_total", mailboxes.rejected);
+        gauge("bank_app_session_ops_expired_total", mailboxes.expired);
+        gauge("bank_app_session_op_wait_microseconds_total", mailboxes.waitMicros);
+        gauge("bank_app_session_op_wait_microseconds_max", mailboxes.maxWaitMicros);
+        auto warm = warmSessions.gauges();
+        gauge("bank_app_warm_sessions_idle", warm.idle);
+        gauge("bank_app_warm_sessions_target", warm.target);
+        gauge("bank_app_warm_session_hits_total", warm.hits);
+        gauge("bank_app_warm_session_misses_total", warm.misses);
+        gauge("bank_app_warm_sessions_expired_total", warm.expired);
+        if (journal) {
+            gauge("bank_app_transfer_journal_keys", journal->size());
+            gauge("bank_app_transfer_journal_records_total", journal->records());
+            gauge("bank_app_transfer_journal_syncs_total", journal->syncs());
+            gauge("bank_app_transfer_journal_compactions_total", journal->compactions());
+        }
+        gauge("bank_app_upstream_pipelined_total", bank_app::HttpClient::pipelining().pipelined());
+        gauge("bank_app_upstream_pipelining_fallbacks_total", bank_app::HttpClient::pipelining().fallbacks());
+        gauge("bank_app_upstream_pipelining_enabled", bank_app::HttpClient::pipelining().enabled());
+        gauge("bank_app_balance_hedged_total", bank_app::BcaBank::balanceHedge().hedged());
+        gauge("bank_app_balance_hedge_wins_total", bank_app::BcaBank::balanceHedge().backupWins());
+        auto& ktls = bank_app::KtlsStream::stats();
+        gauge("bank_app_ktls_handshakes_total", ktls.handshakes);
+        gauge("bank_app_ktls_send_offloaded_total", ktls.kernelSend);
+        gauge("bank_app_ktls_receive_offloaded_total", ktls.kernelReceive);
+        auto& tls = bank_app::TlsServerContext::stats();
+        gauge("bank_app_tls_handshakes_total", tls.handshakes);
+        gauge("bank_app_tls_handshakes_resumed_total", tls.resumed);
+        gauge("bank_app_tls_handshakes_failed_total", tls.failed);
+        gauge("bank_app_memory_resident_bytes", bank_app::MemoryAccounting::residentBytes());
+        gauge("bank_app_memory_lexbor_bytes", bank_app::MemoryAccounting::counters(bank_app::MemorySubsystem::LEXBOR).liveBytes);
+        gauge("bank_app_memory_openssl_bytes", bank_app::MemoryAccounting::counters(bank_app::MemorySubsystem::OPENSSL).liveBytes);
+        gauge("bank_app_request_arena_overflow_allocations_total", arenaUpstream.allocations());
+        gauge("bank_app_request_arena_overflow_bytes_total", arenaUpstream.bytes());
+
+        return metrics;
+    });
 
-        if (cred->size() == 2) {
-            auto& credobj = *cred;
-            auto bcaInst = std::make_shared<bank_app::BcaBank>(*clientIoc);
-            loginResult = bcaInst->login(credobj[0], credobj[1]) ? "1" : loginResult;
+    // where the memory goes, by subsystem and by the largest sessions
+    serv->setEvent("/admin/memory", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        std::pmr::string report(context.arena);
+        auto line = [&](std::string_view name, uint64_t value) {
+            report.append(name).append(" ").append(std::to_string(value)).append("\n");
+        };
+
+        line("resident_bytes", bank_app::MemoryAccounting::residentBytes());
+        line("heap_bytes", bank_app::MemoryAccounting::heapBytes());
+        line("accounting_installed", bank_app::MemoryAccounting::installed());
+
+        auto subsystem = [&](std::string_view name, bank_app::MemorySubsystem which, std::size_t budget) {
+            auto counters = bank_app::MemoryAccounting::counters(which);
+            line(std::string(name) + "_bytes", counters.liveBytes);
+            line(std::string(name) + "_allocations_live", counters.liveAllocations);
+            line(std::string(name) + "_allocations_total", counters.allocations);
+            line(std::string(name) + "_budget_bytes", budget);
+        };
+        subsystem("lexbor", bank_app::MemorySubsystem::LEXBOR, memoryBudgets.lexbor);
+        subsystem("openssl", bank_app::MemorySubsystem::OPENSSL, memoryBudgets.openssl);
+
+        auto gauges = bcaInsts.gauges();
+        line("sessions", gauges.resident + gauges.pendingRestore);
+        line("session_bytes", gauges.bytes);
+        line("process_budget_bytes", memoryBudgets.process);
+        report.append("over_budget ").append(bank_app::MemoryAccounting::overBudget(memoryBudgets)).append("\n");
+
+        std::size_t top = 10;
+        std::from_chars(payload.data(), payload.data() + payload.size(), top);
+        for (auto& session : bcaInsts.largest(top)) {
+            report.append("session ").append(session.tokenPrefix).append(" ").append(std::to_string(session.bytes))
+                  .append(session.resident ? " resident\n" : " restorable\n");
+        }
 
-            if (loginResult == "1") {
-                auto uuid = uuidGen->get();
-                bcaInsts.insert({uuid, bcaInst });
+        return report;
+    });
 
-                loginResult = uuid;
+    // transfers left in doubt by a crash or a lost answer, by sourceAccount:key
+    serv->setEvent("/admin/transfers", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        std::pmr::string report(context.arena);
+        if (!journal)
+            return report;
+
+        for (auto& key : journal->inDoubt()) {
+            report.append(key).append("\n");
+        }
+        return report;
+    });
+
+    // once the outcome of a transfer in doubt is known from BCA it is recorded, payload is key;;SUCCEEDED|FAILED
+    serv->setEvent("/admin/transfers/resolve", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto parts = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+        if (!journal || parts.size() < 2 || (parts[1] != "SUCCEEDED" && parts[1] != "FAILED"))
+            return std::pmr::string("-1", context.arena);
+
+        auto resolved = journal->resolve(std::string(parts[0]), parts[1] == "SUCCEEDED");
+        bank_app::Logger::info("transfer_journal", resolved ? "resolved" : "not in doubt", std::string(parts[0]) + " " + std::string(parts[1]));
+        return std::pmr::string(resolved ? "1" : "-1", context.arena);
+    });
+
+    serv->setEvent("/cluster/members", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        if (!payload.empty()) {
+            ring.setMembers(bank_app::ClusterRing::parseMembers(std::string(payload)));
+        }
+
+        std::pmr::vector<std::pmr::string> memberList(context.arena);
+        for (const auto& node : ring.members()) {
+            auto& member = memberList.emplace_back();
+            member.append(node.id).append("=").append(node.host).append(":").append(node.port);
+            if (!node.publicAddress.empty())
+                member.append("=").append(node.publicAddress);
+        }
+
+        return bank_app::Utility::join(memberList, ",", context.arena);
+    });
+
+    serv->setEvent("/ping", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        return std::pmr::string("ok", context.arena);
+    });
+
+    serv->setEvent("/login", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto cred = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+        std::pmr::string loginResult("-1", context.arena);
+
+        // a new session would only push the process further past its budget
+        auto exceeded = bank_app::MemoryAccounting::overBudget(memoryBudgets);
+        if (!exceeded.empty())
+            throw beast::system_error{boost::system::errc::make_error_code(boost::system::errc::device_or_resource_busy)};
+
+        if (cred.size() == 2) {
+            auto username = std::string(cred[0]);
+            auto password = std::string(cred[1]);
+            auto bcaInst = warmSessions.acquire();
+            bool loggedIn = false;
+
+            if (bcaInst) {
+                try {
+                    loggedIn = bcaInst->login(username, password);
+                }
+                catch (beast::system_error& err) {
+                    // BCA closed the warm connection meanwhile, log in on a fresh one
+                    bcaInst.reset();
+                }
+            }
+            if (!bcaInst) {
+                bcaInst = std::make_shared<bank_app::BcaBank>(*clientIoc);
+                loggedIn = bcaInst->login(username, password);
+            }
+
+            if (loggedIn) {
+                auto token = tokens.mint(ring.mintRoutingPoint());
+                bcaInsts.insert(token, bcaInst);
+
+                loginResult = token;
             }
         }
 
         return loginResult;
     });
 
-    serv->setEvent("/balance", [&](std::string payload) -> std::string {
+    serv->setEvent("/balance", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto balance = bcaInsts.use(std::string(payload), [](bank_app::BcaBank& bcaInst) {
+            return bcaInst.getBalance();
+        });
+
+        return std::pmr::string(balance.value_or("-1"), context.arena);
+    });
+
+
+    serv->setEvent("/statement", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto dateRanges = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+
+        if (dateRanges.size() == 3) {
+            auto& dr = dateRanges;
+
+            auto statements = bcaInsts.use(std::string(dr[0]), [&](bank_app::BcaBank& bcaInst) {
+                return bcaInst.getStatements(dr[1], dr[2], context.arena);
+            });
 
-        if (bcaInsts.contains(payload)) {
-            auto bcaInst = bcaInsts[payload];
-            return bcaInst->getBalance();
+            if (statements) {
+                return bank_app::Utility::join(*statements, defaultSeparator, context.arena);
+            }
         }
 
-        return "-1";
+        return std::pmr::string("-1", context.arena);
     });
 
+    serv->setEvent("/statement_summary", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto dateRanges = bank_app::Utility::split(payload, defaultSeparator, context.arena);
 
-    serv->setEvent("/statement", [&](std::string payload) -> std::string {
-        auto dateRanges = bank_app::Utility::split(payload, defaultSeparator);
+        if (dateRanges.size() == 3) {
+            auto& dr = dateRanges;
 
-        if (dateRanges->size() == 3) {
-            auto& dr = *dateRanges;
+            auto summary = bcaInsts.use(std::string(dr[0]), [&](bank_app::BcaBank& bcaInst) {
+                return bcaInst.getStatementTable(dr[1], dr[2]).summarize();
+            });
 
-            if (bcaInsts.contains(dr[0])) {
-                auto bcaInst = bcaInsts[dr[0]];
-                auto statements = bcaInst->getStatements(dr[1], dr[2]);
+            if (summary) {
+                std::pmr::vector<std::pmr::string> totals(context.arena);
+                for (auto& total : {summary->credit, summary->debit}) {
+                    totals.emplace_back(std::to_string(total.count));
+                    totals.emplace_back(bank_app::StatementTable::formatAmount(total.sum));
+                    totals.emplace_back(bank_app::StatementTable::formatAmount(total.min));
+                    totals.emplace_back(bank_app::StatementTable::formatAmount(total.max));
+                }
 
-                return bank_app::Utility::join(*statements, defaultSeparator);
+                return bank_app::Utility::join(totals, defaultSeparator, context.arena);
             }
         }
 
-        return "-1";
+        return std::pmr::string("-1", context.arena);
     });
 
-    serv->setEvent("/transfer_form", [&](std::string payload) -> std::string {
-        std::string defaultRes = "-1";
+    // token;;text[;;min amount;;max amount;;from yyyymmdd;;to yyyymmdd;;CR|DB], searches the rows already fetched
+    serv->setEvent("/statement_search", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto fields = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+
+        if (fields.size() >= 2) {
+            bank_app::StatementQuery query;
+            query.text = fields[1];
+
+            auto field = [&](std::size_t i) {
+                return i < fields.size() ? fields[i] : std::string_view();
+            };
+            if (auto amount = bank_app::StatementTable::parseAmount(field(2)))
+                query.minAmount = *amount;
+            if (auto amount = bank_app::StatementTable::parseAmount(field(3)))
+                query.maxAmount = *amount;
+            if (!field(4).empty())
+                std::from_chars(field(4).data(), field(4).data() + field(4).size(), query.from);
+            if (!field(5).empty())
+                std::from_chars(field(5).data(), field(5).data() + field(5).size(), query.to);
+            if (field(6) == "CR" || field(6) == "DB")
+                query.credit = field(6) == "CR";
+
+            auto matches = bcaInsts.use(std::string(fields[0]), [&](bank_app::BcaBank& bcaInst) {
+                auto& index = bcaInst.statementIndex();
+                auto& rows = index.rows();
+                std::pmr::vector<std::pmr::string> result(context.arena);
+
+                for (auto row : index.search(query)) {
+                    auto& line = result.emplace_back();
+                    line.append(std::to_string(rows.date(row))).append("|")
+                        .append(bank_app::StatementTable::formatAmount(rows.amount(row))).append("|")
+                        .append(rows.credit(row) ? "CR" : "DB").append("|")
+                        .append(rows.description(row));
+                }
+
+                return result;
+            });
+
+            if (matches) {
+                return bank_app::Utility::join(*matches, defaultSeparator, context.arena);
+            }
+        }
 
-        if (bcaInsts.contains(payload)) {
-            auto bcaInst = bcaInsts[payload];
-            auto tf = bcaInst->getTransferForm();
-            std::vector<std::string> valueList;
+        return std::pmr::string("-1", context.arena);
+    });
 
-            for (const auto& dest : tf->destinationList) {
-                valueList.push_back(dest.first + ":" + dest.second);
-            }
+    auto joinTransferForm = [&](const bank_app::BcaTransferForm& tf, std::pmr::memory_resource* arena) {
+        std::pmr::vector<std::pmr::string> valueList(arena);
+        valueList.reserve(tf.destinationList.size() + 2);
 
-            return tf->randomCode + defaultSeparator + tf->sourceAccount + defaultSeparator + bank_app::Utility::join(valueList, defaultSeparator);
+        valueList.emplace_back(tf.randomCode);
+        valueList.emplace_back(tf.sourceAccount);
+        for (const auto& dest : tf.destinationList) {
+            auto& value = valueList.emplace_back();
+            value.append(dest.first).append(":").append(dest.second);
         }
 
-        return defaultRes;
+        return bank_app::Utility::join(valueList, defaultSeparator, arena);
+    };
+
+    serv->setEvent("/transfer_form", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto transferForm = bcaInsts.use(std::string(payload), [](bank_app::BcaBank& bcaInst) {
+            return bcaInst.getTransferForm();
+        });
+
+        if (transferForm) {
+            return joinTransferForm(**transferForm, context.arena);
+        }
+
+        return std::pmr::string("-1", context.arena);
     });
 
-    serv->setEvent("/transfer_action", [&](std::string payload) -> std::string {
-        std::string defaultRes = "-1";
-        bank_app::BcaTransferData tfData;
-        auto payloads = bank_app::Utility::split(payload, defaultSeparator);
-        auto& transferPayloads = *payloads;
+    // token;;operation[;;operation...] with the operations balance, transfer_form and statement:start:end,
+    // sent to BCA in one pipelined exchange. Answers a line per operation in the order given, each the
+    // answer of its own endpoint with line breaks turned into spaces, -1 for an operation which failed.
+    serv->setEvent("/batch", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        auto fields = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+        std::vector<bank_app::BcaBatchOperation> operations;
+
+        for (std::size_t i = 1; i < fields.size(); i++) {
+            auto parts = bank_app::Utility::split(fields[i], ":", context.arena);
+            if (parts[0] == "balance")
+                operations.push_back({bank_app::BcaBatchOperation::BALANCE});
+            else if (parts[0] == "transfer_form")
+                operations.push_back({bank_app::BcaBatchOperation::TRANSFER_FORM});
+            else if (parts[0] == "statement" && parts.size() == 3)
+                operations.push_back({bank_app::BcaBatchOperation::STATEMENT, std::string(parts[1]), std::string(parts[2])});
+            else
+                return std::pmr::string("-1", context.arena);
+        }
 
-        if (bcaInsts.contains(transferPayloads[0])) {
-            auto bcaInst = bcaInsts[transferPayloads[0]];
+        if (operations.empty())
+            return std::pmr::string("-1", context.arena);
 
+        auto results = bcaInsts.use(std::string(fields[0]), [&](bank_app::BcaBank& bcaInst) {
+            return bcaInst.batch(operations, context.arena);
+        });
+
+        if (!results)
+            return std::pmr::string("-1", context.arena);
+
+        std::pmr::string combined(context.arena);
+        for (std::size_t i = 0; i < results->size(); i++) {
+            auto& result = (*results)[i];
+            auto begin = combined.size();
+
+            if (!result.ok)
+                combined.append("-1");
+            else if (operations[i].kind == bank_app::BcaBatchOperation::BALANCE)
+                combined.append(result.balance);
+            else if (operations[i].kind == bank_app::BcaBatchOperation::STATEMENT)
+                combined.append(bank_app::Utility::join(result.statements, defaultSeparator, context.arena));
+            else
+                combined.append(joinTransferForm(*result.transferForm, context.arena));
+
+            std::replace_if(combined.begin() + begin, combined.end(), [](char c) { return c == '\n' || c == '\r'; }, ' ');
+            combined.push_back('\n');
+        }
+
+        return combined;
+    });
+
+    // token;;source;;destination;;name;;amount;;notes1;;notes2;;appli1;;appli2[;;idempotency key]
+    // answers 1 done, -1 failed, -2 in doubt (check the statement), -3 key reused for another transfer. A retry
+    // while the first attempt under its key still runs waits for it until the request deadline, then 504.
+    serv->setEvent("/transfer_action", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        std::pmr::string defaultRes("-1", context.arena);
+        bank_app::BcaTransferData tfData;
+        auto transferPayloads = bank_app::Utility::split(payload, defaultSeparator, context.arena);
+
+        if (transferPayloads.size() >= 9) {
             tfData.sourceAccount = transferPayloads[1];
 
             tfData.destinationAccount = transferPayloads[2];
             tfData.destinationAccountName = transferPayloads[3];
 
-            tfData.amount = std::stoi(transferPayloads[4]);
+            tfData.amount = std::stoi(std::string(transferPayloads[4]));
 
             tfData.notes1 = transferPayloads[5];
             tfData.notes2 = transferPayloads[6];
@@ -109,30 +699,143 @@ int main() {
             tfData.appli1 = transferPayloads[7];
             tfData.appli2 = transferPayloads[8];
 
-            const bool transferResult = bcaInst->transferFund(tfData);
+            auto token = std::string(transferPayloads[0]);
+            std::string journalKey;
+
+            if (journal && transferPayloads.size() >= 10 && !transferPayloads[9].empty() && bcaInsts.contains(token)) {
+                journalKey = tfData.sourceAccount + ":" + std::string(transferPayloads[9]);
+
+                // everything but the session and the one time KeyBCA responses identifies the transfer
+                auto transfer = payload.substr(transferPayloads[1].data() - payload.data(),
+                                               transferPayloads[7].data() - transferPayloads[1].data());
+                auto recorded = journal->begin(journalKey, bank_app::TransferJournal::fingerprint(transfer),
+                        bank_app::RequestDeadline::current().value_or(std::chrono::steady_clock::now() + std::chrono::seconds(30)));
+
+                if (recorded) {
+                    switch (*recorded) {
+                        case bank_app::TransferOutcome::SUCCEEDED:
+                            return std::pmr::string("1", context.arena);
+                        case bank_app::TransferOutcome::IN_DOUBT:
+                            return std::pmr::string("-2", context.arena);
+                        case bank_app::TransferOutcome::MISMATCH:
+                            return std::pmr::string("-3", context.arena);
+                        case bank_app::TransferOutcome::IN_PROGRESS:
+                            throw beast::system_error{beast::error::timeout};
+                        default:
+                            return defaultRes;
+                    }
+                }
+            }
 
-            return transferResult ? "1" : defaultRes;
+            // Only an answer of BCA is journaled as final. A transfer which never reached the executing step,
+            // the session gone or too busy or the validation failing, frees its key. One which failed after
+            // it may have reached BCA stays in doubt.
+            bool started = false;
+            std::optional<bank_app::TransferResult> transferResult;
+            try {
+                transferResult = bcaInsts.use(token, [&](bank_app::BcaBank& bcaInst) {
+                    started = true;
+                    return bcaInst.transferFund(tfData);
+                });
+            }
+            catch (...) {
+                if (!started) {
+                    if (!journalKey.empty())
+                        journal->release(journalKey);
+                    throw;
+                }
+
+                if (!journalKey.empty())
+                    journal->abandon(journalKey);
+                return std::pmr::string("-2", context.arena);
+            }
+
+            auto result = transferResult.value_or(bank_app::TransferResult::NOT_SENT);
+            if (!journalKey.empty()) {
+                if (result == bank_app::TransferResult::NOT_SENT)
+                    journal->release(journalKey);
+                else
+                    journal->complete(journalKey, result == bank_app::TransferResult::EXECUTED);
+            }
+
+            if (result == bank_app::TransferResult::EXECUTED)
+                return std::pmr::string("1", context.arena);
         }
 
         return defaultRes;
     });
 
-    serv->setEvent("/logout", [&](std::string payload) -> std::string {
-        std::string defaultRes = "-1";
+    serv->setEvent("/logout", [&](bank_app::RequestContext& context, std::string_view payload) -> std::pmr::string {
+        std::pmr::string defaultRes("-1", context.arena);
 
-        if (bcaInsts.contains(payload)) {
-            auto bcaInst = bcaInsts[payload];
-            auto logoutResult = bcaInst->logout();
+        // logged out through the mailbox, after whatever is still queued on the session
+        auto token = std::string(payload);
+        auto logoutResult = bcaInsts.use(token, [](bank_app::BcaBank& bcaInst) {
+            return bcaInst.logout();
+        });
+        bcaInsts.remove(token);
 
-            bcaInsts.erase(payload);
-
-            return logoutResult ? "1" : defaultRes;
-        }
+        if (logoutResult && *logoutResult)
+            return std::pmr::string("1", context.arena);
 
         return defaultRes;
     });
 	
-	std::cout << "Server Running at port: " << port << std::endl;
+    // GET /feed?token=..., server-sent balance and transaction events instead of polling /balance and /statement
+    serv->setStream("/feed", [&](std::string_view payload, std::shared_ptr<bank_app::EventSink> sink) {
+        auto token = feedToken(payload);
+        if (!bcaInsts.contains(token))
+            return false;
+
+        feedHub.subscribe(token, std::move(sink));
+        return true;
+    });
+
+    serv->listen();
+
+    // the next process takes over through the handoff socket, this one exits once its requests are answered
+    std::unique_ptr<bank_app::ProcessHandoff> handoff;
+    if (!handoffPath.empty()) {
+        try {
+            handoff = std::make_unique<bank_app::ProcessHandoff>(handoffPath, [&] {
+                return serv->listeners();
+            }, [&] {
+                if (!serv->drain(drainTimeout))
+                    bank_app::Logger::warn("handoff", "requests still in flight after the drain timeout");
+
+                // Exiting without unwinding is intended. Sessions are in the snapshot and transfers durable in
+                // the journal already. The upstream TLS connections are dropped without close_notify, BCA
+                // keeps the sessions behind them. The refresher schedule is rebuilt by the next process as it
+                // uses the restored sessions, and sessions still queued for logout by the evictor stay logged
+                // in until BCA expires them.
+                if (snapshot)
+                    snapshot->flush();
+                bank_app::Logger::instance().flush();
+                std::cout.flush();
+                std::_Exit(0);
+            });
+        }
+        catch (std::exception& err) {
+            bank_app::Logger::error("handoff", "disabled", err.what());
+        }
+    }
+
+    if (!configPath.empty()) {
+        config.watch([&](const bank_app::ConfigFile::Values& values) {
+            try {
+                serverRunner.resize(poolSize("server_threads", "BANK_APP_SERVER_THREADS", serverThreadsDefault()) - 1);
+                clientRunner.resize(poolSize("client_threads", "BANK_APP_CLIENT_THREADS", 2));
+                sessionExecutor.resize(poolSize("session_workers", "BANK_APP_SESSION_WORKERS", sessionWorkersDefault));
+            }
+            catch (std::exception& err) {
+                bank_app::Logger::error("config", "invalid pool size", err.what());
+            }
+        });
+    }
+
+	std::cout << "Server Running at port: " << port << ", restored sessions: " << restoredSessions
+              << ", io backend: " << bank_app::IO_BACKEND
+              << (inheritedListeners ? ", listeners taken over" : "") << std::endl;
 
 
     serv->run();
@@ -5,9 +5,12 @@
 #ifndef BANK_APP_BASEBANK_H
 #define BANK_APP_BASEBANK_H
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
 #include "HttpClient.h"
 #include "CookieJar.h"
-#include "UUIDGenerator.h"
+#include "TokenService.h"
 #include <chrono>
 #include <random>
 #include <boost/algorithm/string.hpp>
@@ -28,9 +31,13 @@ namespace bank_app{
         STATEMENT,
         STATEMENT_VIEW,
         TRANSFER_FORM,
-        TRANSFER_FUND
+        TRANSFER_FUND,
+        HOME,
+        BANK_PATHS_COUNT
     };
 
+    constexpr std::string_view BCA_HOST = "m.klikbca.com";
+
     constexpr auto getBCAPath(BANK_PATHS path){
         switch(path){
             case LOGIN_PAGE:
@@ -51,11 +58,31 @@ namespace bank_app{
                 return "/fundtransfer.do?value(actions)=formentry";
             case TRANSFER_FUND:
                 return "/fundtransfer.do";
+            case HOME:
+                return "/";
+            default:
+                break;
         }
 
         throw std::invalid_argument("bca path not found");
     }
 
+    // The constant part of every request to a BCA path, serialized on first use and shared by all clients
+    inline const RequestTemplate& bcaTemplate(BANK_PATHS path, http::verb method){
+        static const auto templates = []{
+            std::vector<RequestTemplate> built;
+            built.reserve(BANK_PATHS_COUNT * 2);
+            for(int path = 0; path < BANK_PATHS_COUNT; path++){
+                for(auto method : {http::verb::get, http::verb::post}){
+                    built.emplace_back(method, getBCAPath(static_cast<BANK_PATHS>(path)), BCA_HOST, DEFAULT_USER_AGENT);
+                }
+            }
+            return built;
+        }();
+
+        return templates.at(path * 2 + (method == http::verb::post ? 1 : 0));
+    }
+
     class BaseBank{
     protected:
         IP addr;
@@ -68,7 +95,8 @@ namespace bank_app{
     public:
         virtual bool login(std::string username, std::string password) = 0;
         virtual std::string getBalance() = 0;
-        virtual std::shared_ptr<std::vector<std::string>> getStatements(std::string start, std::string end) = 0;
+        virtual std::pmr::vector<std::pmr::string> getStatements(std::string_view start, std::string_view end,
+                                                                 std::pmr::memory_resource* resource = std::pmr::get_default_resource()) = 0;
         virtual bool logout() = 0;
     };
 }
@@ -8,6 +8,10 @@
 #include <iostream>
 #include "BaseBank.h"
 #include "HtmlParser.h"
+#include "HtmlTokenScanner.h"
+#include "SessionSnapshot.h"
+#include "StatementIndex.h"
+#include "Logger.h"
 
 namespace bank_app{
     struct BcaTransferForm{
@@ -27,11 +31,43 @@ namespace bank_app{
         std::string appli2;
     };
 
+    enum class TransferResult{
+        // nothing reached the executing step of BCA, the transfer may be tried again
+        NOT_SENT,
+        // BCA answered with its error page
+        REJECTED,
+        EXECUTED
+    };
+
+    // one read only operation of a batch, start and end are the range of a statement in epoch milliseconds
+    struct BcaBatchOperation{
+        enum Kind{
+            BALANCE,
+            STATEMENT,
+            TRANSFER_FORM
+        };
+
+        Kind kind;
+        std::string start, end;
+    };
+
+    struct BcaBatchResult{
+        std::pmr::vector<std::pmr::string> statements;
+        std::string balance;
+        std::shared_ptr<BcaTransferForm> transferForm;
+        bool ok = false;
+    };
+
     class BcaBank : public BaseBank{
         // private properties
-        const std::string _bcaEscapeToken;
         net::io_context& ioc_;
         std::string username_, password_;
+        uint64_t loginCount_ = 0;
+        // the login page was fetched and its cookies are in the jar, login only has to post
+        std::optional<std::chrono::steady_clock::time_point> loginPreparedAt_;
+        StatementIndex statementIndex_;
+        // second connection of the session, only opened for hedged requests
+        std::unique_ptr<bank_app::HttpClient> hedgeClientPtr;
 
         // private methods
         std::string _getUrl(std::string path){
@@ -50,55 +86,237 @@ namespace bank_app{
             ip->asUINT = rd();
             currentIp = _parseIp(ip->asBYTE);
         }
-        std::string createBcaPayload(std::vector<std::pair<std::string, std::string>> listData){
-            std::string result;
-            for(auto it = listData.begin(); it != listData.end(); it++){
-                const auto notLastItem = std::distance(it, listData.end()) > 1;
-                result += it->first + "=" + it->second + (notLastItem ? "&" : "");
+        std::string createBcaPayload(std::initializer_list<UrlForm::Field> fields){
+            return UrlForm::build(fields);
+        }
+        static std::tm _localDate(std::string_view millis){
+            time_t seconds = std::stoll(std::string(millis)) / 1000;
+            return *std::localtime(&seconds);
+        }
+
+        UpstreamRequest _statementRequest(const std::tm& startt, const std::tm& endt){
+            auto stmtPayload = createBcaPayload({
+                 {formKey<"value(r1)">, "1"},
+                 {formKey<"value(D1)">, "0"},
+                 {formKey<"value(startDt)">, std::to_string(startt.tm_mday)},
+                 {formKey<"value(startMt)">, std::to_string(startt.tm_mon+1)},
+                 {formKey<"value(startYr)">, std::to_string(startt.tm_year+1900)},
+                 {formKey<"value(endDt)">, std::to_string(endt.tm_mday)},
+                 {formKey<"value(endMt)">, std::to_string(endt.tm_mon+1)},
+                 {formKey<"value(endYr)">, std::to_string(endt.tm_year+1900)}
+            });
+
+            UpstreamRequest request(bcaTemplate(BANK_PATHS::STATEMENT_VIEW, http::verb::post));
+            request.cookie(cookieJarPtr->toString())
+                   .referer(getBCAPath(BANK_PATHS::STATEMENT))
+                   .body(std::move(stmtPayload));
+
+            return request;
+        }
+
+        // Hand the date, description and direction cells of every statement row to onRow
+        template<class RowHandler>
+        static void _parseStatementRows(const http::response<http::dynamic_body>& response, RowHandler&& onRow){
+            auto responseHtml = boost::beast::buffers_to_string(response.body().data());
+
+            lxb_char_t trNeedle[] = "table[width=\"100%\"][class=\"blue\"]:not([border]) tr[bgcolor]";
+            auto htmlParser = std::make_unique<HtmlParser>(lxbFromString(responseHtml));
+            auto searchNodesResult = htmlParser->css(trNeedle);
+
+            for (auto node : htmlParser->toArray())
+            {
+                auto fc = node->first_child;
+                auto sc = fc->next;
+                auto lc = sc->next;
+
+                onRow(fc, sc, lc);
+            }
+        }
+
+        // Post the statement form for the range and hand the date, description and direction cells of every row to onRow
+        template<class RowHandler>
+        void _fetchStatementRows(const std::tm& startt, const std::tm& endt, RowHandler&& onRow){
+            if (isLoginTimeout())
+                relogin();
+
+            auto response = httpClientPtr->prepareCopy(_statementRequest(startt, endt))->send()->response();
+
+            _parseStatementRows(*response, std::forward<RowHandler>(onRow));
+        }
+
+        std::pmr::vector<std::pmr::string> _statementLines(const http::response<http::dynamic_body>& response, const std::tm& startt,
+                                                           const std::tm& endt, std::pmr::memory_resource* resource){
+            std::pmr::vector<std::pmr::string> finalResult(resource);
+            const char elmSeparator = '|';
+            StatementTable table;
+
+            _parseStatementRows(response, [&](auto fc, auto sc, auto lc) {
+                auto& trLine = finalResult.emplace_back();
+                bank_app::lxbAppendInnerHtml(fc, trLine);
+                auto dateEnd = trLine.size();
+                trLine.push_back(elmSeparator);
+                bank_app::lxbAppendInnerHtml(sc, trLine);
+                auto descriptionEnd = trLine.size();
+                trLine.push_back(elmSeparator);
+                bank_app::lxbAppendInnerHtml(lc, trLine);
+
+                std::string_view line(trLine);
+                table.appendRow(line.substr(0, dateEnd), line.substr(dateEnd + 1, descriptionEnd - dateEnd - 1),
+                                line.substr(descriptionEnd + 1), toDateNumber(endt));
+            });
+
+            statementIndex_.merge(table, toDateNumber(startt), toDateNumber(endt));
+
+            return finalResult;
+        }
+
+        UpstreamRequest _transferFormRequest(){
+            UpstreamRequest request(bcaTemplate(BANK_PATHS::TRANSFER_FORM, http::verb::post));
+            request.cookie(cookieJarPtr->toString());
+
+            return request;
+        }
+
+        static std::shared_ptr<BcaTransferForm> _parseTransferForm(const http::response<http::dynamic_body>& response){
+            auto responseHtml = boost::beast::buffers_to_string(response.body().data());
+
+            auto htmlParser = std::make_unique<HtmlParser>(lxbFromString(responseHtml));
+
+            std::string attr_name = "value";
+            lxb_char_t needle[] = "select[name=\"value(acc_from)\"]>option[value=\"0\"],input[name=\"value(rndNum)\"],select[name=\"value(acc_to3)\"]>option";
+
+            auto foundNodeList = htmlParser->css(needle)->toArray();
+
+            auto formResult = std::make_shared<BcaTransferForm>();
+            for(auto& node : foundNodeList){
+                auto attrValue = bank_app::lxbGetNodeAttr(node, bank_app::lxbFromString(attr_name));
+
+                // two digit random code
+                if(attrValue.length() == 2){
+                    formResult->randomCode = attrValue;
+                }
+                else if(attrValue.length() > 2){
+                    auto destLine = bank_app::lxbGetInnerHtml(node);
+                    std::vector<std::string> resultTexts;
+                    boost::split(resultTexts, destLine, boost::is_any_of("-"));
+                    boost::algorithm::trim(resultTexts[1]);
+                    formResult->destinationList[attrValue] = resultTexts[1];
+                }
+                else if(attrValue.length() == 1){
+                    formResult->sourceAccount = bank_app::lxbGetInnerHtml(node);
+                    boost::algorithm::trim(formResult->sourceAccount);
+                }
             }
-            return bank_app::HttpClient::UrlEncode(result, _bcaEscapeToken);
+
+            return formResult;
+        }
+
+        UpstreamRequest _balanceRequest(){
+            UpstreamRequest request(bcaTemplate(BANK_PATHS::BALANCE_INQUIRY, http::verb::post));
+            request.cookie(cookieJarPtr->toString())
+                   .referer(getBCAPath(BANK_PATHS::MENU_PATH));
+
+            return request;
+        }
+
+        static std::string _parseBalance(const http::response<http::dynamic_body>& response){
+            // one value out of the page, the tokenizer stops right after it instead of building the DOM
+            HtmlTokenScanner pageScanner;
+            auto balance = pageScanner.text("td[align='right'] b");
+            pageScanner.scanBuffers(response.body().data());
+
+            return pageScanner[balance].value_or("-1");
+        }
+
+        void _createClient(){
+            host = BCA_HOST;
+            cookieJarPtr = std::make_unique<bank_app::CookieJar>();
+            httpClientPtr = std::make_unique<bank_app::HttpClient>(ioc_, host, port, cookieJarPtr.get());
         }
     public:
-        BcaBank(net::io_context& ioc) : ioc_(ioc), _bcaEscapeToken("&=_.+"){
+        BcaBank(net::io_context& ioc) : ioc_(ioc){
             _generateIp();
+            _createClient();
 
-            host = "m.klikbca.com";
-            cookieJarPtr = std::make_unique<bank_app::CookieJar>();
-            httpClientPtr = std::make_unique<bank_app::HttpClient>(ioc, host, port, cookieJarPtr.get());
+            httpClientPtr->get(bcaTemplate(BANK_PATHS::HOME, http::verb::get))->fillCookie();
+        }
 
-            httpClientPtr->get("/")->fillCookie();
+        // Resume a checkpointed session, the upstream connection is only opened on first use
+        BcaBank(net::io_context& ioc, const BcaSessionState& state) : ioc_(ioc){
+            _createClient();
+
+            currentIp = state.currentIp;
+            username_ = state.username;
+            password_ = state.password;
+            loginTimestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(state.loginTimestamp));
+
+            for(auto& cookie : state.cookies){
+                cookieJarPtr->set(cookie);
+            }
         }
         ~BcaBank() {
-            httpClientPtr->closeConnection();
+            try{
+                httpClientPtr->closeConnection();
+                if(hedgeClientPtr)
+                    hedgeClientPtr->closeConnection();
+            }
+            catch(beast::system_error& err){
+                // the peer already dropped the connection
+            }
+        }
+
+        static UpstreamHedge& balanceHedge(){
+            static UpstreamHedge hedge;
+            return hedge;
         }
 
-        void relogin() {
+        // BCA drops a login after this long
+        static constexpr std::chrono::minutes LOGIN_TTL{5};
+
+        bool relogin() {
+            try{
+                httpClientPtr->closeConnection();
+            }
+            catch(beast::system_error& err){
+                // the old connection is discarded either way
+            }
+
             httpClientPtr->openConnection();
-            login(username_, password_);
+            return login(username_, password_);
+        }
+
+        // First half of a login: fetch the login page for its cookies. Done ahead of time for warm sessions.
+        void prepareLogin(){
+            httpClientPtr->get(bcaTemplate(BANK_PATHS::LOGIN_PAGE, http::verb::get))->fillCookie();
+            loginPreparedAt_ = std::chrono::steady_clock::now();
+        }
+
+        std::optional<std::chrono::steady_clock::time_point> loginPreparedAt(){
+            return loginPreparedAt_;
         }
 
         bool login(std::string username, std::string password) override {
-            auto uuidGen = std::make_unique<bank_app::UUIDGenerator>();
-            std::string loginPayload = bank_app::HttpClient::UrlEncode("value(user_id)=" + username + "&" +
-                                                                       "value(pswd)=" + password + "&" +
-                                                                       "value(Submit)=LOGIN" + "&" +
-                                                                       "value(actions)=login" + "&" +
-                                                                       "value(user_ip)=" + currentIp + "&" +
-                                                                       "user_ip=" + currentIp + "&" +
-                                                                       "value(mobile)=true" + "&" +
-                                                                       "value(browser_info)=" + bank_app::DEFAULT_USER_AGENT + "&" +
-                                                                       "mobile=true&" +
-                "as_fid=" + uuidGen->get() + std::string(uuidGen->get().data(), 8), _bcaEscapeToken);
-
-            auto refererUrl = std::string(getBCAPath(BANK_PATHS::LOGIN_PAGE));
-            auto loginUrl = std::string(getBCAPath(BANK_PATHS::LOGIN));
-
-            httpClientPtr->get(refererUrl)->fillCookie();
-
-            auto loginPostPtr = httpClientPtr->prepareRequest(loginUrl, http::verb::post)
-                    ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                    ->setHeader(http::field::referer, refererUrl)
-                    ->setPayload(loginPayload)
+            auto loginPayload = createBcaPayload({
+                {formKey<"value(user_id)">, username},
+                {formKey<"value(pswd)">, password},
+                {formKey<"value(Submit)">, "LOGIN"},
+                {formKey<"value(actions)">, "login"},
+                {formKey<"value(user_ip)">, currentIp},
+                {formKey<"user_ip">, currentIp},
+                {formKey<"value(mobile)">, "true"},
+                {formKey<"value(browser_info)">, bank_app::DEFAULT_USER_AGENT},
+                {formKey<"mobile">, "true"},
+                {formKey<"as_fid">, Hex::encode(SecureRandom::bytes<20>())}
+            });
+
+            if(!loginPreparedAt_)
+                prepareLogin();
+            loginPreparedAt_.reset();
+
+            auto loginPostPtr = httpClientPtr->prepareRequest(bcaTemplate(BANK_PATHS::LOGIN, http::verb::post))
+                    ->setCookie(cookieJarPtr->toString())
+                    ->setReferer(getBCAPath(BANK_PATHS::LOGIN_PAGE))
+                    ->setPayload(std::move(loginPayload))
                     ->send();
 
             auto loginPostCookiesPtr = loginPostPtr->cookies();
@@ -109,201 +327,252 @@ namespace bank_app{
 
                 username_ = username;
                 password_ = password;
+                loginCount_++;
             }
 
             return loginStatus;
         }
 
+        BcaSessionState exportState(){
+            BcaSessionState state;
+
+            state.username = username_;
+            state.password = password_;
+            state.currentIp = currentIp;
+            state.loginTimestamp = std::chrono::duration_cast<std::chrono::milliseconds>(loginTimestamp.time_since_epoch()).count();
+            state.cookies = cookieJarPtr->serialize();
+
+            return state;
+        }
+
+        std::size_t residentBytes(){
+            return sizeof(BcaBank) + cookieJarPtr->residentBytes() + httpClientPtr->residentBytes() + statementIndex_.residentBytes() +
+                   (hedgeClientPtr ? hedgeClientPtr->residentBytes() : 0);
+        }
+
+        void releaseBuffers(){
+            httpClientPtr->releaseResponse();
+            if(hedgeClientPtr)
+                hedgeClientPtr->releaseResponse();
+        }
+
+        // changes whenever the state returned by exportState() changes
+        uint64_t stateVersion(){
+            return loginCount_ + cookieJarPtr->version();
+        }
+
+        bool canRelogin(){
+            return !username_.empty() && !password_.empty();
+        }
+
         bool isLoginTimeout(){
             auto currentTimestamp = std::chrono::system_clock::now();
             auto timeDiff = std::chrono::duration_cast<std::chrono::minutes>(currentTimestamp - loginTimestamp);
 
-            return timeDiff.count() >= 5;
+            return timeDiff >= LOGIN_TTL;
         }
 
-        bool logout() override {
-            auto refererUrl = std::string(getBCAPath(BANK_PATHS::LOGIN_PAGE));
-            auto logoutUrl = std::string(getBCAPath(BANK_PATHS::LOGOUT));
+        std::chrono::system_clock::time_point loginExpiry(){
+            return loginTimestamp + LOGIN_TTL;
+        }
 
+        bool logout() override {
             try{
-                httpClientPtr->prepareRequest(logoutUrl, http::verb::get)
-                        ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                        ->setHeader(http::field::referer, refererUrl)
+                httpClientPtr->prepareRequest(bcaTemplate(BANK_PATHS::LOGOUT, http::verb::get))
+                        ->setCookie(cookieJarPtr->toString())
+                        ->setReferer(getBCAPath(BANK_PATHS::LOGIN_PAGE))
                         ->send();
 
                 return true;
             }
             catch(beast::system_error& err){
-                std::cerr << err.what() << std::endl;
+                Logger::error("bca_logout", err.what());
 
                 return false;
             }
         }
 
-        std::shared_ptr<std::vector<std::string>> getStatements(std::string start, std::string end) override {
-            if (isLoginTimeout())
-                relogin();
-
-            time_t startTimeParam = std::stoll(start) / 1000, endTimeParam = std::stoll(end) / 1000;
-            auto startt = *std::localtime(&startTimeParam);
-            auto endt = *std::localtime(&endTimeParam);
-
-            auto stmtPayload = createBcaPayload({
-                 {"value(r1)", "1"},
-                 {"value(D1)", "0"},
-                 {"value(startDt)", std::to_string(startt.tm_mday)},
-                 {"value(startMt)", std::to_string(startt.tm_mon+1)},
-                 {"value(startYr)", std::to_string(startt.tm_year+1900)},
-                 {"value(endDt)", std::to_string(endt.tm_mday)},
-                 {"value(endMt)", std::to_string(endt.tm_mon+1)},
-                 {"value(endYr)", std::to_string(endt.tm_year+1900)}
-            });
-
-            auto refererUrl = std::string(getBCAPath(BANK_PATHS::STATEMENT));
-            auto statementUrl = std::string(getBCAPath(BANK_PATHS::STATEMENT_VIEW));
-
-            auto response = httpClientPtr->prepareRequest(statementUrl, http::verb::post)
-                    ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                    ->setHeader(http::field::referer, refererUrl)
-                    ->setPayload(stmtPayload)
-                    ->send()->response();
+        static int32_t toDateNumber(const std::tm& date){
+            return (date.tm_year + 1900) * 10000 + (date.tm_mon + 1) * 100 + date.tm_mday;
+        }
 
-            auto responseHtml = boost::beast::buffers_to_string(response->body().data());
+        std::pmr::vector<std::pmr::string> getStatements(std::string_view start, std::string_view end,
+                                                         std::pmr::memory_resource* resource = std::pmr::get_default_resource()) override {
+            auto startt = _localDate(start), endt = _localDate(end);
 
-            lxb_char_t trNeedle[] = "table[width=\"100%\"][class=\"blue\"]:not([border]) tr[bgcolor]";
-            auto htmlParser = std::make_unique<HtmlParser>(lxbFromString(responseHtml));
-            auto searchNodesResult = htmlParser->css(trNeedle);
+            if (isLoginTimeout())
+                relogin();
 
-            auto resultNodes = htmlParser->toArray();
-            auto finalResult = std::make_shared<std::vector<std::string>>();
+            auto response = httpClientPtr->prepareCopy(_statementRequest(startt, endt))->send()->response();
 
-            const std::string elmSeparator = "|";
+            return _statementLines(*response, startt, endt, resource);
+        }
 
-            for (auto node : resultNodes)
-            {
-                auto fc = node->first_child;
-                auto sc = fc->next;
-                auto lc = sc->next;
+        // The rows of the range parsed into columns, rows without a readable amount are skipped
+        StatementTable getStatementTable(std::string_view start, std::string_view end){
+            StatementTable table;
+            auto startt = _localDate(start), endt = _localDate(end);
+            auto rangeEnd = toDateNumber(endt);
+            std::pmr::string dateCell, descriptionCell, directionCell;
+
+            _fetchStatementRows(startt, endt, [&](auto fc, auto sc, auto lc) {
+                dateCell.clear();
+                descriptionCell.clear();
+                directionCell.clear();
+                bank_app::lxbAppendInnerHtml(fc, dateCell);
+                bank_app::lxbAppendInnerHtml(sc, descriptionCell);
+                bank_app::lxbAppendInnerHtml(lc, directionCell);
+
+                table.appendRow(dateCell, descriptionCell, directionCell, rangeEnd);
+            });
 
-                auto trLine = bank_app::lxbGetInnerHtml(fc) + elmSeparator +
-                    bank_app::lxbGetInnerHtml(sc) + elmSeparator +
-                    bank_app::lxbGetInnerHtml(lc);
+            statementIndex_.merge(table, toDateNumber(startt), rangeEnd);
 
-                finalResult->push_back(trLine);
-            }
+            return table;
+        }
 
-            return finalResult;
+        // every row fetched so far in this session, searchable without going back to BCA
+        const StatementIndex& statementIndex(){
+            return statementIndex_;
         }
 
         std::shared_ptr<BcaTransferForm> getTransferForm(){
             if (isLoginTimeout())
                 relogin();
 
-            auto response = httpClientPtr->post(getBCAPath(BANK_PATHS::TRANSFER_FORM))->response();
-            auto responseHtml = boost::beast::buffers_to_string(response->body().data());
+            auto response = httpClientPtr->prepareCopy(_transferFormRequest())->send()->response();
 
-            auto htmlParser = std::make_unique<HtmlParser>(lxbFromString(responseHtml));
-
-            std::string attr_name = "value";
-            lxb_char_t needle[] = "select[name=\"value(acc_from)\"]>option[value=\"0\"],input[name=\"value(rndNum)\"],select[name=\"value(acc_to3)\"]>option";
-
-            auto foundNodeList = htmlParser->css(needle)->toArray();
+            return _parseTransferForm(*response);
+        }
 
-            auto formResult = std::make_shared<BcaTransferForm>();
-            for(auto& node : foundNodeList){
-                auto attrValue = bank_app::lxbGetNodeAttr(node, bank_app::lxbFromString(attr_name));
+        // Run read only operations in one pipelined exchange on the session connection. Every operation has
+        // its own result, one failing to parse does not fail the others.
+        std::vector<BcaBatchResult> batch(const std::vector<BcaBatchOperation>& operations,
+                                          std::pmr::memory_resource* resource = std::pmr::get_default_resource()){
+            if (isLoginTimeout())
+                relogin();
 
-                // two digit random code
-                if(attrValue.length() == 2){
-                    formResult->randomCode = attrValue;
+            std::vector<std::pair<std::tm, std::tm>> ranges(operations.size());
+            std::vector<UpstreamRequest> requests;
+            for(std::size_t i = 0; i < operations.size(); i++){
+                auto& operation = operations[i];
+                switch(operation.kind){
+                    case BcaBatchOperation::BALANCE:
+                        requests.push_back(_balanceRequest());
+                        break;
+                    case BcaBatchOperation::STATEMENT:
+                        ranges[i] = {_localDate(operation.start), _localDate(operation.end)};
+                        requests.push_back(_statementRequest(ranges[i].first, ranges[i].second));
+                        break;
+                    case BcaBatchOperation::TRANSFER_FORM:
+                        requests.push_back(_transferFormRequest());
+                        break;
                 }
-                else if(attrValue.length() > 2){
-                    auto destLine = bank_app::lxbGetInnerHtml(node);
-                    std::vector<std::string> resultTexts;
-                    boost::split(resultTexts, destLine, boost::is_any_of("-"));
-                    boost::algorithm::trim(resultTexts[1]);
-                    formResult->destinationList[attrValue] = resultTexts[1];
+            }
+
+            auto responses = httpClientPtr->sendPipelined(requests);
+
+            std::vector<BcaBatchResult> results(operations.size(), BcaBatchResult{std::pmr::vector<std::pmr::string>(resource)});
+            for(std::size_t i = 0; i < operations.size(); i++){
+                auto& result = results[i];
+                try{
+                    switch(operations[i].kind){
+                        case BcaBatchOperation::BALANCE:
+                            result.balance = _parseBalance(*responses[i]);
+                            result.ok = result.balance != "-1";
+                            break;
+                        case BcaBatchOperation::STATEMENT:
+                            result.statements = _statementLines(*responses[i], ranges[i].first, ranges[i].second, resource);
+                            result.ok = true;
+                            break;
+                        case BcaBatchOperation::TRANSFER_FORM:
+                            result.transferForm = _parseTransferForm(*responses[i]);
+                            result.ok = true;
+                            break;
+                    }
                 }
-                else if(attrValue.length() == 1){
-                    formResult->sourceAccount = bank_app::lxbGetInnerHtml(node);
-                    boost::algorithm::trim(formResult->sourceAccount);
+                catch(std::exception& err){
+                    Logger::warn("bca_batch", "operation failed", err.what());
                 }
             }
 
-            return formResult;
+            return results;
         }
 
-        bool transferFund(BcaTransferData& transferPayload){
-            try{
-                auto refererUrl = getBCAPath(BANK_PATHS::TRANSFER_FORM);
-                auto transferUrl = getBCAPath(BANK_PATHS::TRANSFER_FUND);
+        // Whether BCA executed the transfer, turned it away, or was never asked to execute it. Throws when
+        // the executing request failed after it may have reached BCA, the outcome is then unknown.
+        TransferResult transferFund(BcaTransferData& transferPayload){
+            auto refererUrl = getBCAPath(BANK_PATHS::TRANSFER_FORM);
+            auto transferUrl = getBCAPath(BANK_PATHS::TRANSFER_FUND);
+            std::string secondPayload;
+            HtmlTokenScanner pageScanner;
+            pageScanner.contains("ANGKA YANG ANDA MASUKKAN DARI KEYBCA ANDA SALAH.");
 
+            // the validation step moves no money, when it fails the transfer was not sent
+            try{
                 auto firstPayload = createBcaPayload({
-                     {"value(actions)", "validate"},
-                     {"value(StatusSend)", "notfirst"},
-                     {"value(acc_from)", "0"},
-                     {"value(acc_to2)", "0"},
-                     {"value(acc_to_option)", "V3"},
-                     {"value(acc_to3)", transferPayload.destinationAccount},
-                     {"value(currency)", "Rp."},
-                     {"value(amount)", std::to_string(transferPayload.amount)},
-                     {"value(remarkLine1)", transferPayload.notes1},
-                     {"value(remarkLine2)", transferPayload.notes2},
-                     {"value(keyBCA)", transferPayload.appli2}
+                     {formKey<"value(actions)">, "validate"},
+                     {formKey<"value(StatusSend)">, "notfirst"},
+                     {formKey<"value(acc_from)">, "0"},
+                     {formKey<"value(acc_to2)">, "0"},
+                     {formKey<"value(acc_to_option)">, "V3"},
+                     {formKey<"value(acc_to3)">, transferPayload.destinationAccount},
+                     {formKey<"value(currency)">, "Rp."},
+                     {formKey<"value(amount)">, std::to_string(transferPayload.amount)},
+                     {formKey<"value(remarkLine1)">, transferPayload.notes1},
+                     {formKey<"value(remarkLine2)">, transferPayload.notes2},
+                     {formKey<"value(keyBCA)">, transferPayload.appli2}
                 });
 
-                auto secondPayload = createBcaPayload({
-                    {"value(actions)", "transfer"},
-                    {"value(acc_from)", transferPayload.sourceAccount},
-                    {"value(acc_to)", transferPayload.destinationAccount},
-                    {"value(ref_no)", ""},
-                    {"value(acctToNm)", transferPayload.destinationAccountName},
-                    {"value(currency)", "IDR"},
-                    {"value(amount)", std::to_string(transferPayload.amount)},
-                    {"value(remarkLine1)", transferPayload.notes1},
-                    {"value(remarkLine2)", transferPayload.notes2},
-                    {"value(curToAcc)", "IDR"},
-                    {"value(curFromAcc)", "IDR"},
-                    {"value(acc_type_from)", "1"},
-                    {"value(trans_type)", "0"},
-                    {"value(post_txfer_dt)", ""},
-                    {"value(recur_param)", ""},
-                    {"value(recur_expire_dt)", ""},
-                    {"value(StatusSend)", "notfirst"},
-                    {"value(is_llg)", "0"},
-                    {"value(respondAppli1)", transferPayload.appli1}
+                secondPayload = createBcaPayload({
+                    {formKey<"value(actions)">, "transfer"},
+                    {formKey<"value(acc_from)">, transferPayload.sourceAccount},
+                    {formKey<"value(acc_to)">, transferPayload.destinationAccount},
+                    {formKey<"value(ref_no)">, ""},
+                    {formKey<"value(acctToNm)">, transferPayload.destinationAccountName},
+                    {formKey<"value(currency)">, "IDR"},
+                    {formKey<"value(amount)">, std::to_string(transferPayload.amount)},
+                    {formKey<"value(remarkLine1)">, transferPayload.notes1},
+                    {formKey<"value(remarkLine2)">, transferPayload.notes2},
+                    {formKey<"value(curToAcc)">, "IDR"},
+                    {formKey<"value(curFromAcc)">, "IDR"},
+                    {formKey<"value(acc_type_from)">, "1"},
+                    {formKey<"value(trans_type)">, "0"},
+                    {formKey<"value(post_txfer_dt)">, ""},
+                    {formKey<"value(recur_param)">, ""},
+                    {formKey<"value(recur_expire_dt)">, ""},
+                    {formKey<"value(StatusSend)">, "notfirst"},
+                    {formKey<"value(is_llg)">, "0"},
+                    {formKey<"value(respondAppli1)">, transferPayload.appli1}
                 });
 
-                auto response1 = httpClientPtr->prepareRequest(transferUrl, http::verb::post)
-                        ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                        ->setHeader(http::field::referer, refererUrl)
-                        ->setPayload(firstPayload)
+                auto response1 = httpClientPtr->prepareRequest(bcaTemplate(BANK_PATHS::TRANSFER_FUND, http::verb::post))
+                        ->setCookie(cookieJarPtr->toString())
+                        ->setReferer(refererUrl)
+                        ->setPayload(std::move(firstPayload))
                         ->send()->response();
 
-                auto pageStr1 = boost::beast::buffers_to_string(response1->body().data());
-                const std::string errMessageNeedle = "ANGKA YANG ANDA MASUKKAN DARI KEYBCA ANDA SALAH.";
-
-                if (pageStr1.find(errMessageNeedle) != std::string::npos) {
-                    return false;
+                if (pageScanner.scanBuffers(response1->body().data())) {
+                    return TransferResult::REJECTED;
                 }
+            }
+            catch(std::exception& err){
+                Logger::error("bca_transfer", "transfer not sent", err.what());
+                return TransferResult::NOT_SENT;
+            }
 
-                auto response2 = httpClientPtr->prepareRequest(transferUrl, http::verb::post)
-                        ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                        ->setHeader(http::field::referer, transferUrl)
-                        ->setPayload(secondPayload)
+            try{
+                auto response2 = httpClientPtr->prepareRequest(bcaTemplate(BANK_PATHS::TRANSFER_FUND, http::verb::post))
+                        ->setCookie(cookieJarPtr->toString())
+                        ->setReferer(transferUrl)
+                        ->setPayload(std::move(secondPayload))
                         ->send()->response();
 
-                auto pageStr2 = boost::beast::buffers_to_string(response2->body().data());
-
-                if (pageStr2.find(errMessageNeedle) != std::string::npos) {
-                    return false;
-                }
-
-                return true;
+                return pageScanner.scanBuffers(response2->body().data()) ? TransferResult::REJECTED : TransferResult::EXECUTED;
             }
-            catch(...){
-                std::cerr << "BCA Transfer Failed!" << std::endl;
-                return false;
+            catch(std::exception& err){
+                Logger::error("bca_transfer", "outcome unknown", err.what());
+                throw;
             }
         }
 
@@ -311,22 +580,26 @@ namespace bank_app{
             if (isLoginTimeout())
                 relogin();
 
-            auto refererUrl = std::string(getBCAPath(BANK_PATHS::MENU_PATH));
-            auto balanceInquiryUrl = std::string(getBCAPath(BANK_PATHS::BALANCE_INQUIRY));
-            lxb_char_t cssNeedle[] = "td[align='right'] b";
+            httpClientPtr->prepareCopy(_balanceRequest());
 
-            auto response = httpClientPtr->prepareRequest(balanceInquiryUrl, http::verb::post)
-                    ->setHeader(http::field::cookie, cookieJarPtr->toString())
-                    ->setHeader(http::field::referer, refererUrl)
-                    ->send()->response();
+            // the inquiry only reads, a slow one is raced by the same request on the second connection
+            auto& hedge = balanceHedge();
+            auto startedAt = std::chrono::steady_clock::now();
+            auto client = httpClientPtr.get();
+            bool hedged = false;
 
-            auto pageStr = boost::beast::buffers_to_string(response->body().data());
-            auto pageParser = std::make_unique<HtmlParser>(lxb_string(reinterpret_cast<lxb_char_t*>(pageStr.data()), pageStr.size()));
+            if(auto hedgeDelay = hedge.delay()){
+                if(!hedgeClientPtr)
+                    hedgeClientPtr = std::make_unique<bank_app::HttpClient>(ioc_, host, port, cookieJarPtr.get());
 
-            auto htmlResult = pageParser->css(cssNeedle)->toArrayString();
-            auto lineStr = htmlResult->at(0);
+                client = HttpClient::sendHedged(*httpClientPtr, *hedgeClientPtr, *hedgeDelay, &hedged);
+            }
+            else{
+                client->send();
+            }
+            hedge.record(std::chrono::steady_clock::now() - startedAt, hedged, client != httpClientPtr.get());
 
-            return std::string(reinterpret_cast<char*>(lineStr.data()), lineStr.size());
+            return _parseBalance(*client->response());
         }
 
     };
@@ -0,0 +1,223 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_CLUSTERRING_H
+#define BANK_APP_CLUSTERRING_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <optional>
+#include <random>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <boost/algorithm/string.hpp>
+#include "TokenService.h"
+
+namespace bank_app{
+    struct ClusterNode{
+        std::string id;
+        std::string host;
+        std::string port;
+        // host[:port] the clients reach the node at, empty when they can only reach it through the others
+        std::string publicAddress;
+
+        bool operator==(const ClusterNode& other) const {
+            return id == other.id;
+        }
+    };
+
+    // Consistent hash ring over the replicas of the service.
+    // Every session token starts with an 8 hex digit routing key which is a point on this ring,
+    // the node owning that point is the node holding the session in memory.
+    class ClusterRing{
+        struct RingState{
+            std::map<uint32_t, std::size_t> points;
+            std::vector<ClusterNode> nodes;
+        };
+
+        std::string selfId_;
+        int virtualNodes_;
+        RingState current_, previous_;
+        std::mt19937 keyRandom_;
+        mutable std::shared_mutex mutex_;
+
+        static uint32_t hash(std::string_view value){
+            // FNV-1a followed by murmur3 finalizer for a better spread of close ids
+            uint32_t h = 2166136261u;
+            for(auto ch : value){
+                h ^= static_cast<unsigned char>(ch);
+                h *= 16777619u;
+            }
+            h ^= h >> 16;
+            h *= 0x85ebca6bu;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35u;
+            h ^= h >> 16;
+            return h;
+        }
+
+        RingState build(const std::vector<ClusterNode>& nodes) const {
+            RingState state;
+            state.nodes = nodes;
+
+            for(std::size_t i = 0; i < nodes.size(); ++i){
+                for(int v = 0; v < virtualNodes_; ++v){
+                    state.points.emplace(hash(nodes[i].id + "#" + std::to_string(v)), i);
+                }
+            }
+
+            return state;
+        }
+
+        static const ClusterNode* lookup(const RingState& state, uint32_t point){
+            if(state.points.empty())
+                return nullptr;
+
+            auto it = state.points.lower_bound(point);
+            if(it == state.points.end())
+                it = state.points.begin();
+
+            return &state.nodes[it->second];
+        }
+
+        static std::optional<uint32_t> parseRoutingKey(std::string_view token){
+            uint32_t point = 0;
+
+            if(token.size() != ROUTING_KEY_LENGTH + SESSION_ID_LENGTH)
+                return std::nullopt;
+
+            auto result = std::from_chars(token.data(), token.data() + ROUTING_KEY_LENGTH, point, 16);
+            if(result.ec != std::errc() || result.ptr != token.data() + ROUTING_KEY_LENGTH)
+                return std::nullopt;
+
+            return point;
+        }
+
+    public:
+        static constexpr std::size_t ROUTING_KEY_LENGTH = 8;
+        static constexpr std::size_t SESSION_ID_LENGTH = TokenService::LENGTH - ROUTING_KEY_LENGTH;
+
+        ClusterRing(std::string selfId, int virtualNodes = 128)
+                : selfId_(std::move(selfId)), virtualNodes_(virtualNodes), keyRandom_(std::random_device{}()){
+            setMembers({});
+        }
+
+        const std::string& selfId() const {
+            return selfId_;
+        }
+
+        // parse "node-a=127.0.0.1:8081,node-b=127.0.0.1:8082", an entry may end in "=public-host[:port]"
+        static std::vector<ClusterNode> parseMembers(const std::string& spec){
+            std::vector<ClusterNode> result;
+            std::vector<std::string> entries;
+
+            boost::split(entries, spec, boost::is_any_of(","), boost::token_compress_on);
+
+            for(auto& entry : entries){
+                boost::algorithm::trim(entry);
+
+                auto eqPos = entry.find('=');
+                auto publicPos = eqPos == std::string::npos ? std::string::npos : entry.find('=', eqPos + 1);
+                auto colonPos = entry.rfind(':', publicPos == std::string::npos ? std::string::npos : publicPos - 1);
+                if(entry.empty() || eqPos == std::string::npos || colonPos == std::string::npos || colonPos < eqPos)
+                    continue;
+
+                result.push_back({entry.substr(0, eqPos),
+                                  entry.substr(eqPos + 1, colonPos - eqPos - 1),
+                                  entry.substr(colonPos + 1, publicPos == std::string::npos ? std::string::npos : publicPos - colonPos - 1),
+                                  publicPos == std::string::npos ? "" : entry.substr(publicPos + 1)});
+            }
+
+            return result;
+        }
+
+        // Replace the membership. The previous ring is kept so sessions living on the node that owned
+        // a key before the change can still be reached while they drain.
+        void setMembers(std::vector<ClusterNode> nodes){
+            if(std::find_if(nodes.begin(), nodes.end(), [this](auto& n){ return n.id == selfId_; }) == nodes.end()){
+                nodes.push_back({selfId_, "", ""});
+            }
+
+            std::sort(nodes.begin(), nodes.end(), [](auto& a, auto& b){ return a.id < b.id; });
+
+            auto next = build(nodes);
+
+            std::unique_lock lock(mutex_);
+            previous_ = std::move(current_);
+            current_ = std::move(next);
+        }
+
+        std::vector<ClusterNode> members() const {
+            std::shared_lock lock(mutex_);
+            return current_.nodes;
+        }
+
+        // Generate a routing point which lands on this node in the current ring, the token minted
+        // on it starts with its routing key. Drawn uniformly over the arcs this node owns, a virtual
+        // node owns the points after the one before it up to its own.
+        uint32_t mintRoutingPoint(){
+            std::unique_lock lock(mutex_);
+            auto& points = current_.points;
+
+            // (start, length) of every arc owned here, the length of the only point is the whole ring
+            std::vector<std::pair<uint32_t, uint64_t>> arcs;
+            uint64_t owned = 0;
+            for(auto it = points.begin(); it != points.end(); ++it){
+                if(current_.nodes[it->second].id != selfId_)
+                    continue;
+
+                auto previous = it == points.begin() ? points.rbegin()->first : std::prev(it)->first;
+                uint64_t length = points.size() == 1 ? uint64_t(1) << 32 : static_cast<uint32_t>(it->first - previous);
+                arcs.emplace_back(previous + 1, length);
+                owned += length;
+            }
+
+            if(owned == 0)
+                throw std::runtime_error("node " + selfId_ + " owns no part of the ring");
+
+            auto offset = std::uniform_int_distribution<uint64_t>(0, owned - 1)(keyRandom_);
+            for(auto& [start, length] : arcs){
+                if(offset < length)
+                    return static_cast<uint32_t>(start + offset);
+                offset -= length;
+            }
+            return static_cast<uint32_t>(arcs.back().first + arcs.back().second - 1);
+        }
+
+        // Peers which may hold the session of the given token, in the order they should be asked.
+        // The owner in the current ring comes first, then the owner before the last membership change
+        // and finally every other member, so sessions created before a rebalance stay reachable.
+        std::vector<ClusterNode> candidates(std::string_view token) const {
+            std::vector<ClusterNode> result;
+
+            auto point = parseRoutingKey(token);
+            if(!point)
+                return result;
+
+            auto append = [&](const ClusterNode* node){
+                if(node && node->id != selfId_ && std::find(result.begin(), result.end(), *node) == result.end())
+                    result.push_back(*node);
+            };
+
+            std::shared_lock lock(mutex_);
+            append(lookup(current_, *point));
+            append(lookup(previous_, *point));
+
+            for(auto& node : current_.nodes){
+                append(&node);
+            }
+
+            return result;
+        }
+    };
+}
+
+#endif //BANK_APP_CLUSTERRING_H
@@ -0,0 +1,130 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_CONFIGFILE_H
+#define BANK_APP_CONFIGFILE_H
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <functional>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <boost/algorithm/string/trim.hpp>
+#include "Utility.h"
+#include "Logger.h"
+
+namespace bank_app{
+    // Tunables read from a file of key = value lines, # starts a comment. The file is checked every
+    // interval and the listener called again with all of its values whenever it changed.
+    class ConfigFile{
+    public:
+        typedef std::map<std::string, std::string> Values;
+        typedef std::function<void(const Values& values)> Listener;
+
+    private:
+        std::string path_;
+        Listener listener_;
+        std::chrono::milliseconds interval_;
+        std::optional<std::filesystem::file_time_type> loadedAt_;
+        Values values_;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::thread watcher_;
+
+        static Values parse(std::istream& input){
+            Values values;
+            std::string line;
+            while(std::getline(input, line)){
+                line = line.substr(0, line.find('#'));
+                auto separator = line.find('=');
+                if(separator == std::string::npos)
+                    continue;
+
+                auto key = boost::algorithm::trim_copy(line.substr(0, separator));
+                if(!key.empty())
+                    values[key] = boost::algorithm::trim_copy(line.substr(separator + 1));
+            }
+            return values;
+        }
+
+        // true when the file changed since it was last loaded
+        bool load(){
+            std::error_code ec;
+            auto modified = std::filesystem::last_write_time(path_, ec);
+            if(ec || modified == loadedAt_)
+                return false;
+
+            std::ifstream file(path_);
+            if(!file)
+                return false;
+
+            auto values = parse(file);
+            std::lock_guard lock(mutex_);
+            loadedAt_ = modified;
+            values_ = std::move(values);
+            return true;
+        }
+
+        void run(){
+            std::unique_lock lock(mutex_);
+            while(!wakeup_.wait_for(lock, interval_, [this]{ return stopping_; })){
+                lock.unlock();
+                if(load()){
+                    Logger::info("config", "reloaded", path_);
+                    listener_(values());
+                }
+                lock.lock();
+            }
+        }
+
+    public:
+        // Load the file, a missing one leaves every value at its default, and watch it for changes
+        ConfigFile(std::string path, std::chrono::milliseconds interval = std::chrono::seconds(5))
+                : path_(std::move(path)), interval_(interval){
+            load();
+        }
+
+        ~ConfigFile(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            if(watcher_.joinable())
+                watcher_.join();
+        }
+
+        ConfigFile(const ConfigFile&) = delete;
+        ConfigFile& operator=(const ConfigFile&) = delete;
+
+        // start watching, the listener runs on the watching thread
+        void watch(Listener listener){
+            listener_ = std::move(listener);
+            watcher_ = std::thread([this]{ run(); });
+        }
+
+        Values values(){
+            std::lock_guard lock(mutex_);
+            return values_;
+        }
+
+        // the value of key in the file, else of the environment variable, else fallback
+        std::string get(const std::string& key, const char* environment, const std::string& fallback){
+            auto current = values();
+            auto found = current.find(key);
+            if(found != current.end())
+                return found->second;
+
+            return Utility::getEnv(environment, fallback);
+        }
+    };
+}
+
+#endif //BANK_APP_CONFIGFILE_H
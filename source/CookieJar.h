@@ -1,122 +1,357 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
-#include <map>
-#include <cstdlib>
-#include <cstring>
-#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <charconv>
+#include <limits>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
 
 namespace bank_app {
+	// A cookie packed into one allocation: "name=value" followed by domain and path
 	struct CookieData {
-		std::string key;
-		std::string value;
-		std::string Expires;
-		std::string MaxAge;
-		std::string domain;
-		std::string path;
-		std::string sameSite = "Lax";
-		bool secure = false;
-		bool httpOnly = false;
+		static constexpr uint8_t SECURE = 1;
+		static constexpr uint8_t HTTP_ONLY = 2;
+		// expiresAt value of a cookie living until the session ends
+		static constexpr int64_t SESSION = std::numeric_limits<int64_t>::max();
+
+		std::string storage;
+		uint16_t nameLength = 0;
+		uint16_t valueLength = 0;
+		uint16_t domainLength = 0;
+		uint16_t pathLength = 0;
+		int64_t expiresAt = SESSION; // seconds since epoch
+		uint8_t flags = 0;
+
+		std::string_view pair() const { return std::string_view(storage).substr(0, nameLength + 1 + valueLength); }
+		std::string_view name() const { return std::string_view(storage).substr(0, nameLength); }
+		std::string_view value() const { return std::string_view(storage).substr(nameLength + 1, valueLength); }
+		std::string_view domain() const { return std::string_view(storage).substr(nameLength + 1 + valueLength, domainLength); }
+		std::string_view path() const { return std::string_view(storage).substr(nameLength + 1 + valueLength + domainLength, pathLength); }
+		bool secure() const { return flags & SECURE; }
+		bool httpOnly() const { return flags & HTTP_ONLY; }
+
+		bool operator==(const CookieData& other) const {
+			return storage == other.storage && nameLength == other.nameLength && valueLength == other.valueLength &&
+				domainLength == other.domainLength && expiresAt == other.expiresAt && flags == other.flags;
+		}
 	};
 
 	class CookieJar
 	{
-		std::map<std::string, CookieData> cookies;
+		std::vector<CookieData> cookies;
+		// Cookie request header, rebuilt only after a Set-Cookie changed something
+		std::string header_;
+		bool headerDirty_ = false;
+		int64_t nextExpiry_ = CookieData::SESSION;
+		uint64_t version_ = 0;
+
+		static int64_t nowSeconds()
+		{
+			return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		static std::string_view trim(std::string_view text)
+		{
+			while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+			while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+			return text;
+		}
+
+		static bool iequals(std::string_view a, std::string_view b)
+		{
+			if (a.size() != b.size())
+				return false;
+
+			for (std::size_t i = 0; i < a.size(); ++i) {
+				if ((a[i] | 0x20) != (b[i] | 0x20))
+					return false;
+			}
+
+			return true;
+		}
+
+		// days since 1970-01-01 of a civil date and back, valid for the proleptic gregorian calendar
+		static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+		{
+			y -= m <= 2;
+			const int64_t era = (y >= 0 ? y : y - 399) / 400;
+			const unsigned yoe = static_cast<unsigned>(y - era * 400);
+			const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+			const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+			return era * 146097 + static_cast<int64_t>(doe) - 719468;
+		}
+
+		static void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d)
+		{
+			z += 719468;
+			const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+			const unsigned doe = static_cast<unsigned>(z - era * 146097);
+			const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			const unsigned mp = (5 * doy + 2) / 153;
+			d = doy - (153 * mp + 2) / 5 + 1;
+			m = mp < 10 ? mp + 3 : mp - 9;
+			y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+		}
+
+		static constexpr const char* MONTHS[] = {"jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec"};
+		static constexpr const char* WEEKDAYS[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+
+		// "Wed, 21 Oct 2015 07:28:00 GMT" and the dashed "Wed, 21-Oct-2015 07:28:00 GMT" form
+		static bool parseHttpDate(std::string_view text, int64_t& result)
+		{
+			int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+			int month = -1;
+
+			auto comma = text.find(',');
+			if (comma != std::string_view::npos)
+				text.remove_prefix(comma + 1);
+
+			std::size_t field = 0;
+			while (!text.empty() && field < 4) {
+				auto start = text.find_first_not_of(" -");
+				if (start == std::string_view::npos)
+					break;
+				text.remove_prefix(start);
+
+				auto end = text.find_first_of(" -");
+				auto token = text.substr(0, end);
+				text.remove_prefix(token.size());
+
+				if (field == 0) {
+					std::from_chars(token.data(), token.data() + token.size(), day);
+				}
+				else if (field == 1) {
+					for (int i = 0; i < 12; ++i) {
+						if (token.size() >= 3 && iequals(token.substr(0, 3), MONTHS[i]))
+							month = i + 1;
+					}
+				}
+				else if (field == 2) {
+					std::from_chars(token.data(), token.data() + token.size(), year);
+					if (year < 100)
+						year += year < 70 ? 2000 : 1900;
+				}
+				else if (token.size() >= 8) {
+					std::from_chars(token.data(), token.data() + 2, hour);
+					std::from_chars(token.data() + 3, token.data() + 5, minute);
+					std::from_chars(token.data() + 6, token.data() + 8, second);
+				}
+
+				field++;
+			}
+
+			if (field < 3 || month < 0 || day <= 0)
+				return false;
+
+			result = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+			return true;
+		}
+
+		static std::string formatHttpDate(int64_t seconds)
+		{
+			int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+			int64_t secondOfDay = seconds - days * 86400;
+			int64_t year;
+			unsigned month, day;
+			civilFromDays(days, year, month, day);
+
+			char buffer[40];
+			std::snprintf(buffer, sizeof(buffer), "%s, %02u %c%c%c %04lld %02lld:%02lld:%02lld GMT",
+						  WEEKDAYS[((days % 7) + 7) % 7], day,
+						  MONTHS[month - 1][0] - 32, MONTHS[month - 1][1], MONTHS[month - 1][2],
+						  static_cast<long long>(year), static_cast<long long>(secondOfDay / 3600),
+						  static_cast<long long>(secondOfDay / 60 % 60), static_cast<long long>(secondOfDay % 60));
+			return buffer;
+		}
+
+		void purgeExpired(int64_t now)
+		{
+			if (nextExpiry_ > now)
+				return;
+
+			nextExpiry_ = CookieData::SESSION;
+			for (auto it = cookies.begin(); it != cookies.end();) {
+				if (it->expiresAt <= now) {
+					it = cookies.erase(it);
+					headerDirty_ = true;
+					version_++;
+					continue;
+				}
+
+				nextExpiry_ = std::min(nextExpiry_, it->expiresAt);
+				++it;
+			}
+		}
+
 	public:
-        auto set(std::string cookieParam)
+        auto set(std::string_view cookieParam)
         {
-            char delim[] = ";", eqDelim[] = "=";
-            std::vector<std::string> result;
+            auto now = nowSeconds();
+            auto separator = cookieParam.find(';');
+            auto pairPart = trim(cookieParam.substr(0, separator));
+            auto eqPos = pairPart.find('=');
+
+            if (eqPos == std::string_view::npos || eqPos == 0)
+                return this;
 
-            // first index
-            auto data = std::strtok(const_cast<char*>(cookieParam.c_str()), delim);
+            auto name = trim(pairPart.substr(0, eqPos));
+            auto value = trim(pairPart.substr(eqPos + 1));
+            std::string_view domain, path;
+            std::string lowerDomain;
+            int64_t expiresAt = CookieData::SESSION;
+            bool hasMaxAge = false;
+            uint8_t flags = 0;
 
-            while (data) {
-                auto cookiePart = std::string(data, std::strlen(data));
+            auto rest = separator == std::string_view::npos ? std::string_view() : cookieParam.substr(separator + 1);
+            while (!rest.empty()) {
+                auto next = rest.find(';');
+                auto attribute = trim(rest.substr(0, next));
+                rest = next == std::string_view::npos ? std::string_view() : rest.substr(next + 1);
 
-                boost::trim(cookiePart);
+                auto attrEq = attribute.find('=');
+                auto key = trim(attribute.substr(0, attrEq));
+                auto attrValue = attrEq == std::string_view::npos ? std::string_view() : trim(attribute.substr(attrEq + 1));
 
-                result.push_back(cookiePart);
+                if (iequals(key, "domain")) {
+                    domain = attrValue;
+                }
+                else if (iequals(key, "path")) {
+                    path = attrValue;
+                }
+                else if (iequals(key, "max-age")) {
+                    int64_t maxAge = 0;
+                    if (std::from_chars(attrValue.data(), attrValue.data() + attrValue.size(), maxAge).ec == std::errc()) {
+                        expiresAt = maxAge <= 0 ? 0 : now + maxAge;
+                        hasMaxAge = true;
+                    }
+                }
+                else if (iequals(key, "expires") && !hasMaxAge) {
+                    int64_t expires;
+                    if (parseHttpDate(attrValue, expires))
+                        expiresAt = expires;
+                }
+                else if (iequals(key, "secure")) {
+                    flags |= CookieData::SECURE;
+                }
+                else if (iequals(key, "httponly")) {
+                    flags |= CookieData::HTTP_ONLY;
+                }
+            }
 
-                data = std::strtok(NULL, delim);
+            // domains compare case insensitively, keep them lowercase
+            lowerDomain.assign(domain);
+            for (auto& ch : lowerDomain) {
+                if (ch >= 'A' && ch <= 'Z') ch = static_cast<char>(ch | 0x20);
             }
 
             CookieData cookie;
+            cookie.storage.reserve(name.size() + 1 + value.size() + lowerDomain.size() + path.size());
+            cookie.storage.append(name).append(1, '=').append(value).append(lowerDomain).append(path);
+            cookie.nameLength = static_cast<uint16_t>(name.size());
+            cookie.valueLength = static_cast<uint16_t>(value.size());
+            cookie.domainLength = static_cast<uint16_t>(lowerDomain.size());
+            cookie.pathLength = static_cast<uint16_t>(path.size());
+            cookie.expiresAt = expiresAt;
+            cookie.flags = flags;
 
-            for (auto it = result.begin(); it != result.end(); it++) {
-                if (it == result.begin()) {
-                    auto key = std::strtok(const_cast<char*>(it->c_str()), eqDelim);
-                    auto value = std::strtok(NULL, eqDelim);
+            auto existing = cookies.begin();
+            while (existing != cookies.end() && existing->name() != name) ++existing;
 
-                    cookie.key = std::string(key, strlen(key));
-                    cookie.value = std::string(value, strlen(value));
-                }
-                else {
-                    auto found = it->find('=');
-                    auto keyRaw = std::strtok(const_cast<char*>(it->c_str()), eqDelim);
-                    auto valueRaw = found != std::string::npos ? std::strtok(NULL, eqDelim) : NULL;
-                    auto key = std::string(keyRaw);
-                    boost::to_lower(key);
-
-                    if (valueRaw) {
-                        auto value = std::string(valueRaw, std::strlen(valueRaw));
-                        boost::to_lower(value);
-
-                        if (key == "domain") {
-                            cookie.domain = value;
-                        }
-                        else if (key == "path") {
-                            cookie.path = value;
-                        }
-                        else if (key == "expires") {
-                            cookie.Expires = value;
-                        }
-                        else if (key == "max-age") {
-                            cookie.MaxAge = value;
-                        }
-                    }
-                    else {
-                        if (key == "secure") {
-                            cookie.secure = true;
-                        }
-                        else if(key == "httponly") {
-                            cookie.httpOnly = true;
-                        }
-                    }
+            // a cookie set in the past deletes the stored one
+            if (expiresAt <= now) {
+                if (existing != cookies.end()) {
+                    cookies.erase(existing);
+                    headerDirty_ = true;
+                    version_++;
                 }
+                return this;
+            }
+
+            if (existing != cookies.end()) {
+                if (*existing == cookie)
+                    return this;
+
+                *existing = std::move(cookie);
+            }
+            else {
+                cookies.push_back(std::move(cookie));
             }
 
-            cookies[cookie.key] = cookie;
+            nextExpiry_ = std::min(nextExpiry_, expiresAt);
+            headerDirty_ = true;
+            version_++;
 
             return this;
         }
 
-        auto all()
+        const std::vector<CookieData>& all()
         {
-            auto result = std::make_shared<std::vector<CookieData>>();
+            purgeExpired(nowSeconds());
+            return cookies;
+        }
 
-            if(!cookies.empty()){
-                for (auto& cookie : cookies) {
-                    result->push_back(cookie.second);
-                }
+        // Set-Cookie formatted lines which rebuild this jar through set()
+        auto serialize()
+        {
+            std::vector<std::string> result;
+
+            for (auto& cookie : all()) {
+                std::string line(cookie.pair());
+
+                if (cookie.domainLength) line.append("; Domain=").append(cookie.domain());
+                if (cookie.pathLength) line.append("; Path=").append(cookie.path());
+                if (cookie.expiresAt != CookieData::SESSION) line.append("; Expires=").append(formatHttpDate(cookie.expiresAt));
+                if (cookie.secure()) line.append("; Secure");
+                if (cookie.httpOnly()) line.append("; HttpOnly");
+
+                result.push_back(std::move(line));
             }
 
             return result;
         }
 
-        auto toString(){
-            std::string result = "";
+        std::size_t residentBytes()
+        {
+            std::size_t bytes = sizeof(CookieJar) + header_.capacity() + cookies.capacity() * sizeof(CookieData);
+
+            for (auto& cookie : cookies) {
+                bytes += cookie.storage.capacity();
+            }
+
+            return bytes;
+        }
+
+        // incremented whenever a cookie is added, changed or dropped
+        uint64_t version() const
+        {
+            return version_;
+        }
 
-            if(!cookies.empty()){
+        const std::string& toString(){
+            purgeExpired(nowSeconds());
+
+            if (headerDirty_) {
+                std::size_t size = 0;
                 for (auto& cookie : cookies) {
-                    result += (result.size() > 0 ? "; " : "") + cookie.first + "=" + cookie.second.value;
+                    size += cookie.nameLength + 1 + cookie.valueLength + 2;
+                }
+
+                header_.clear();
+                header_.reserve(size);
+                for (auto& cookie : cookies) {
+                    if (!header_.empty()) header_.append("; ");
+                    header_.append(cookie.pair());
                 }
-            }
 
+                headerDirty_ = false;
+            }
 
-            return result;
+            return header_;
         }
 	};
 }
-
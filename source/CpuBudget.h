@@ -0,0 +1,158 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_CPUBUDGET_H
+#define BANK_APP_CPUBUDGET_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <optional>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+namespace bank_app{
+    // The CPU a process may actually use. Inside a container hardware_concurrency() reports the cores
+    // of the host, the cgroup CPU quota and cpuset are what the scheduler grants.
+    struct CpuBudget{
+        // CPUs the process may run on, its affinity mask, which the cgroup cpuset restricts
+        std::vector<int> cpus;
+        // CFS quota in CPUs, 0 when unlimited
+        double quota = 0;
+        // the cpuset capped by the quota rounded up, at least 1
+        unsigned effective = 1;
+
+        static CpuBudget detect(){
+            CpuBudget budget;
+            budget.cpus = affinity();
+            budget.quota = cgroupQuota().value_or(0);
+
+            auto effective = static_cast<double>(budget.cpus.size());
+            if(budget.quota > 0)
+                effective = std::min(effective, std::ceil(budget.quota));
+            budget.effective = std::max(static_cast<unsigned>(effective), 1u);
+
+            return budget;
+        }
+
+        // the first effective CPUs of the set, where the threads of the pools are pinned to
+        std::vector<int> pinnable() const {
+            return {cpus.begin(), cpus.begin() + std::min<std::size_t>(effective, cpus.size())};
+        }
+
+        // Restrict a thread to one CPU, false when the platform or the cpuset does not allow it
+        static bool pin(std::thread& thread, int cpu){
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+            return false;
+#endif
+        }
+
+        std::string describe() const {
+            std::ostringstream text;
+            text << "cpus=" << cpus.size() << " quota=" << quota << " effective=" << effective;
+            return text.str();
+        }
+
+    private:
+        static std::vector<int> affinity(){
+            std::vector<int> cpus;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(sched_getaffinity(0, sizeof(set), &set) == 0){
+                for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+                    if(CPU_ISSET(cpu, &set))
+                        cpus.push_back(cpu);
+                }
+            }
+#endif
+            if(cpus.empty()){
+                for(unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++){
+                    cpus.push_back(static_cast<int>(cpu));
+                }
+            }
+            return cpus;
+        }
+
+        // cgroup v2 "max 100000" or "200000 100000"
+        static std::optional<double> readCpuMax(const std::string& dir){
+            std::ifstream file(dir + "/cpu.max");
+            std::string quota;
+            double period = 0;
+            if(!(file >> quota >> period) || quota == "max" || period <= 0)
+                return std::nullopt;
+
+            return std::stod(quota) / period;
+        }
+
+        // cgroup v1, a quota of -1 is unlimited
+        static std::optional<double> readCfsQuota(const std::string& dir){
+            std::ifstream quotaFile(dir + "/cpu.cfs_quota_us"), periodFile(dir + "/cpu.cfs_period_us");
+            double quota = -1, period = 0;
+            if(!(quotaFile >> quota) || !(periodFile >> period) || quota <= 0 || period <= 0)
+                return std::nullopt;
+
+            return quota / period;
+        }
+
+        // The smallest quota from the cgroup of the process up to the root of the mount. Without a cgroup
+        // namespace the path names the cgroup on the host, which the container sees mounted as the root.
+        template<class Reader>
+        static std::optional<double> lowestQuota(const std::string& mount, std::string path, Reader&& read){
+            std::optional<double> lowest;
+            while(true){
+                if(auto quota = read(mount + path); quota && (!lowest || *quota < *lowest))
+                    lowest = quota;
+
+                if(path.empty() || path == "/")
+                    return lowest;
+                path = path.substr(0, path.find_last_of('/'));
+            }
+        }
+
+        static std::optional<double> cgroupQuota(){
+            std::ifstream cgroups("/proc/self/cgroup");
+            std::string line;
+            std::optional<double> quota;
+
+            // hierarchy:controllers:path, "0::path" is the unified v2 hierarchy
+            while(std::getline(cgroups, line)){
+                auto first = line.find(':'), second = line.find(':', first + 1);
+                if(first == std::string::npos || second == std::string::npos)
+                    continue;
+
+                auto controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+                auto path = line.substr(second + 1);
+                std::optional<double> found;
+
+                if(line.starts_with("0::"))
+                    found = lowestQuota("/sys/fs/cgroup", path, readCpuMax);
+                else if(controllers.find(",cpu,") != std::string::npos){
+                    found = lowestQuota("/sys/fs/cgroup/cpu,cpuacct", path, readCfsQuota);
+                    if(!found)
+                        found = lowestQuota("/sys/fs/cgroup/cpu", path, readCfsQuota);
+                }
+
+                if(found && (!quota || *found < *quota))
+                    quota = found;
+            }
+            return quota;
+        }
+    };
+}
+
+#endif //BANK_APP_CPUBUDGET_H
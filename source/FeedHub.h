@@ -0,0 +1,252 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_FEEDHUB_H
+#define BANK_APP_FEEDHUB_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include "HttpServer.h"
+#include "Logger.h"
+
+namespace bank_app{
+    // what one poll of a session saw
+    struct FeedSnapshot{
+        std::string balance;
+        // statement rows as date|description|amount, in the order BCA lists them
+        std::vector<std::string> rows;
+    };
+
+    struct FeedHubConfig{
+        std::size_t pollers = 2;
+        // a feed which just changed is polled this often, backing off towards maxInterval while it is quiet
+        std::chrono::milliseconds minInterval{3000};
+        std::chrono::milliseconds maxInterval{30000};
+        double backoff = 1.5;
+    };
+
+    struct FeedHubGauges{
+        std::size_t feeds = 0;
+        std::size_t subscribers = 0;
+        uint64_t polls = 0;
+        uint64_t pollFailures = 0;
+        uint64_t events = 0;
+    };
+
+    // Server-sent event feeds of new transactions and balance changes. Every session is polled by one
+    // feed however many clients subscribed to it, at an interval following how often it changes.
+    class FeedHub{
+    public:
+        // nullopt when the session is gone, which ends its feed
+        typedef std::function<std::optional<FeedSnapshot>(const std::string& token)> Poll;
+
+    private:
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        struct Feed{
+            std::vector<std::shared_ptr<EventSink>> subscribers;
+            std::optional<FeedSnapshot> last;
+            std::chrono::milliseconds interval;
+        };
+
+        FeedHubConfig config_;
+        Poll poll_;
+        std::unordered_map<std::string, Feed> feeds_;
+        std::multimap<TimePoint, std::string> due_;
+        uint64_t polls_ = 0, pollFailures_ = 0, events_ = 0;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::vector<std::thread> pollers_;
+
+        static std::string event(std::string_view name, std::string_view data){
+            std::string message;
+            message.reserve(name.size() + data.size() + 16);
+            message.append("event: ").append(name).append("\ndata: ").append(data).append("\n\n");
+            return message;
+        }
+
+        // the events between two snapshots: a changed balance and the rows not seen before
+        static std::vector<std::string> diff(const std::optional<FeedSnapshot>& last, const FeedSnapshot& current){
+            std::vector<std::string> events;
+            if(!last || last->balance != current.balance)
+                events.push_back(event("balance", current.balance));
+
+            // the first poll is the baseline, only what comes after it is new
+            if(!last)
+                return events;
+
+            // counted, two equal transfers on one day are two rows
+            std::unordered_map<std::string_view, std::size_t> seen;
+            for(auto& row : last->rows){
+                seen[row]++;
+            }
+            for(auto& row : current.rows){
+                auto found = seen.find(row);
+                if(found != seen.end() && found->second > 0){
+                    found->second--;
+                    continue;
+                }
+                events.push_back(event("transaction", row));
+            }
+            return events;
+        }
+
+        void publishLocked(Feed& feed, const std::vector<std::string>& events){
+            std::erase_if(feed.subscribers, [](auto& subscriber){ return subscriber->closed(); });
+
+            for(auto& subscriber : feed.subscribers){
+                for(auto& message : events){
+                    subscriber->push(message);
+                }
+            }
+            events_ += events.size() * feed.subscribers.size();
+        }
+
+        void run(){
+            std::unique_lock lock(mutex_);
+
+            while(!stopping_){
+                if(due_.empty() || due_.begin()->first > std::chrono::steady_clock::now()){
+                    if(due_.empty())
+                        wakeup_.wait(lock);
+                    else
+                        wakeup_.wait_until(lock, due_.begin()->first);
+                    continue;
+                }
+
+                auto token = due_.begin()->second;
+                due_.erase(due_.begin());
+
+                if(!feeds_.contains(token))
+                    continue;
+
+                // polling talks to BCA, never under the lock
+                lock.unlock();
+                std::optional<FeedSnapshot> snapshot;
+                bool failed = false;
+                try{
+                    snapshot = poll_(token);
+                }
+                catch(std::exception& err){
+                    failed = true;
+                    Logger::warn("feed_poll", err.what());
+                }
+                lock.lock();
+
+                polls_++;
+                auto found = feeds_.find(token);
+                if(found == feeds_.end())
+                    continue;
+
+                auto& feed = found->second;
+
+                if(!failed && !snapshot){
+                    publishLocked(feed, {event("end", "session closed")});
+                    for(auto& subscriber : feed.subscribers){
+                        subscriber->close();
+                    }
+                    feeds_.erase(found);
+                    continue;
+                }
+
+                std::vector<std::string> events;
+                if(failed){
+                    pollFailures_++;
+                    feed.interval = config_.maxInterval;
+                }
+                else{
+                    auto baseline = !feed.last;
+                    events = diff(feed.last, *snapshot);
+                    feed.last = std::move(*snapshot);
+
+                    auto changed = !baseline && !events.empty();
+                    feed.interval = changed ? config_.minInterval
+                                            : std::min(config_.maxInterval, std::chrono::duration_cast<std::chrono::milliseconds>(feed.interval * config_.backoff));
+                }
+
+                // a comment line when nothing changed, writing is how a closed client is noticed
+                if(events.empty())
+                    events.push_back(": keep-alive\n\n");
+                publishLocked(feed, events);
+
+                if(feed.subscribers.empty()){
+                    feeds_.erase(found);
+                    continue;
+                }
+                due_.emplace(std::chrono::steady_clock::now() + feed.interval, token);
+            }
+        }
+
+    public:
+        FeedHub(Poll poll, FeedHubConfig config = {}) : config_(config), poll_(std::move(poll)){
+            auto pollers = std::max<std::size_t>(config_.pollers, 1);
+            for(std::size_t i = 0; i < pollers; i++){
+                pollers_.emplace_back([this]{ run(); });
+            }
+        }
+
+        ~FeedHub(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            for(auto& poller : pollers_){
+                poller.join();
+            }
+        }
+
+        FeedHub(const FeedHub&) = delete;
+        FeedHub& operator=(const FeedHub&) = delete;
+
+        // Add a client to the feed of a session, which is started when it is the first one
+        void subscribe(const std::string& token, std::shared_ptr<EventSink> subscriber){
+            std::lock_guard lock(mutex_);
+            auto [found, inserted] = feeds_.try_emplace(token);
+            auto& feed = found->second;
+
+            if(inserted){
+                feed.interval = config_.minInterval;
+                due_.emplace(std::chrono::steady_clock::now(), token);
+                wakeup_.notify_one();
+            }
+            // a late subscriber starts from the balance the others already have
+            else if(feed.last){
+                subscriber->push(event("balance", feed.last->balance));
+                events_++;
+            }
+
+            feed.subscribers.push_back(std::move(subscriber));
+        }
+
+        FeedHubGauges gauges(){
+            std::lock_guard lock(mutex_);
+            FeedHubGauges result;
+            result.feeds = feeds_.size();
+            for(auto& [token, feed] : feeds_){
+                result.subscribers += feed.subscribers.size();
+            }
+            result.polls = polls_;
+            result.pollFailures = pollFailures_;
+            result.events = events_;
+            return result;
+        }
+    };
+}
+
+#endif //BANK_APP_FEEDHUB_H
@@ -14,6 +14,7 @@
 #include <vector>
 #include <memory>
 #include <optional>
+#include <memory_resource>
 #include "exceptions/lexbor_exception.h"
 
 typedef std::basic_string<lxb_char_t> lxb_string;
@@ -107,11 +108,27 @@ namespace bank_app{
         return lxbToString(lxb_string(attr->value->data, attr->value->length));
     }
 
+    // a serialized string takes the text arena of its document until released, otherwise for the life of the document
+    void lxbReleaseStr(lxb_dom_node_t* node, lexbor_str_t* str){
+        lexbor_str_destroy(str, node->owner_document->text, false);
+    }
+
     std::string lxbGetInnerHtml(lxb_dom_node_t* node){
         auto temp = std::make_unique<lexbor_str_t>();
         lxb_html_serialize_deep_str(node, temp.get());
 
-        return lxbToString(lxb_string(temp->data, temp->length));
+        auto html = lxbToString(lxb_string(temp->data, temp->length));
+        lxbReleaseStr(node, temp.get());
+        return html;
+    }
+
+    // serialize straight into a caller owned (arena) string instead of building temporaries
+    void lxbAppendInnerHtml(lxb_dom_node_t* node, std::pmr::string& out){
+        auto temp = std::make_unique<lexbor_str_t>();
+        lxb_html_serialize_deep_str(node, temp.get());
+
+        out.append(reinterpret_cast<char*>(temp->data), temp->length);
+        lxbReleaseStr(node, temp.get());
     }
 
     class HtmlParser{
@@ -174,6 +191,7 @@ namespace bank_app{
                     auto temp = std::make_unique<lexbor_str_t>();
                     lxb_html_serialize_deep_str(result, temp.get());
                     list->push_back(lxb_string(temp->data, temp->length));
+                    lxbReleaseStr(result, temp.get());
                 }
             }
 
@@ -188,6 +206,7 @@ namespace bank_app{
                     auto temp = std::make_unique<lexbor_str_t>();
                     lxb_html_serialize_deep_str(result, temp.get());
                     list->push_back(std::string(reinterpret_cast<char*>(temp->data), temp->length));
+                    lxbReleaseStr(result, temp.get());
                 }
             }
 
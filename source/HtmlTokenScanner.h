@@ -0,0 +1,499 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_HTMLTOKENSCANNER_H
+#define BANK_APP_HTMLTOKENSCANNER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <cctype>
+#include <boost/asio/buffer.hpp>
+#include "HtmlParser.h"
+
+namespace bank_app{
+    // Pulls a few values out of a page on lexbor's tokenizer, without building the DOM. Fields use a
+    // restricted selector: tag names, [attr] and [attr=value] tests, joined by descendant (space) or
+    // child (>) combinators. The scan stops as soon as every field is found.
+    class HtmlTokenScanner{
+        struct AttributeTest{
+            std::string name;
+            std::optional<std::string> value;
+        };
+
+        struct Step{
+            std::string tag;
+            std::vector<AttributeTest> attributes;
+            // combinator to the previous step
+            bool child = false;
+        };
+
+        enum class FieldKind{ TEXT, ATTRIBUTE, CONTAINS };
+
+        struct Field{
+            FieldKind kind;
+            std::vector<Step> steps;
+            std::string attribute;
+            std::string needle;
+            std::optional<std::string> value;
+            // stack depth of the element whose text is being collected, 0 when not collecting
+            std::size_t captureDepth = 0;
+        };
+
+        typedef uint32_t StepMask;
+        static constexpr std::size_t MAX_STEPS = sizeof(StepMask) * 8;
+
+        lxb_html_tokenizer_t* tokenizer;
+        bool used = false;
+        std::vector<Field> fields;
+        std::size_t remaining = 0;
+        // open elements; per element and field the steps matched at the element and at any of its ancestors
+        std::vector<lxb_tag_id_t> openTags;
+        std::vector<StepMask> selfMasks, inheritedMasks;
+        std::string textTail;
+
+        static void errorCheck(lxb_status_t status, std::string source){
+            if(status != LXB_STATUS_OK && status != LXB_STATUS_STOP){
+                throw lexbor_exception(lexborStatusString(status), source, status);
+            }
+        }
+
+        static char lower(char c){
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        static bool equalsIgnoreCase(std::string_view a, std::string_view b){
+            if(a.size() != b.size())
+                return false;
+
+            for(std::size_t i = 0; i < a.size(); i++){
+                if(lower(a[i]) != b[i])
+                    return false;
+            }
+            return true;
+        }
+
+        static bool isVoid(std::string_view tag){
+            static constexpr std::string_view voidTags[] = {
+                    "area", "base", "br", "col", "embed", "hr", "img", "input",
+                    "link", "meta", "param", "source", "track", "wbr"};
+
+            for(auto voidTag : voidTags){
+                if(tag == voidTag)
+                    return true;
+            }
+            return false;
+        }
+
+        static std::vector<Step> compile(std::string_view selector){
+            std::vector<Step> steps;
+            bool child = false;
+            std::size_t i = 0;
+
+            auto invalid = [&]{
+                return lexbor_exception("unsupported selector " + std::string(selector), "HtmlTokenScanner:compile",
+                                        LXB_STATUS_ERROR_WRONG_ARGS);
+            };
+            auto isName = [](char c){
+                return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == ':';
+            };
+
+            while(i < selector.size()){
+                if(selector[i] == ' '){
+                    i++;
+                    continue;
+                }
+                if(selector[i] == '>'){
+                    if(steps.empty() || child)
+                        throw invalid();
+                    child = true;
+                    i++;
+                    continue;
+                }
+
+                Step step;
+                step.child = child;
+                child = false;
+
+                while(i < selector.size() && isName(selector[i])){
+                    step.tag.push_back(lower(selector[i++]));
+                }
+
+                while(i < selector.size() && selector[i] == '['){
+                    AttributeTest test;
+                    i++;
+                    while(i < selector.size() && isName(selector[i])){
+                        test.name.push_back(lower(selector[i++]));
+                    }
+
+                    if(i < selector.size() && selector[i] == '='){
+                        i++;
+                        std::string value;
+                        if(i < selector.size() && (selector[i] == '\'' || selector[i] == '"')){
+                            auto quote = selector[i++];
+                            auto end = selector.find(quote, i);
+                            if(end == std::string_view::npos)
+                                throw invalid();
+
+                            value = selector.substr(i, end - i);
+                            i = end + 1;
+                        }
+                        else{
+                            while(i < selector.size() && selector[i] != ']'){
+                                value.push_back(selector[i++]);
+                            }
+                        }
+                        test.value = std::move(value);
+                    }
+
+                    if(test.name.empty() || i >= selector.size() || selector[i] != ']')
+                        throw invalid();
+                    i++;
+
+                    step.attributes.push_back(std::move(test));
+                }
+
+                if(step.tag.empty() && step.attributes.empty())
+                    throw invalid();
+
+                steps.push_back(std::move(step));
+            }
+
+            if(steps.empty() || child || steps.size() > MAX_STEPS)
+                throw invalid();
+
+            return steps;
+        }
+
+        static bool matches(const Step& step, std::string_view tag, lxb_html_token_t* token){
+            if(!step.tag.empty() && step.tag != tag)
+                return false;
+
+            for(auto& test : step.attributes){
+                bool found = false;
+
+                for(auto attr = token->attr_first; attr != nullptr; attr = attr->next){
+                    std::string_view name(reinterpret_cast<const char*>(attr->name_begin), attr->name_end - attr->name_begin);
+                    if(!equalsIgnoreCase(name, test.name))
+                        continue;
+
+                    std::string_view value;
+                    if(attr->value != nullptr)
+                        value = std::string_view(reinterpret_cast<const char*>(attr->value), attr->value_size);
+
+                    found = !test.value || *test.value == value;
+                    break;
+                }
+
+                if(!found)
+                    return false;
+            }
+
+            return true;
+        }
+
+        static std::optional<std::string> attributeValue(lxb_html_token_t* token, std::string_view attribute){
+            for(auto attr = token->attr_first; attr != nullptr; attr = attr->next){
+                std::string_view name(reinterpret_cast<const char*>(attr->name_begin), attr->name_end - attr->name_begin);
+                if(!equalsIgnoreCase(name, attribute))
+                    continue;
+
+                if(attr->value == nullptr)
+                    return std::string();
+
+                return std::string(reinterpret_cast<const char*>(attr->value), attr->value_size);
+            }
+
+            return std::nullopt;
+        }
+
+        void complete(Field& field){
+            field.captureDepth = 0;
+            remaining--;
+        }
+
+        void open(lxb_html_token_t* token, std::string_view tag){
+            auto count = fields.size();
+            auto parentDepth = openTags.size();
+            std::vector<StepMask> self(count, 0);
+            bool selfClosing = (token->type & LXB_HTML_TOKEN_TYPE_CLOSE_SELF) || isVoid(tag);
+
+            for(std::size_t f = 0; f < count; f++){
+                auto& field = fields[f];
+                if(field.kind == FieldKind::CONTAINS || field.value)
+                    continue;
+
+                StepMask parentSelf = parentDepth ? selfMasks[(parentDepth - 1) * count + f] : 0;
+                StepMask parentInherited = parentDepth ? inheritedMasks[(parentDepth - 1) * count + f] : 0;
+
+                for(std::size_t s = 0; s < field.steps.size(); s++){
+                    auto& step = field.steps[s];
+                    if(s > 0){
+                        auto previous = StepMask(1) << (s - 1);
+                        if(!((step.child ? parentSelf : parentInherited) & previous))
+                            continue;
+                    }
+
+                    if(matches(step, tag, token))
+                        self[f] |= StepMask(1) << s;
+                }
+
+                if(!(self[f] & (StepMask(1) << (field.steps.size() - 1))))
+                    continue;
+
+                if(field.kind == FieldKind::ATTRIBUTE){
+                    field.value = attributeValue(token, field.attribute);
+                    if(field.value)
+                        complete(field);
+                }
+                else if(selfClosing){
+                    field.value = std::string();
+                    complete(field);
+                }
+                else if(field.captureDepth == 0){
+                    field.value = std::string();
+                    field.captureDepth = parentDepth + 1;
+                }
+            }
+
+            if(selfClosing)
+                return;
+
+            openTags.push_back(token->tag_id);
+            for(std::size_t f = 0; f < count; f++){
+                StepMask parentInherited = parentDepth ? inheritedMasks[(parentDepth - 1) * count + f] : 0;
+                selfMasks.push_back(self[f]);
+                inheritedMasks.push_back(parentInherited | self[f]);
+            }
+        }
+
+        void pop(){
+            auto depth = openTags.size();
+            for(auto& field : fields){
+                if(field.captureDepth == depth)
+                    complete(field);
+            }
+
+            openTags.pop_back();
+            selfMasks.resize(openTags.size() * fields.size());
+            inheritedMasks.resize(openTags.size() * fields.size());
+        }
+
+        void close(lxb_tag_id_t tagId){
+            auto found = openTags.size();
+            while(found > 0 && openTags[found - 1] != tagId){
+                found--;
+            }
+
+            // a stray end tag closes nothing
+            while(found > 0 && openTags.size() >= found){
+                pop();
+            }
+        }
+
+        // elements the DOM closes implicitly when a sibling starts, so they do not nest on the stack
+        void closeImplicit(std::string_view tag, lxb_html_tokenizer_t* tkz){
+            auto implied = [&](std::string_view openTag){
+                if(tag == "td" || tag == "th")
+                    return openTag == "td" || openTag == "th";
+                if(tag == "tr")
+                    return openTag == "td" || openTag == "th" || openTag == "tr";
+                if(tag == "option" || tag == "li" || tag == "p")
+                    return openTag == tag;
+                return false;
+            };
+
+            while(!openTags.empty()){
+                size_t length = 0;
+                auto name = lxb_tag_name_by_id(lxb_html_tokenizer_tags(tkz), openTags.back(), &length);
+                if(name == nullptr || !implied(std::string_view(reinterpret_cast<const char*>(name), length)))
+                    break;
+
+                pop();
+            }
+        }
+
+        void onText(std::string_view content){
+            for(auto& field : fields){
+                if(field.value && field.captureDepth != 0)
+                    field.value->append(content);
+            }
+
+            std::string window;
+            for(auto& field : fields){
+                if(field.kind != FieldKind::CONTAINS || field.value)
+                    continue;
+
+                // the sentence may be split across text tokens
+                if(window.empty())
+                    window = textTail + std::string(content);
+
+                if(window.find(field.needle) != std::string::npos){
+                    field.value = field.needle;
+                    complete(field);
+                }
+            }
+
+            std::size_t keep = 0;
+            for(auto& field : fields){
+                if(field.kind == FieldKind::CONTAINS && !field.value && field.needle.size() > keep)
+                    keep = field.needle.size() - 1;
+            }
+
+            if(keep == 0){
+                textTail.clear();
+                return;
+            }
+            textTail.append(content);
+            if(textTail.size() > keep)
+                textTail.erase(0, textTail.size() - keep);
+        }
+
+        static lxb_html_token_t* onToken(lxb_html_tokenizer_t* tkz, lxb_html_token_t* token, void* ctx){
+            auto self = reinterpret_cast<HtmlTokenScanner*>(ctx);
+
+            if(token->tag_id == LXB_TAG__TEXT){
+                self->onText(std::string_view(reinterpret_cast<const char*>(token->text_start), token->text_end - token->text_start));
+            }
+            else if(token->tag_id > LXB_TAG__EM_COMMENT){
+                if(token->type & LXB_HTML_TOKEN_TYPE_CLOSE){
+                    self->close(token->tag_id);
+                }
+                else{
+                    size_t length = 0;
+                    auto name = lxb_tag_name_by_id(lxb_html_tokenizer_tags(tkz), token->tag_id, &length);
+                    std::string_view tag(reinterpret_cast<const char*>(name), name ? length : 0);
+
+                    self->closeImplicit(tag, tkz);
+                    self->open(token, tag);
+
+                    // script, style, textarea and friends switch the tokenizer to raw text like the tree builder does
+                    lxb_html_tokenizer_set_state_by_tag(tkz, false, token->tag_id, LXB_NS_HTML);
+                }
+            }
+
+            if(self->remaining == 0){
+                lxb_html_tokenizer_status_set(tkz, LXB_STATUS_STOP);
+                return nullptr;
+            }
+
+            return token;
+        }
+
+        std::size_t addField(Field field){
+            fields.push_back(std::move(field));
+            return fields.size() - 1;
+        }
+
+        void begin(){
+            if(used)
+                lxb_html_tokenizer_clean(tokenizer);
+            used = true;
+
+            remaining = fields.size();
+            openTags.clear();
+            selfMasks.clear();
+            inheritedMasks.clear();
+            textTail.clear();
+            for(auto& field : fields){
+                field.value.reset();
+                field.captureDepth = 0;
+            }
+
+            lxb_html_tokenizer_callback_token_done_set(tokenizer, onToken, this);
+            errorCheck(lxb_html_tokenizer_begin(tokenizer), "HtmlTokenScanner:lxb_html_tokenizer_begin");
+        }
+
+        // false once the scan stopped early
+        bool chunk(const void* data, std::size_t size){
+            if(remaining == 0)
+                return false;
+
+            auto status = lxb_html_tokenizer_chunk(tokenizer, reinterpret_cast<const lxb_char_t*>(data), size);
+            if(remaining == 0)
+                return false;
+
+            errorCheck(status, "HtmlTokenScanner:lxb_html_tokenizer_chunk");
+            return true;
+        }
+
+        bool end(){
+            if(remaining != 0)
+                errorCheck(lxb_html_tokenizer_end(tokenizer), "HtmlTokenScanner:lxb_html_tokenizer_end");
+
+            // text of an element left open at the end of the page is complete as well
+            for(auto& field : fields){
+                if(field.captureDepth != 0)
+                    complete(field);
+            }
+
+            return remaining == 0;
+        }
+
+    public:
+        HtmlTokenScanner(){
+            tokenizer = lxb_html_tokenizer_create();
+            auto status = lxb_html_tokenizer_init(tokenizer);
+            if(status != LXB_STATUS_OK){
+                lxb_html_tokenizer_destroy(tokenizer);
+                throw lexbor_exception(lexborStatusString(status), "HtmlTokenScanner:lxb_html_tokenizer_init", status);
+            }
+        }
+
+        HtmlTokenScanner(const HtmlTokenScanner&) = delete;
+        HtmlTokenScanner& operator=(const HtmlTokenScanner&) = delete;
+
+        ~HtmlTokenScanner(){
+            lxb_html_tokenizer_destroy(tokenizer);
+        }
+
+        // text content of the first element matching the selector
+        std::size_t text(std::string_view selector){
+            return addField({FieldKind::TEXT, compile(selector)});
+        }
+
+        // value of an attribute of the first element matching the selector which carries it
+        std::size_t attribute(std::string_view selector, std::string_view attributeName){
+            Field field{FieldKind::ATTRIBUTE, compile(selector)};
+            for(auto c : attributeName){
+                field.attribute.push_back(lower(c));
+            }
+            return addField(std::move(field));
+        }
+
+        // found when the sentence occurs in the text of the page
+        std::size_t contains(std::string_view sentence){
+            Field field{FieldKind::CONTAINS};
+            field.needle = sentence;
+            return addField(std::move(field));
+        }
+
+        const std::optional<std::string>& operator[](std::size_t field) const {
+            return fields.at(field).value;
+        }
+
+        // Scan a page, true when every field was found
+        bool scan(std::string_view html){
+            begin();
+            chunk(html.data(), html.size());
+            return end();
+        }
+
+        // Scan a page held in a buffer sequence (a beast dynamic body) chunk by chunk, without flattening it
+        template<class ConstBufferSequence>
+        bool scanBuffers(const ConstBufferSequence& buffers){
+            begin();
+            for(auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers); ++it){
+                boost::asio::const_buffer buffer = *it;
+                if(!chunk(buffer.data(), buffer.size()))
+                    break;
+            }
+            return end();
+        }
+    };
+}
+
+#endif //BANK_APP_HTMLTOKENSCANNER_H
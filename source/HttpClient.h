@@ -10,6 +10,8 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl/error.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/ssl.hpp>
@@ -21,7 +23,22 @@
 #include <optional>
 #include <iomanip>
 #include <atomic>
+#include <array>
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <algorithm>
+#include <chrono>
 #include "CookieJar.h"
+#include "UrlCodec.h"
+#include "RequestContext.h"
+#include "KtlsStream.h"
+#include "CpuBudget.h"
+#include "RequestTemplate.h"
 
 namespace beast = boost::beast; // from <boost/beast.hpp>
 namespace http = beast::http;   // from <boost/beast/http.hpp>
@@ -59,25 +76,259 @@ void add_windows_root_certs(ssl::context &ctx)
 #endif
 
 namespace bank_app {
+    // OpenSSL keeps a read and a write record buffer plus the SSL object per connection
+    constexpr std::size_t TLS_STREAM_ESTIMATED_BYTES = 48 * 1024;
+
+    // longest a single upstream step may take when no request deadline applies, e.g. on background threads
+    constexpr std::chrono::seconds UPSTREAM_STEP_TIMEOUT{30};
+    // a close_notify the peer does not answer is not waited for longer than this
+    constexpr std::chrono::seconds UPSTREAM_SHUTDOWN_TIMEOUT{3};
+
+    // Threads running an io_context, the upstream clients' or the server's. Declared before the clients
+    // so it is destroyed after them, their destructors still talk to the peer. Resized while running,
+    // threads leave once the handler they run returns. Pinned round robin to cpus when given.
+    class IoThreads{
+        struct Thread{
+            std::thread thread;
+            std::atomic<bool> done = false;
+        };
+
+        net::io_context& ioc_;
+        net::executor_work_guard<net::io_context::executor_type> work_;
+        std::list<Thread> threads_;
+        std::vector<int> cpus_;
+        std::size_t running_ = 0;
+        std::size_t started_ = 0;
+        std::mutex mutex_;
+
+        // the pool the current thread belongs to, and whether it was asked to leave
+        static inline thread_local IoThreads* owner_ = nullptr;
+        static inline thread_local bool leaving_ = false;
+
+        void run(Thread& self){
+            owner_ = this;
+            while(!leaving_ && ioc_.run_one() > 0){
+            }
+            self.done = true;
+        }
+
+        // any thread running the io_context may pick it, only one of this pool leaves
+        void retireOne(){
+            net::post(ioc_, [this]{
+                if(owner_ == this)
+                    leaving_ = true;
+                else
+                    retireOne();
+            });
+        }
+
+    public:
+        IoThreads(net::io_context& ioc, std::size_t count, std::vector<int> cpus = {})
+                : ioc_(ioc), work_(net::make_work_guard(ioc)), cpus_(std::move(cpus)){
+            resize(count);
+        }
+
+        ~IoThreads(){
+            work_.reset();
+            for(auto& thread : threads_){
+                thread.thread.join();
+            }
+        }
+
+        IoThreads(const IoThreads&) = delete;
+        IoThreads& operator=(const IoThreads&) = delete;
+
+        void resize(std::size_t count){
+            std::lock_guard lock(mutex_);
+            std::erase_if(threads_, [](auto& thread){
+                if(!thread.done)
+                    return false;
+
+                thread.thread.join();
+                return true;
+            });
+
+            for(; running_ < count; running_++){
+                auto& thread = threads_.emplace_back();
+                thread.thread = std::thread([this, &thread]{ run(thread); });
+                if(!cpus_.empty())
+                    CpuBudget::pin(thread.thread, cpus_[started_ % cpus_.size()]);
+                started_++;
+            }
+            for(; running_ > count; running_--){
+                retireOne();
+            }
+        }
+
+        std::size_t size(){
+            std::lock_guard lock(mutex_);
+            return running_;
+        }
+    };
+
+    // Hedging of one kind of idempotent upstream request, shared by all sessions. The second request
+    // goes out once the first took longer than the 95th percentile of the recent ones.
+    class UpstreamHedge{
+        static constexpr std::size_t WINDOW = 256;
+        static constexpr std::size_t MIN_SAMPLES = 20;
+
+        std::mutex mutex_;
+        std::array<std::chrono::steady_clock::duration, WINDOW> samples_{};
+        std::size_t count_ = 0;
+        std::atomic<bool> enabled_ = false;
+        std::atomic<uint64_t> hedged_ = 0;
+        std::atomic<uint64_t> backupWins_ = 0;
+
+    public:
+        void enable(bool enabled){
+            enabled_ = enabled;
+        }
+
+        // nullopt when disabled or before the window holds enough samples
+        std::optional<std::chrono::steady_clock::duration> delay(){
+            if(!enabled_)
+                return std::nullopt;
+
+            std::lock_guard lock(mutex_);
+            auto size = std::min(count_, WINDOW);
+            if(size < MIN_SAMPLES)
+                return std::nullopt;
+
+            auto window = samples_;
+            auto p95 = window.begin() + size * 95 / 100;
+            std::nth_element(window.begin(), p95, window.begin() + size);
+            return *p95;
+        }
+
+        void record(std::chrono::steady_clock::duration latency, bool hedged, bool backupWon){
+            if(hedged)
+                hedged_++;
+            if(backupWon)
+                backupWins_++;
+
+            std::lock_guard lock(mutex_);
+            samples_[count_++ % WINDOW] = latency;
+        }
+
+        uint64_t hedged() const {
+            return hedged_;
+        }
+
+        uint64_t backupWins() const {
+            return backupWins_;
+        }
+    };
+
+    // Whether requests to the upstream are pipelined, shared by all connections to it. A pipelined exchange
+    // which came back short, the upstream closed after the first response or failed the rest, suspends it
+    // for a cooldown. The connection may have been closed for reasons of its own, the next try tells.
+    class UpstreamPipelining{
+        static constexpr std::chrono::minutes COOLDOWN{5};
+
+        std::atomic<bool> enabled_ = true;
+        // steady clock ticks until which pipelining is suspended
+        std::atomic<std::chrono::steady_clock::rep> suspendedUntil_ = 0;
+        std::atomic<uint64_t> pipelined_ = 0;
+        std::atomic<uint64_t> fallbacks_ = 0;
+
+    public:
+        void enable(bool enabled){
+            enabled_ = enabled;
+        }
+
+        bool enabled() const {
+            return enabled_ && std::chrono::steady_clock::now().time_since_epoch().count() >= suspendedUntil_;
+        }
+
+        void record(bool complete){
+            if(complete){
+                pipelined_++;
+                return;
+            }
+
+            fallbacks_++;
+            suspendedUntil_ = (std::chrono::steady_clock::now() + COOLDOWN).time_since_epoch().count();
+        }
+
+        uint64_t pipelined() const {
+            return pipelined_;
+        }
+
+        uint64_t fallbacks() const {
+            return fallbacks_;
+        }
+    };
+
     const std::string DEFAULT_USER_AGENT = "Mozilla/5.0 (Linux; Android 6.0; Nexus 5 Build/MRA58N) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/46.0.2490.76 Mobile Safari/537.36";
 
     class HttpClient {
         std::string host, port;
-        const int version = 11;
         std::atomic<bool> connectionStarted = false;
         net::io_context& ioc_;
+        // every operation of the connection runs here, on the threads of ioc_
+        net::strand<net::io_context::executor_type> strand_;
         std::unique_ptr<ssl::context> ctx;
         std::unique_ptr<tcp::resolver> resolver;
         beast::flat_buffer buffer;
         std::shared_ptr<http::response<http::dynamic_body>> resPtr;
         std::unique_ptr<beast::ssl_stream<beast::tcp_stream>> beastStream;
-        std::unique_ptr<http::request<http::string_body>> reqPtr;
+        // used in place of beastStream when kernel TLS is enabled
+        std::unique_ptr<KtlsStream> ktlsStream;
+        UpstreamRequest request_;
+        // the request in one piece for kernel TLS, which writes a single buffer per call
+        std::string wire_;
         CookieJar* cookieJar = nullptr;
 
+        // expiry of the next step: the request deadline, but never more than limit away
+        static std::chrono::steady_clock::time_point stepExpiry(std::optional<std::chrono::steady_clock::time_point> deadline,
+                                                                std::chrono::steady_clock::duration limit = UPSTREAM_STEP_TIMEOUT){
+            auto expiry = std::chrono::steady_clock::now() + limit;
+            return deadline ? std::min(expiry, *deadline) : expiry;
+        }
+
+        template<class Function>
+        decltype(auto) withStream(Function&& function){
+            if(ktlsStream)
+                return function(*ktlsStream);
+            return function(*beastStream);
+        }
+
+        // Write a request as a gather of its parts. The beast TLS stream coalesces them into one record,
+        // kernel TLS takes one buffer per call so it gets the request in one piece.
+        template<class Stream, class Handler>
+        void asyncWriteRequest(Stream& stream, const UpstreamRequest& request, Handler&& handler){
+            if constexpr(std::is_same_v<Stream, KtlsStream>){
+                request.serializeTo(wire_);
+                net::async_write(stream, net::buffer(wire_), std::forward<Handler>(handler));
+            }
+            else{
+                net::async_write(stream, request.buffers(), std::forward<Handler>(handler));
+            }
+        }
+
+        // Run one step on the connection and wait for it. A step still running at the expiry fails with
+        // beast::error::timeout, the connection is closed then and reopened by the next request.
+        template<class Initiation>
+        void step(std::chrono::steady_clock::time_point expiry, Initiation&& initiate){
+            std::promise<beast::error_code> done;
+            auto result = done.get_future();
+
+            withStream([&](auto& stream){
+                beast::get_lowest_layer(stream).expires_at(expiry);
+                initiate(stream, [&done](beast::error_code ec, auto&&...){ done.set_value(ec); });
+            });
+
+            auto ec = result.get();
+            if(ec){
+                connectionStarted = false;
+                throw beast::system_error{ec};
+            }
+        }
+
     public:
         HttpClient(net::io_context& ioc,
                    std::string host, std::string port,
-                   const std::optional<CookieJar*>& cookieJarParam = std::nullopt) : ioc_(ioc), host(host), port(port){
+                   const std::optional<CookieJar*>& cookieJarParam = std::nullopt) : ioc_(ioc), strand_(net::make_strand(ioc)), host(host), port(port){
 
             if(cookieJarParam){
                 this->cookieJar = cookieJarParam.value();
@@ -102,6 +353,25 @@ namespace bank_app {
             return resPtr;
         }
 
+        // approximate memory held by this client between requests
+        std::size_t residentBytes(){
+            std::size_t bytes = sizeof(HttpClient) + buffer.capacity();
+
+            if(resPtr)
+                bytes += resPtr->body().size();
+            bytes += request_.capacity() + wire_.capacity();
+            if(connectionStarted)
+                bytes += TLS_STREAM_ESTIMATED_BYTES;
+
+            return bytes;
+        }
+
+        // drop the last response once it was consumed, the request buffers are kept for the next one
+        void releaseResponse(){
+            resPtr.reset();
+            buffer.shrink_to_fit();
+        }
+
         auto headers(){
             auto headers = std::make_shared<std::unordered_map<http::field, std::string>>();
 
@@ -136,30 +406,54 @@ namespace bank_app {
             }
 
             if(cookieJar){
-                auto cookiesPtr = cookies();
-                for(auto& cookie : *cookiesPtr){
-                    cookieJar->set(cookie);
+                for(auto& header : resPtr->base()){
+                    if(header.name() == http::field::set_cookie){
+                        cookieJar->set(std::string_view(header.value().data(), header.value().size()));
+                    }
                 }
             }
         }
 
         HttpClient* openConnection(){
-            resolver = std::make_unique<tcp::resolver>(ioc_);
+            auto deadline = RequestDeadline::current();
+            resolver = std::make_unique<tcp::resolver>(strand_);
 			
-            beastStream = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(ioc_, *ctx);
+            beastStream.reset();
+            ktlsStream.reset();
+            if(KtlsStream::enabled())
+                ktlsStream = std::make_unique<KtlsStream>(strand_, *ctx);
+            else
+                beastStream = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(strand_, *ctx);
+
+            // the resolver has no expiry, a lookup still running at the deadline is left behind
+            auto resolved = std::make_shared<std::promise<tcp::resolver::results_type>>();
+            auto lookup = resolved->get_future();
+            resolver->async_resolve(host, port, [resolved](beast::error_code ec, tcp::resolver::results_type results){
+                if(ec)
+                    resolved->set_exception(std::make_exception_ptr(beast::system_error{ec}));
+                else
+                    resolved->set_value(std::move(results));
+            });
+
+            if(lookup.wait_until(stepExpiry(deadline)) == std::future_status::timeout)
+                throw beast::system_error{beast::error::timeout};
 
-            auto const results = resolver->resolve(host.c_str(), port.c_str());
+            auto const results = lookup.get();
 
-            beast::get_lowest_layer(*beastStream).connect(results);
+            step(stepExpiry(deadline), [&](auto& stream, auto handler){
+                beast::get_lowest_layer(stream).async_connect(results, std::move(handler));
+            });
 
             // Set SNI Hostname (many hosts need this to handshake successfully)
-            if(! (SSL_set_tlsext_host_name(beastStream->native_handle(), host.c_str())))
+            if(! withStream([&](auto& stream){ return SSL_set_tlsext_host_name(stream.native_handle(), host.c_str()); }))
             {
                 beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
                 throw beast::system_error{ec};
             }
 
-            beastStream->handshake(ssl::stream_base::client);
+            step(stepExpiry(deadline), [&](auto& stream, auto handler){
+                stream.async_handshake(ssl::stream_base::client, std::move(handler));
+            });
 
             connectionStarted = true;
 
@@ -168,94 +462,282 @@ namespace bank_app {
 
         HttpClient* closeConnection(){
             if(connectionStarted){
-                connectionStarted = false;
-
-                beast::error_code ec;
-                beastStream->shutdown(ec);
-                if(ec == net::error::eof)
-                {
+                try{
+                    step(stepExpiry(RequestDeadline::current(), UPSTREAM_SHUTDOWN_TIMEOUT), [&](auto& stream, auto handler){
+                        stream.async_shutdown(std::move(handler));
+                    });
+                    connectionStarted = false;
+                }
+                catch(beast::system_error& err){
                     // Rationale:
                     // http://stackoverflow.com/questions/25587403/boost-asio-ssl-async-shutdown-always-finishes-with-an-error
-                    ec = {};
+                    if(err.code() != net::error::eof)
+                        throw;
                 }
-                if(ec)
-                    throw beast::system_error{ec};
             }
 
             return this;
         }
 
-        HttpClient* prepareRequest(std::string target, http::verb method){
+        // Prepare a request on the endpoint of head, only the cookie, referer and payload are added to it
+        HttpClient* prepareRequest(const RequestTemplate& head){
             resPtr = std::make_shared<http::response<http::dynamic_body>>();
-            reqPtr = std::make_unique<http::request<http::string_body>>();
-			
-            reqPtr->method(method);
-            reqPtr->target(target);
-            reqPtr->version(version);
-            reqPtr->keep_alive(true);
-
-            reqPtr->set(http::field::host, host);
-            reqPtr->set(http::field::cache_control, "max-age=0");
-            reqPtr->set("Upgrade-Insecure-Requests", "1");
-            reqPtr->set(http::field::user_agent, DEFAULT_USER_AGENT);
-            reqPtr->set(http::field::accept, "text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8");
-            reqPtr->set(http::field::accept_encoding, "gzip, deflate, sdch, br");
-            reqPtr->set(http::field::accept_language, "en-US,en;q=0.8,id;q=0.6,fr;q=0.4");
-            reqPtr->set(http::field::content_type, "application/x-www-form-urlencoded");
+            request_.reset(head);
 
             return this;
         }
 
         HttpClient* setPayload(std::string body){
-            reqPtr->body() = body;
-            reqPtr->prepare_payload();
-            reqPtr->set(http::field::content_length, std::to_string(body.size()));
+            request_.body(std::move(body));
 
             return this;
         }
 
-        HttpClient* setHeader(http::field fieldType, std::string value){
-            reqPtr->set(fieldType, value);
+        HttpClient* setCookie(std::string cookie){
+            request_.cookie(std::move(cookie));
+
+            return this;
+        }
+
+        // a path of getBCAPath, or another string outliving the request
+        HttpClient* setReferer(std::string_view referer){
+            request_.referer(referer);
+
+            return this;
+        }
+
+        // Prepare a copy of a request prepared elsewhere, e.g. on another client
+        HttpClient* prepareCopy(UpstreamRequest request){
+            resPtr = std::make_shared<http::response<http::dynamic_body>>();
+            request_ = std::move(request);
 
             return this;
         }
 
+        const UpstreamRequest& request(){
+            return request_;
+        }
+
+        // Write the prepared request and read its response on the client threads. onDone runs there
+        // once the response is complete or the exchange failed, each step bounded by the request deadline.
+        void start(std::function<void(beast::error_code)> onDone){
+            if(!connectionStarted){
+                openConnection();
+            }
+
+            auto deadline = RequestDeadline::current();
+            auto finish = [this, onDone = std::move(onDone)](beast::error_code ec){
+                // an upstream answering with Connection: close is done with the connection
+                if(ec || !resPtr->keep_alive())
+                    connectionStarted = false;
+
+                buffer.clear();
+                onDone(ec);
+            };
+
+            withStream([&](auto& stream){
+                beast::get_lowest_layer(stream).expires_at(stepExpiry(deadline));
+                asyncWriteRequest(stream, request_, [this, &stream, deadline, finish](beast::error_code ec, std::size_t){
+                    if(ec)
+                        return finish(ec);
+
+                    beast::get_lowest_layer(stream).expires_at(stepExpiry(deadline));
+                    http::async_read(stream, buffer, *resPtr, [finish](beast::error_code ec, std::size_t){
+                        finish(ec);
+                    });
+                });
+            });
+        }
+
+        // Abandon the running exchange, it completes with an error and the connection is dropped
+        void cancel(){
+            std::promise<void> closed;
+            net::post(strand_, [this, &closed]{
+                if(connectionStarted){
+                    connectionStarted = false;
+
+                    withStream([](auto& stream){ beast::get_lowest_layer(stream).close(); });
+                }
+                closed.set_value();
+            });
+            closed.get_future().wait();
+        }
+
         HttpClient* send(){
-            http::write(*beastStream, *reqPtr);
-            http::read(*beastStream, buffer, *resPtr);
+            std::promise<beast::error_code> done;
+            auto result = done.get_future();
+
+            start([&done](beast::error_code ec){ done.set_value(ec); });
+
+            auto ec = result.get();
+            if(ec)
+                throw beast::system_error{ec};
 
-            buffer.clear();
             return this;
         }
 
-        HttpClient* get(std::string target, const std::optional<std::string>& cookie = std::nullopt){
+        static UpstreamPipelining& pipelining(){
+            static UpstreamPipelining pipelining;
+            return pipelining;
+        }
+
+        // Send the requests back to back on the connection and read the responses in order, HTTP/1.1
+        // pipelining, one round trip for all of them. The requests left unanswered when the upstream closes
+        // or fails part way are sent again one at a time on a new connection, so only requests which are
+        // safe to repeat belong here. Runs one at a time when pipelining is off.
+        std::vector<std::shared_ptr<http::response<http::dynamic_body>>> sendPipelined(const std::vector<UpstreamRequest>& requests){
+            std::vector<std::shared_ptr<http::response<http::dynamic_body>>> responses;
+            auto deadline = RequestDeadline::current();
+
+            if(requests.size() > 1 && pipelining().enabled()){
+                if(!connectionStarted)
+                    openConnection();
+
+                try{
+                    // the requests are small, the socket takes all of them before the first response is read
+                    for(auto& request : requests){
+                        step(stepExpiry(deadline), [&](auto& stream, auto handler){
+                            asyncWriteRequest(stream, request, std::move(handler));
+                        });
+                    }
+
+                    for(std::size_t i = 0; i < requests.size(); i++){
+                        auto response = std::make_shared<http::response<http::dynamic_body>>();
+                        step(stepExpiry(deadline), [&](auto& stream, auto handler){
+                            http::async_read(stream, buffer, *response, std::move(handler));
+                        });
+                        responses.push_back(std::move(response));
+
+                        // the requests after it were dropped by the upstream
+                        if(!responses.back()->keep_alive()){
+                            connectionStarted = false;
+                            break;
+                        }
+                    }
+                }
+                catch(beast::system_error& err){
+                    // out of time, a sequential retry would not finish either. Says nothing about pipelining,
+                    // a slow upstream times out one request at a time just as well.
+                    if(err.code() == beast::error::timeout){
+                        buffer.clear();
+                        throw;
+                    }
+                }
+
+                buffer.clear();
+                pipelining().record(responses.size() == requests.size());
+                if(responses.size() == requests.size())
+                    return responses;
+            }
+
+            for(auto i = responses.size(); i < requests.size(); i++){
+                prepareCopy(requests[i]);
+                send();
+                responses.push_back(resPtr);
+            }
+
+            return responses;
+        }
+
+        // Send the request prepared on primary, and the same request on backup when primary has not answered
+        // within hedgeDelay. For idempotent requests only. Returns the client holding the first response,
+        // the slower exchange is abandoned. hedged tells whether backup was used.
+        static HttpClient* sendHedged(HttpClient& primary, HttpClient& backup, std::chrono::steady_clock::duration hedgeDelay,
+                                      bool* hedged = nullptr){
+            struct Race{
+                std::mutex mutex;
+                std::condition_variable changed;
+                int running = 1;
+                HttpClient* winner = nullptr;
+                beast::error_code error;
+            };
+
+            auto race = std::make_shared<Race>();
+            auto onDone = [race](HttpClient* client){
+                return [race, client](beast::error_code ec){
+                    std::lock_guard lock(race->mutex);
+                    race->running--;
+                    if(!ec && !race->winner)
+                        race->winner = client;
+                    else if(ec)
+                        race->error = ec;
+                    race->changed.notify_all();
+                };
+            };
+
+            auto request = primary.request();
+            primary.start(onDone(&primary));
+
+            std::unique_lock lock(race->mutex);
+            bool backupStarted = false;
+
+            if(!race->changed.wait_for(lock, hedgeDelay, [&]{ return race->running == 0; })){
+                lock.unlock();
+                try{
+                    backup.prepareCopy(request);
+                    if(!backup.connectionStarted)
+                        backup.openConnection();
+                    backupStarted = true;
+                }
+                catch(beast::system_error& err){
+                    // no second connection, primary is all there is
+                }
+                lock.lock();
+
+                if(backupStarted){
+                    race->running++;
+                    lock.unlock();
+                    backup.start(onDone(&backup));
+                    lock.lock();
+                }
+            }
+
+            race->changed.wait(lock, [&]{ return race->winner || race->running == 0; });
+
+            if(race->running > 0){
+                lock.unlock();
+                (race->winner == &primary ? backup : primary).cancel();
+                lock.lock();
+                race->changed.wait(lock, [&]{ return race->running == 0; });
+            }
+
+            if(hedged)
+                *hedged = backupStarted;
+
+            if(!race->winner)
+                throw beast::system_error{race->error};
+
+            return race->winner;
+        }
+
+        HttpClient* get(const RequestTemplate& head, const std::optional<std::string>& cookie = std::nullopt){
             if(!connectionStarted){
                 openConnection();
             }
 
-            prepareRequest(target, http::verb::get);
+            prepareRequest(head);
 
              if(cookie){
-                 setHeader(http::field::cookie, cookie.value());
+                 setCookie(cookie.value());
              }
              else if(cookieJar){
-                 setHeader(http::field::cookie, cookieJar->toString());
+                 setCookie(cookieJar->toString());
              }
 
              return send();
         }
-        HttpClient* post(std::string target, const std::optional<std::string>& cookie = std::nullopt, const std::optional<std::string>& body = std::nullopt){
+        HttpClient* post(const RequestTemplate& head, const std::optional<std::string>& cookie = std::nullopt, const std::optional<std::string>& body = std::nullopt){
             if(!connectionStarted){
                 openConnection();
             }
 
-            prepareRequest(target, http::verb::post);
+            prepareRequest(head);
 
             if(cookie){
-                setHeader(http::field::cookie, cookie.value());
+                setCookie(cookie.value());
             }
             else if(cookieJar){
-                setHeader(http::field::cookie, cookieJar->toString());
+                setCookie(cookieJar->toString());
             }
 
             if(body){
@@ -265,60 +747,16 @@ namespace bank_app {
             return send();
         }
 
-        static std::string UrlEncode(const std::string& value, const std::optional<std::string>& excludedChars = std::nullopt)
+        static std::string UrlEncode(std::string_view value, const std::optional<std::string>& excludedChars = std::nullopt)
         {
-            static auto hex_digt = "0123456789ABCDEF";
-
-            std::string result;
-            result.reserve(value.size() << 1);
-
-            for (auto ch : value)
-            {
-                if(
-                    (excludedChars && (excludedChars.value().find(ch) != std::string::npos))
-                    || (ch >= '0' && ch <= '9')
-                    || (ch >= 'A' && ch <= 'Z')
-                    || (ch >= 'a' && ch <= 'z')
-                )
-                    result.push_back(ch);
-                else
-                {
-                    result += std::string("%") +
-                              hex_digt[static_cast<unsigned char>(ch) >> 4]
-                              +  hex_digt[static_cast<unsigned char>(ch) & 15];
-                }
-            }
-
-            return result;
+            return UrlCodec::encode(value, excludedChars ? UrlSafeSet(*excludedChars) : URL_ALNUM);
         }
 
-        static std::string UrlDecode(const std::string& value)
+        // An invalid escape such as %zz or %4z is kept as it is, it used to decode to whatever strtol
+        // made of it, a NUL byte or \x04
+        static std::string UrlDecode(std::string_view value)
         {
-            std::string result;
-            result.reserve(value.size());
-
-            for (std::size_t i = 0; i < value.size(); ++i)
-            {
-                auto ch = value[i];
-
-                if (ch == '%' && (i + 2) < value.size())
-                {
-                    auto hex = value.substr(i + 1, 2);
-                    auto dec = static_cast<char>(std::strtol(hex.c_str(), nullptr, 16));
-                    result.push_back(dec);
-                    i += 2;
-                }
-                else if (ch == '+')
-                {
-                    result.push_back(' ');
-                }
-                else
-                {
-                    result.push_back(ch);
-                }
-            }
-
-            return result;
+            return UrlCodec::decode(value);
         }
 
     };
@@ -0,0 +1,269 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_HTTPFORWARDER_H
+#define BANK_APP_HTTPFORWARDER_H
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <chrono>
+#include "RequestContext.h"
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace http = beast::http;           // from <boost/beast/http.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+namespace bank_app{
+    const std::string FORWARD_HOPS_HEADER = "X-Bank-App-Hops";
+    // milliseconds left until the deadline of the original request
+    const std::string FORWARD_DEADLINE_HEADER = "X-Bank-App-Deadline-Ms";
+
+    // longest a single step of a forward may take, resolving, connecting, writing or reading, when the
+    // deadline of the request does not end it sooner
+    constexpr std::chrono::seconds FORWARD_STEP_TIMEOUT{30};
+
+    struct ForwardTarget{
+        std::string host;
+        std::string port;
+        // host[:port] the clients reach the replica at, empty when they can not
+        std::string publicAddress;
+    };
+
+    // A forward which failed. Once any byte of the request went out the peer may have acted on it,
+    // such a request must not be sent anywhere again unless it is idempotent.
+    class ForwardError : public beast::system_error{
+        bool delivered_;
+
+    public:
+        ForwardError(beast::error_code ec, bool delivered) : beast::system_error(ec), delivered_(delivered){
+        }
+
+        bool delivered() const {
+            return delivered_;
+        }
+    };
+
+    // Proxies requests to peer replicas over pooled keep-alive connections. The caller's thread waits for
+    // each step while one thread of the forwarder runs them, every step expires.
+    class HttpForwarder{
+        struct PeerPool{
+            std::mutex mutex;
+            std::vector<std::unique_ptr<beast::tcp_stream>> idle;
+        };
+
+        net::io_context ioc_;
+        net::executor_work_guard<net::io_context::executor_type> work_{net::make_work_guard(ioc_)};
+        std::thread runner_{[this]{ ioc_.run(); }};
+        std::mutex poolsMutex_;
+        std::unordered_map<std::string, std::unique_ptr<PeerPool>> pools_;
+        std::size_t maxIdlePerPeer_;
+
+        PeerPool& pool(const std::string& key){
+            std::lock_guard lock(poolsMutex_);
+            auto& entry = pools_[key];
+            if(!entry)
+                entry = std::make_unique<PeerPool>();
+            return *entry;
+        }
+
+        // the deadline of the request being forwarded, but never more than FORWARD_STEP_TIMEOUT away
+        static std::chrono::steady_clock::time_point stepExpiry(){
+            auto expiry = std::chrono::steady_clock::now() + FORWARD_STEP_TIMEOUT;
+            auto deadline = RequestDeadline::current();
+            return deadline ? std::min(expiry, *deadline) : expiry;
+        }
+
+        // Run one step on the stream and wait for it, the bytes it transferred. Throws beast::system_error,
+        // a step still running at the expiry fails with beast::error::timeout and closes the stream.
+        template<class Initiation>
+        static std::size_t step(beast::tcp_stream& stream, Initiation&& initiate){
+            std::promise<std::pair<beast::error_code, std::size_t>> done;
+            auto result = done.get_future();
+
+            stream.expires_at(stepExpiry());
+            initiate([&done](beast::error_code ec, std::size_t transferred){ done.set_value({ec, transferred}); });
+
+            auto [ec, transferred] = result.get();
+            if(ec)
+                throw beast::system_error{ec};
+            return transferred;
+        }
+
+        tcp::resolver::results_type resolve(const std::string& host, const std::string& port){
+            // both outlive this call, the timer may fire after the resolve completed
+            auto resolver = std::make_shared<tcp::resolver>(ioc_);
+            auto timer = std::make_shared<net::steady_timer>(ioc_, stepExpiry());
+            std::promise<std::pair<beast::error_code, tcp::resolver::results_type>> done;
+            auto result = done.get_future();
+
+            timer->async_wait([resolver](beast::error_code ec){
+                if(!ec)
+                    resolver->cancel();
+            });
+            resolver->async_resolve(host, port, [&done, timer](beast::error_code ec, tcp::resolver::results_type results){
+                timer->cancel();
+                done.set_value({ec, std::move(results)});
+            });
+
+            auto [ec, results] = result.get();
+            if(ec == net::error::operation_aborted)
+                ec = beast::error::timeout;
+            if(ec)
+                throw beast::system_error{ec};
+            return results;
+        }
+
+        std::unique_ptr<beast::tcp_stream> connect(const std::string& host, const std::string& port){
+            auto endpoints = resolve(host, port);
+            auto stream = std::make_unique<beast::tcp_stream>(ioc_);
+
+            step(*stream, [&](auto handler){
+                stream->async_connect(endpoints, [handler](beast::error_code ec, const tcp::endpoint&){ handler(ec, 0); });
+            });
+            stream->socket().set_option(tcp::no_delay(true));
+
+            return stream;
+        }
+
+        // an idle connection the peer closed meanwhile reads as readable, with nothing or a reset behind it
+        static bool alive(beast::tcp_stream& stream){
+            char probe;
+            beast::error_code ec;
+            auto& socket = stream.socket();
+
+            socket.non_blocking(true, ec);
+            auto peeked = socket.receive(net::buffer(&probe, 1), tcp::socket::message_peek, ec);
+            socket.non_blocking(false, ec);
+
+            return ec == net::error::would_block || (!ec && peeked > 0);
+        }
+
+        // written counts the bytes of the request which went out, whatever the outcome
+        static http::response<http::string_body> exchange(beast::tcp_stream& stream,
+                                                          http::request<http::string_body>& req,
+                                                          std::size_t& written){
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            http::request_serializer<http::string_body> serializer(req);
+
+            written = 0;
+            while(!serializer.is_done()){
+                written += step(stream, [&](auto handler){
+                    http::async_write_some(stream, serializer, handler);
+                });
+            }
+            step(stream, [&](auto handler){
+                http::async_read(stream, buffer, res, handler);
+            });
+
+            return res;
+        }
+
+    public:
+        explicit HttpForwarder(std::size_t maxIdlePerPeer = 16) : maxIdlePerPeer_(maxIdlePerPeer){
+        }
+
+        ~HttpForwarder(){
+            {
+                std::lock_guard lock(poolsMutex_);
+                pools_.clear();
+            }
+            work_.reset();
+            runner_.join();
+        }
+
+        HttpForwarder(const HttpForwarder&) = delete;
+        HttpForwarder& operator=(const HttpForwarder&) = delete;
+
+        // Throws ForwardError. A connection taken from the pool which turns out closed is replaced once,
+        // as long as nothing of the request went out on it or the method is idempotent.
+        http::response<http::string_body> forward(const std::string& host, const std::string& port,
+                                                  http::verb method, std::string_view target,
+                                                  std::string_view body, int hops){
+            auto& peer = pool(host + ":" + port);
+
+            http::request<http::string_body> req{method, beast::string_view(target.data(), target.size()), 11};
+            req.set(http::field::host, host);
+            req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            req.set(FORWARD_HOPS_HEADER, std::to_string(hops));
+            if(auto deadline = RequestDeadline::current()){
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now());
+                req.set(FORWARD_DEADLINE_HEADER, std::to_string(std::max<int64_t>(remaining.count(), 0)));
+            }
+            req.keep_alive(true);
+            req.body() = std::string(body);
+            req.prepare_payload();
+
+            auto idempotent = method == http::verb::get || method == http::verb::head;
+
+            std::unique_ptr<beast::tcp_stream> stream;
+            {
+                std::lock_guard lock(peer.mutex);
+                while(!stream && !peer.idle.empty()){
+                    stream = std::move(peer.idle.back());
+                    peer.idle.pop_back();
+                    if(!alive(*stream))
+                        stream.reset();
+                }
+            }
+
+            http::response<http::string_body> res;
+            std::size_t written = 0;
+
+            if(stream){
+                try{
+                    res = exchange(*stream, req, written);
+                }
+                catch(beast::system_error& err){
+                    auto ec = err.code();
+
+                    // the peer closed the idle keep-alive connection, retry once on a fresh one
+                    // when it can not have acted on the request
+                    if((ec != http::error::end_of_stream &&
+                        ec != net::error::connection_reset &&
+                        ec != net::error::broken_pipe) ||
+                       (written > 0 && !idempotent))
+                        throw ForwardError(ec, written > 0);
+
+                    stream.reset();
+                }
+            }
+
+            if(!stream){
+                try{
+                    stream = connect(host, port);
+                    res = exchange(*stream, req, written);
+                }
+                catch(beast::system_error& err){
+                    throw ForwardError(err.code(), stream && written > 0);
+                }
+            }
+
+            if(res.keep_alive()){
+                std::lock_guard lock(peer.mutex);
+                if(peer.idle.size() < maxIdlePerPeer_)
+                    peer.idle.push_back(std::move(stream));
+            }
+
+            return res;
+        }
+    };
+}
+
+#endif //BANK_APP_HTTPFORWARDER_H
@@ -8,7 +8,10 @@
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/config.hpp>
+#include <boost/version.hpp>
 #include <algorithm>
+#include <atomic>
+#include <optional>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -16,19 +19,146 @@
 #include <string>
 #include <thread>
 #include <vector>
+#include <deque>
 #include <functional>
+#include <charconv>
+#include <string_view>
+#include <memory_resource>
+#include <boost/beast/ssl.hpp>
+#include <openssl/crypto.h>
+#include "HttpForwarder.h"
+#include "RequestContext.h"
+#include "TlsServerContext.h"
+#include "Logger.h"
+#include "ProcessHandoff.h"
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
+#if defined(BOOST_ASIO_HAS_IO_URING) && BOOST_VERSION < 107800
+#error "BANK_APP_IO_URING needs Boost 1.78 or newer"
+#endif
+
 namespace bank_app{
-    class HttpSession : public std::enable_shared_from_this<HttpSession>{
+    struct RouteDecision{
+        // replicas to try in order, empty when the request is served locally
+        std::vector<ForwardTarget> peers;
+        // the request was forwarded here but the session is not held by this replica
+        bool misdirected = false;
+    };
+
+    // The hop count of an event stream redirected to another replica, the client following the
+    // redirect sends none of our headers. It is the last parameter of the query.
+    const std::string REDIRECT_HOPS_PARAMETER = "hops";
+
+    // Decides whether a request belongs to another replica, hops is the number of
+    // times the request was already forwarded between replicas
+    typedef std::function<RouteDecision(std::string_view target, std::string_view body, int hops)> RouteHandler;
+
+    // Handlers return their response body allocated from the request arena
+    typedef std::function<std::pmr::string(RequestContext& context, std::string_view payload)> EventHandler;
+
+    struct EventKeyHash{
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view key) const {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    // keyed by target, looked up with the request target view without copying it
+    typedef std::unordered_map<std::string, EventHandler, EventKeyHash, std::equal_to<>> EventList;
+
+    // Endpoints under /admin/ and /cluster/ reveal or change the state of the replica. They answer only
+    // requests carrying "Authorization: Bearer <key>", and nobody while no key is set.
+    class AdminAccess{
+        static inline std::string key_;
+
+    public:
+        // before the server runs, BANK_APP_ADMIN_KEY
+        static void setKey(std::string key){
+            key_ = std::move(key);
+        }
+
+        static bool covers(std::string_view target){
+            return target.starts_with("/admin/") || target.starts_with("/cluster/");
+        }
+
+        static bool enabled(){
+            return !key_.empty();
+        }
+
+        static bool allows(std::string_view authorization){
+            constexpr std::string_view scheme = "Bearer ";
+            if(key_.empty() || !authorization.starts_with(scheme))
+                return false;
+
+            auto given = authorization.substr(scheme.size());
+            return given.size() == key_.size() && CRYPTO_memcmp(given.data(), key_.data(), key_.size()) == 0;
+        }
+    };
+
+    // Receives the server-sent events of a streaming response, called from any thread
+    class EventSink{
+    public:
+        virtual ~EventSink() = default;
+        // event is a complete message, e.g. "event: balance\ndata: 100\n\n"
+        virtual void push(std::string event) = 0;
+        // end the stream once the pushed events are written
+        virtual void close() = 0;
+        virtual bool closed() const = 0;
+    };
+
+    // Takes a request over as an event stream, payload is the body or else the query of the target.
+    // Returns false to answer 404 instead.
+    typedef std::function<bool(std::string_view payload, std::shared_ptr<EventSink> sink)> StreamHandler;
+    typedef std::unordered_map<std::string, StreamHandler, EventKeyHash, std::equal_to<>> StreamList;
+
+    typedef http::basic_string_body<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>> ArenaStringBody;
+
+    // asio picks its reactor when it is compiled, see the BANK_APP_IO_URING build option
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    constexpr std::string_view IO_BACKEND = "io_uring";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+    constexpr std::string_view IO_BACKEND = "epoll";
+#elif defined(BOOST_ASIO_HAS_IOCP)
+    constexpr std::string_view IO_BACKEND = "iocp";
+#else
+    constexpr std::string_view IO_BACKEND = "select";
+#endif
+
+    // inline arena of every session, enough for a typical request before touching the heap
+    constexpr std::size_t REQUEST_ARENA_BYTES = 16 * 1024;
+
+    // time a handler has for a request, below the 30 seconds the client socket waits for the response
+    constexpr std::chrono::milliseconds REQUEST_TIMEOUT{25000};
+
+    // events waiting on a slow stream client before its connection is dropped
+    constexpr std::size_t MAX_QUEUED_EVENTS = 256;
+
+    // Shared by the listeners and sessions of a server, a handoff drains it through this
+    struct ServerControl{
+        // requests read and not yet answered
+        std::atomic<uint64_t> inFlight = 0;
+        // answers close the connection, the client reconnects to the process taking over
+        std::atomic<bool> draining = false;
+    };
+
+    // One client connection, Stream is beast::tcp_stream or beast::ssl_stream<beast::tcp_stream>
+    template<class Stream>
+    class HttpSession : public std::enable_shared_from_this<HttpSession<Stream>>, public EventSink{
+        static constexpr bool TLS = !std::is_same_v<Stream, beast::tcp_stream>;
+
         void
         fail(beast::error_code ec, char const* what)
         {
-            std::cerr << what << ": " << ec.message() << "\n";
+            // clients commonly drop TLS connections without close_notify
+            if(ec == net::ssl::error::stream_truncated)
+                return;
+
+            Logger::warn("http_session", what, ec.message());
         }
 
         // This is the C++11 equivalent of a generic lambda.
@@ -47,11 +177,14 @@ namespace bank_app{
             void
             operator()(http::message<isRequest, Body, Fields>&& msg) const
             {
+                if(self_.control_.draining)
+                    msg.keep_alive(false);
+
                 // The lifetime of the message has to extend
                 // for the duration of the async operation so
-                // we use a shared_ptr to manage it.
-                auto sp = std::make_shared<
-                        http::message<isRequest, Body, Fields>>(std::move(msg));
+                // we use a shared_ptr to manage it, allocated from the request arena.
+                auto sp = std::allocate_shared<http::message<isRequest, Body, Fields>>(
+                        std::pmr::polymorphic_allocator<char>(&self_.arena_), std::move(msg));
 
                 // Store a type-erased version of the shared
                 // pointer in the class to keep it alive.
@@ -68,24 +201,49 @@ namespace bank_app{
             }
         };
 
-        beast::tcp_stream stream_;
+        // declared first so it outlives everything allocated from it
+        alignas(std::max_align_t) std::byte arenaBuffer_[REQUEST_ARENA_BYTES];
+        std::pmr::monotonic_buffer_resource arena_;
+        Stream stream_;
         beast::flat_buffer buffer_;
         std::shared_ptr<std::string const> doc_root_;
         http::request<http::string_body> req_;
         std::shared_ptr<void> res_;
         send_lambda lambda_;
-        std::unordered_map<std::string, std::function<std::string(std::string)>>& eventList_;
+        EventList& eventList_;
+        RouteHandler& router_;
+        HttpForwarder& forwarder_;
+        ServerControl& control_;
+        StreamList& streamList_;
+
+        // event stream state, only touched on the strand of the connection
+        std::optional<http::response<http::empty_body>> streamHeader_;
+        std::optional<http::response_serializer<http::empty_body>> streamSerializer_;
+        std::deque<std::string> events_;
+        std::string writingEvent_;
+        bool writing_ = false;
+        bool closing_ = false;
+        std::atomic<bool> closed_ = false;
 
     public:
         // Take ownership of the stream
         HttpSession(
-            tcp::socket&& socket,
+            Stream&& stream,
             std::shared_ptr<std::string const> const& doc_root,
-            std::unordered_map<std::string, std::function<std::string(std::string)>>& eventList)
-        : stream_(std::move(socket))
+            EventList& eventList,
+            RouteHandler& router,
+            HttpForwarder& forwarder,
+            ServerControl& control,
+            StreamList& streamList)
+        : arena_(arenaBuffer_, sizeof(arenaBuffer_), &ArenaUpstream::instance())
+        , stream_(std::move(stream))
         , doc_root_(doc_root)
         , lambda_(*this)
         , eventList_(eventList)
+        , router_(router)
+        , forwarder_(forwarder)
+        , control_(control)
+        , streamList_(streamList)
         {
         }
 
@@ -99,8 +257,41 @@ namespace bank_app{
             // thread-safe by default.
             net::dispatch(stream_.get_executor(),
                           beast::bind_front_handler(
-                                  &HttpSession::do_read,
-                                  shared_from_this()));
+                                  &HttpSession::on_run,
+                                  this->shared_from_this()));
+        }
+
+        void
+        on_run()
+        {
+            if constexpr(TLS){
+                beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+
+                stream_.async_handshake(
+                        ssl::stream_base::server,
+                        beast::bind_front_handler(
+                                &HttpSession::on_handshake,
+                                this->shared_from_this()));
+            }
+            else{
+                do_read();
+            }
+        }
+
+        void
+        on_handshake(beast::error_code ec)
+        {
+            auto& stats = TlsServerContext::stats();
+            if(ec){
+                stats.failed++;
+                return fail(ec, "handshake");
+            }
+
+            stats.handshakes++;
+            if(SSL_session_reused(stream_.native_handle()))
+                stats.resumed++;
+
+            do_read();
         }
 
         void
@@ -110,14 +301,17 @@ namespace bank_app{
             // otherwise the operation behavior is undefined.
             req_ = {};
 
+            // The previous response is gone, hand its memory back in one go
+            arena_.release();
+
             // Set the timeout.
-            stream_.expires_after(std::chrono::seconds(30));
+            beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
 
             // Read a request
             http::async_read(stream_, buffer_, req_,
                              beast::bind_front_handler(
                                      &HttpSession::on_read,
-                                     shared_from_this()));
+                                     this->shared_from_this()));
         }
 
         void
@@ -135,6 +329,7 @@ namespace bank_app{
                 return fail(ec, "read");
 
             // Send the response
+            control_.inFlight++;
             handle_request(*doc_root_, std::move(req_), lambda_);
         }
 
@@ -145,6 +340,7 @@ namespace bank_app{
                 std::size_t bytes_transferred)
         {
             boost::ignore_unused(bytes_transferred);
+            control_.inFlight--;
 
             if(ec)
                 return fail(ec, "write");
@@ -166,13 +362,138 @@ namespace bank_app{
         void
         do_close()
         {
-            // Send a TCP shutdown
-            beast::error_code ec;
-            stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+            if constexpr(TLS){
+                // Send the close_notify, the session lives until the peer answered or the timeout hit
+                beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+                stream_.async_shutdown(
+                        [self = this->shared_from_this()](beast::error_code){});
+            }
+            else{
+                // Send a TCP shutdown
+                beast::error_code ec;
+                stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+
+                // At this point the connection is closed gracefully
+            }
+        }
+
+        // Answer with a chunked text/event-stream the pushed events are written to
+        void
+        start_stream(unsigned version)
+        {
+            // a stream is no request in flight, a drain does not wait for it
+            control_.inFlight--;
+            beast::get_lowest_layer(stream_).expires_never();
+
+            streamHeader_.emplace(http::status::ok, version);
+            streamHeader_->set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            streamHeader_->set(http::field::content_type, "text/event-stream");
+            streamHeader_->set(http::field::cache_control, "no-cache");
+            streamHeader_->set(http::field::access_control_allow_origin, "*");
+            streamHeader_->chunked(true);
+            streamSerializer_.emplace(*streamHeader_);
+
+            writing_ = true;
+            http::async_write_header(stream_, *streamSerializer_,
+                                     beast::bind_front_handler(
+                                             &HttpSession::on_stream_write,
+                                             this->shared_from_this()));
+
+            // the client sends nothing more, this read ends when it goes away
+            stream_.async_read_some(buffer_.prepare(64),
+                                    beast::bind_front_handler(
+                                            &HttpSession::on_stream_read,
+                                            this->shared_from_this()));
+        }
+
+        void
+        write_event()
+        {
+            writing_ = true;
+            writingEvent_ = std::move(events_.front());
+            events_.pop_front();
+
+            net::async_write(stream_, http::make_chunk(net::buffer(writingEvent_)),
+                             beast::bind_front_handler(
+                                     &HttpSession::on_stream_write,
+                                     this->shared_from_this()));
+        }
+
+        void
+        on_stream_write(beast::error_code ec, std::size_t)
+        {
+            writing_ = false;
+            if(ec){
+                closed_ = true;
+                return;
+            }
+
+            if(!events_.empty())
+                return write_event();
 
-            // At this point the connection is closed gracefully
+            if(closing_){
+                writing_ = true;
+                net::async_write(stream_, http::make_chunk_last(),
+                                 [self = this->shared_from_this()](beast::error_code, std::size_t){
+                                     self->closed_ = true;
+                                     self->do_close();
+                                 });
+            }
         }
 
+        void
+        on_stream_read(beast::error_code, std::size_t)
+        {
+            drop_stream();
+        }
+
+        void
+        drop_stream()
+        {
+            closed_ = true;
+            events_.clear();
+            beast::error_code ignored;
+            beast::get_lowest_layer(stream_).socket().close(ignored);
+        }
+
+    public:
+        void
+        push(std::string event) override
+        {
+            net::post(stream_.get_executor(), [self = this->shared_from_this(), event = std::move(event)]() mutable {
+                if(self->closed_ || self->closing_)
+                    return;
+
+                // a client reading slower than the feed produces loses the connection, the queue stays bounded
+                if(self->events_.size() >= MAX_QUEUED_EVENTS)
+                    return self->drop_stream();
+
+                self->events_.push_back(std::move(event));
+                if(!self->writing_)
+                    self->write_event();
+            });
+        }
+
+        void
+        close() override
+        {
+            net::post(stream_.get_executor(), [self = this->shared_from_this()]{
+                if(self->closed_ || self->closing_)
+                    return;
+
+                self->closing_ = true;
+                if(!self->writing_)
+                    self->on_stream_write({}, 0);
+            });
+        }
+
+        bool
+        closed() const override
+        {
+            return closed_;
+        }
+
+    private:
         // This function produces an HTTP response for the given
         // request. The type of the response object depends on the
         // contents of the request, so the interface requires the
@@ -214,32 +535,123 @@ namespace bank_app{
                         return res;
                     };
 
-            // Returns a server error response
-            auto const server_error =
-                    [&req](beast::string_view what)
+            // Returns an error response, what went wrong is logged and never told to the client
+            auto const error_response =
+                    [&req](http::status status, beast::string_view what)
                     {
-                        http::response<http::string_body> res{http::status::internal_server_error, req.version()};
+                        Logger::error("http_request", std::string(http::obsolete_reason(status)),
+                                      std::string_view(what.data(), what.size()));
+
+                        http::response<http::string_body> res{status, req.version()};
                         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
                         res.set(http::field::content_type, "text/html");
                         res.keep_alive(req.keep_alive());
-                        res.body() = "An error occurred: '" + std::string(what) + "'";
+                        res.body() = std::string(http::obsolete_reason(status));
                         res.prepare_payload();
                         return res;
                     };
 
+            auto const server_error =
+                    [&error_response](beast::string_view what)
+                    {
+                        return error_response(http::status::internal_server_error, what);
+                    };
+
             // Request path must be absolute and not contain "..".
             if( req.target().empty() ||
                 req.target()[0] != '/' ||
                 req.target().find("..") != beast::string_view::npos)
                 return send(bad_request("Illegal request-target"));
 
-            auto targetPath = static_cast<std::string>(req.target());
-            if(!eventList_.contains(targetPath)){
-                return send(not_found(targetPath));
+            // a forwarded request keeps whatever is left of the deadline it had on the first replica
+            auto deadline = std::chrono::steady_clock::now() + REQUEST_TIMEOUT;
+            auto deadlineField = req.find(FORWARD_DEADLINE_HEADER);
+            if(deadlineField != req.end()){
+                int64_t remaining = 0;
+                auto remainingValue = deadlineField->value();
+                auto parsed = std::from_chars(remainingValue.data(), remainingValue.data() + remainingValue.size(), remaining);
+                if(parsed.ec == std::errc())
+                    deadline = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(remaining));
+            }
+            RequestDeadline deadlineScope(deadline);
+
+            auto targetPath = std::string_view(req.target().data(), req.target().size());
+
+            int hops = 0;
+            auto hopsField = req.find(FORWARD_HOPS_HEADER);
+            if(hopsField != req.end()){
+                auto hopsValue = hopsField->value();
+                std::from_chars(hopsValue.data(), hopsValue.data() + hopsValue.size(), hops);
+            }
+
+            // Event streams can not go through the forwarder. The client is redirected to the public address
+            // of the replica holding the session instead, over the scheme it came in with, the hop count
+            // travels in the query. A replica clients can not reach is answered with 421, a retry of the
+            // client may land on the right one.
+            auto query = targetPath.find('?');
+            auto streamPath = targetPath.substr(0, query);
+            auto stream = streamList_.find(streamPath);
+            if(stream != streamList_.end()){
+                auto queryString = query == std::string_view::npos ? std::string_view() : targetPath.substr(query + 1);
+                auto inQuery = req.body().empty() && query != std::string_view::npos;
+                auto payload = inQuery ? queryString : std::string_view(req.body());
+                if(router_){
+                    auto parameter = REDIRECT_HOPS_PARAMETER + "=";
+                    auto hopsAt = queryString.rfind(parameter);
+                    if(hopsAt != std::string_view::npos && (hopsAt == 0 || queryString[hopsAt - 1] == '&')){
+                        auto hopsValue = queryString.substr(hopsAt + parameter.size());
+                        std::from_chars(hopsValue.data(), hopsValue.data() + hopsValue.size(), hops);
+                        if(inQuery)
+                            payload = payload.substr(0, hopsAt == 0 ? 0 : hopsAt - 1);
+                    }
+
+                    auto route = router_(streamPath, payload, hops);
+                    if(route.misdirected)
+                        return send(not_found(req.target()));
+
+                    if(!route.peers.empty()){
+                        auto& owner = route.peers.front();
+                        auto reachable = !owner.publicAddress.empty();
+                        http::response<http::string_body> res{reachable ? http::status::temporary_redirect
+                                                                        : http::status::misdirected_request, req.version()};
+                        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+                        // a payload sent in the body is sent again by the client, it is kept out of the URL
+                        if(reachable)
+                            res.set(http::field::location, std::string(TLS ? "https://" : "http://") + owner.publicAddress +
+                                                           std::string(streamPath) + "?" + (inQuery ? std::string(payload) + "&" : "") +
+                                                           parameter + std::to_string(hops + 1));
+                        res.keep_alive(req.keep_alive());
+                        res.prepare_payload();
+                        return send(std::move(res));
+                    }
+                }
+
+                if(!stream->second(payload, this->shared_from_this()))
+                    return send(not_found(req.target()));
+
+                return start_stream(req.version());
+            }
+
+            auto event = eventList_.find(targetPath);
+            if(event == eventList_.end()){
+                return send(not_found(req.target()));
+            }
+
+            if(AdminAccess::covers(targetPath)){
+                auto authorization = req[http::field::authorization];
+                if(!AdminAccess::allows(std::string_view(authorization.data(), authorization.size()))){
+                    http::response<http::string_body> res{AdminAccess::enabled() ? http::status::unauthorized : http::status::forbidden,
+                                                          req.version()};
+                    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+                    if(AdminAccess::enabled())
+                        res.set(http::field::www_authenticate, "Bearer");
+                    res.keep_alive(req.keep_alive());
+                    res.prepare_payload();
+                    return send(std::move(res));
+                }
             }
 
             beast::error_code ec;
-            http::string_body::value_type body = "hello world";
 
             // Make sure we can handle the method
             if( req.method() != http::verb::get &&
@@ -247,10 +659,67 @@ namespace bank_app{
                 req.method() != http::verb::post)
                 return send(bad_request("Unknown HTTP-method"));
 
+            // Hand the request over to the replica owning the session
+            if(router_){
+                auto route = router_(targetPath, req.body(), hops);
+
+                if(route.misdirected){
+                    http::response<http::string_body> res{http::status::misdirected_request, req.version()};
+                    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+                    res.keep_alive(req.keep_alive());
+                    res.prepare_payload();
+                    return send(std::move(res));
+                }
 
-            std::string requestBody = static_cast<std::string>(req.body());
+                for(auto& peer : route.peers){
+                    try{
+                        auto forwarded = forwarder_.forward(peer.host, peer.port, req.method(),
+                                                            targetPath, req.body(), hops + 1);
+                        if(forwarded.result() == http::status::misdirected_request)
+                            continue;
 
-            body = eventList_[targetPath](requestBody);
+                        forwarded.keep_alive(req.keep_alive());
+                        return send(std::move(forwarded));
+                    }
+                    catch(ForwardError& err){
+                        fail(err.code(), "forward");
+
+                        // the peer is unreachable, try the next candidate, unless it may have acted on the request
+                        if(!err.delivered() || req.method() == http::verb::get || req.method() == http::verb::head)
+                            continue;
+
+                        return send(error_response(err.code() == beast::error::timeout ? http::status::gateway_timeout
+                                                                                       : http::status::bad_gateway,
+                                                   err.what()));
+                    }
+                }
+            }
+
+            RequestContext context{&arena_, deadline};
+            std::pmr::string body(&arena_);
+
+            try{
+                body = event->second(context, std::string_view(req.body()));
+            }
+            catch(beast::system_error& err){
+                // the session has more operations queued than its mailbox takes
+                if(err.code() == boost::system::errc::device_or_resource_busy){
+                    http::response<http::string_body> res{http::status::service_unavailable, req.version()};
+                    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+                    res.set(http::field::retry_after, "1");
+                    res.keep_alive(req.keep_alive());
+                    res.prepare_payload();
+                    return send(std::move(res));
+                }
+
+                // an upstream step failed, or ran past the request deadline
+                return send(error_response(err.code() == beast::error::timeout ? http::status::gateway_timeout
+                                                                               : http::status::bad_gateway,
+                                           err.what()));
+            }
+            catch(std::exception& err){
+                return send(server_error(err.what()));
+            }
 
             // Handle an unknown error
             if(ec)
@@ -270,7 +739,7 @@ namespace bank_app{
                 return send(std::move(res));
             }
 
-            http::response<http::string_body> res{
+            http::response<ArenaStringBody> res{
                     std::piecewise_construct,
                     std::make_tuple(std::move(body)),
                     std::make_tuple(http::status::ok, req.version())};
@@ -287,14 +756,21 @@ namespace bank_app{
 
     class HttpListener : public std::enable_shared_from_this<HttpListener>{
         net::io_context& ioc_;
-        std::unordered_map<std::string, std::function<std::string(std::string)>>& eventList_;
+        EventList& eventList_;
+        RouteHandler& router_;
+        HttpForwarder& forwarder_;
+        ServerControl& control_;
+        StreamList& streamList_;
+        // connections are TLS when set
+        TlsServerContext* tls_;
         tcp::acceptor acceptor_;
+        unsigned short port_;
         std::shared_ptr<std::string const> doc_root_;
 
         void
         fail(beast::error_code ec, char const* what)
         {
-            std::cerr << what << ": " << ec.message() << "\n";
+            Logger::error("http_listener", what, ec.message());
         }
 
         void
@@ -313,16 +789,33 @@ namespace bank_app{
         {
             if(ec)
             {
-                fail(ec, "accept");
+                // stop() closed the acceptor
+                if(ec != net::error::operation_aborted)
+                    fail(ec, "accept");
                 return; // To avoid infinite loop
             }
-            else
+            else if(tls_)
             {
                 // Create the session and run it
-                std::make_shared<HttpSession>(
-                        std::move(socket),
+                std::make_shared<HttpSession<beast::ssl_stream<beast::tcp_stream>>>(
+                        beast::ssl_stream<beast::tcp_stream>(std::move(socket), tls_->context()),
                         doc_root_,
-                        eventList_)->run();
+                        eventList_,
+                        router_,
+                        forwarder_,
+                        control_,
+                        streamList_)->run();
+            }
+            else
+            {
+                std::make_shared<HttpSession<beast::tcp_stream>>(
+                        beast::tcp_stream(std::move(socket)),
+                        doc_root_,
+                        eventList_,
+                        router_,
+                        forwarder_,
+                        control_,
+                        streamList_)->run();
             }
 
             // Accept another connection
@@ -333,13 +826,34 @@ namespace bank_app{
                 net::io_context& ioc,
                 tcp::endpoint endpoint,
                 std::shared_ptr<std::string const> const& doc_root,
-                std::unordered_map<std::string, std::function<std::string(std::string)>>& eventList)
+                EventList& eventList,
+                RouteHandler& router,
+                HttpForwarder& forwarder,
+                ServerControl& control,
+                StreamList& streamList,
+                TlsServerContext* tls = nullptr,
+                std::optional<tcp::acceptor::native_handle_type> inherited = std::nullopt)
                 : ioc_(ioc)
                 , acceptor_(net::make_strand(ioc))
+                , port_(endpoint.port())
                 , doc_root_(doc_root)
-                , eventList_(eventList){
+                , eventList_(eventList)
+                , router_(router)
+                , forwarder_(forwarder)
+                , control_(control)
+                , streamList_(streamList)
+                , tls_(tls){
             beast::error_code ec;
 
+            // The socket is already listening, handed over by the previous process
+            if(inherited)
+            {
+                acceptor_.assign(endpoint.protocol(), *inherited, ec);
+                if(ec)
+                    fail(ec, "assign");
+                return;
+            }
+
             // Open the acceptor
             acceptor_.open(endpoint.protocol(), ec);
             if(ec)
@@ -380,41 +894,154 @@ namespace bank_app{
         {
             do_accept();
         }
+
+        // Stop accepting, the listening socket stays open in a process it was handed to
+        void
+        stop()
+        {
+            net::post(acceptor_.get_executor(), [self = shared_from_this()]{
+                beast::error_code ignored;
+                self->acceptor_.close(ignored);
+            });
+        }
+
+        unsigned short
+        port() const
+        {
+            return port_;
+        }
+
+        tcp::acceptor::native_handle_type
+        native_handle()
+        {
+            return acceptor_.native_handle();
+        }
     };
 
     class HttpServer{
         net::io_context& _ioc;
-        std::unordered_map<std::string, std::function<std::string(std::string)>> eventList_;
+        EventList eventList_;
+        StreamList streamList_;
+        RouteHandler router_;
+        HttpForwarder forwarder_;
         unsigned short _port;
+        std::unique_ptr<TlsServerContext> tls_;
+        unsigned short tlsPort_ = 0;
+        ServerControl control_;
+        std::vector<InheritedListener> inherited_;
+        std::vector<std::shared_ptr<HttpListener>> listeners_;
+
+        std::optional<tcp::acceptor::native_handle_type> inheritedFor(unsigned short port){
+            for(auto& listener : inherited_){
+                if(listener.port == port)
+                    return listener.fd;
+            }
+            return std::nullopt;
+        }
 
     public:
         HttpServer(net::io_context& ioc, unsigned short port) : _ioc(ioc), _port(port) {
         }
 
-        void setEvent(std::string key, std::function<std::string(std::string)> callback){
+        void setEvent(std::string key, EventHandler callback){
             eventList_[key] = callback;
         }
 
-        void run(){
-            auto threadCount = std::thread::hardware_concurrency();
+        // serve target as a server-sent event stream, e.g. GET /feed?token
+        void setStream(std::string key, StreamHandler handler){
+            streamList_[key] = std::move(handler);
+        }
+
+        void setRouter(RouteHandler router){
+            router_ = std::move(router);
+        }
+
+        // serve HTTPS on a second port next to the plain one, which the replicas keep using among themselves
+        void enableTls(unsigned short port, std::unique_ptr<TlsServerContext> tls){
+            tlsPort_ = port;
+            tls_ = std::move(tls);
+        }
+
+        // listen on the sockets of the previous process instead of binding new ones, matched by port
+        void adoptListeners(std::vector<InheritedListener> inherited){
+            inherited_ = std::move(inherited);
+        }
+
+        // Bind the listening ports, run() does it when not done before
+        void listen(){
+            if(!listeners_.empty())
+                return;
+
             auto doc_root = std::make_shared<std::string>(".");
             auto const address = net::ip::make_address("0.0.0.0");
 
-            std::vector<std::thread> threadPool;
-
-            // Create and launch a listening port
-            std::make_shared<HttpListener>(
+            listeners_.push_back(std::make_shared<HttpListener>(
                     _ioc,
                     tcp::endpoint{address, _port },
                     doc_root,
-                    eventList_)->run();
+                    eventList_,
+                    router_,
+                    forwarder_,
+                    control_,
+                    streamList_,
+                    nullptr,
+                    inheritedFor(_port)));
+
+            if(tls_){
+                listeners_.push_back(std::make_shared<HttpListener>(
+                        _ioc,
+                        tcp::endpoint{address, tlsPort_ },
+                        doc_root,
+                        eventList_,
+                        router_,
+                        forwarder_,
+                        control_,
+                        streamList_,
+                        tls_.get(),
+                        inheritedFor(tlsPort_)));
+            }
 
-            threadPool.reserve(threadCount);
+            // a socket of the previous process without a listener here, e.g. TLS was turned off
+            for(auto& listener : inherited_){
+#if !defined(_WIN32)
+                if(listener.port != _port && !(tls_ && listener.port == tlsPort_))
+                    ::close(listener.fd);
+#endif
+            }
+        }
+
+        // the listening sockets, to hand them to the next process
+        std::vector<InheritedListener> listeners(){
+            std::vector<InheritedListener> sockets;
+            for(auto& listener : listeners_){
+                sockets.push_back({listener->port(), static_cast<int>(listener->native_handle())});
+            }
+            return sockets;
+        }
 
-            for (int i = 0; i < threadCount; ++i) {
-                threadPool.emplace_back([this]{
-                    _ioc.run();
-                });
+        // Stop accepting and wait up to timeout for the requests in flight, false when some are left
+        bool drain(std::chrono::milliseconds timeout){
+            control_.draining = true;
+            for(auto& listener : listeners_){
+                listener->stop();
+            }
+
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while(control_.inFlight > 0){
+                if(std::chrono::steady_clock::now() >= deadline)
+                    return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return true;
+        }
+
+        // Accept on the listening ports and run the io_context on the calling thread, next to the
+        // threads the owner runs it on (IoThreads, sized from the CPU budget)
+        void run(){
+            // Create and launch the listening ports
+            listen();
+            for(auto& listener : listeners_){
+                listener->run();
             }
 
             _ioc.run();
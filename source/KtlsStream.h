@@ -0,0 +1,282 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_KTLSSTREAM_H
+#define BANK_APP_KTLSSTREAM_H
+
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include "Logger.h"
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace ssl = net::ssl;               // from <boost/asio/ssl.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+namespace bank_app{
+    // TLS on a socket BIO instead of the memory BIO of ssl::stream, so OpenSSL can hand the record layer
+    // to the kernel after the handshake (SSL_OP_ENABLE_KTLS). Without the kernel tls module OpenSSL keeps
+    // encrypting in userspace on the same socket, callers see no difference either way.
+    // Only the operations HttpClient uses are provided, with the expiry semantics of beast::tcp_stream.
+    class KtlsStream{
+        struct Impl{
+            tcp::socket socket;
+            net::steady_timer timer;
+            std::unique_ptr<SSL, decltype(&SSL_free)> ssl;
+            std::optional<std::chrono::steady_clock::time_point> expiry;
+            uint64_t generation = 0;
+            bool pending = false;
+            bool timedOut = false;
+
+            Impl(const net::any_io_executor& executor, ssl::context& context)
+                    : socket(executor), timer(executor), ssl(SSL_new(context.native_handle()), &SSL_free){
+                if(!ssl)
+                    throw beast::system_error{beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category())};
+#if defined(SSL_OP_ENABLE_KTLS)
+                SSL_set_options(ssl.get(), SSL_OP_ENABLE_KTLS);
+#endif
+            }
+        };
+
+        struct Stats{
+            std::atomic<uint64_t> handshakes = 0;
+            std::atomic<uint64_t> kernelSend = 0;
+            std::atomic<uint64_t> kernelReceive = 0;
+        };
+
+        static inline std::atomic<bool> enabled_ = false;
+        std::shared_ptr<Impl> impl_;
+
+        // Arm the expiry for the operation about to run, false when it already passed
+        static bool begin(const std::shared_ptr<Impl>& impl){
+            impl->timedOut = false;
+            if(!impl->expiry)
+                return true;
+            if(std::chrono::steady_clock::now() >= *impl->expiry)
+                return false;
+
+            auto generation = ++impl->generation;
+            impl->pending = true;
+            impl->timer.expires_at(*impl->expiry);
+            impl->timer.async_wait([weak = std::weak_ptr<Impl>(impl), generation](beast::error_code ec){
+                auto impl = weak.lock();
+                if(ec || !impl || !impl->pending || impl->generation != generation)
+                    return;
+
+                impl->timedOut = true;
+                beast::error_code ignored;
+                impl->socket.close(ignored);
+            });
+            return true;
+        }
+
+        template<class Self, class... Results>
+        static void end(const std::shared_ptr<Impl>& impl, Self& self, beast::error_code ec, Results... results){
+            impl->pending = false;
+            impl->timer.cancel();
+            self.complete(impl->timedOut ? beast::error::timeout : ec, results...);
+        }
+
+        static beast::error_code sslError(SSL* ssl, int result){
+            switch(SSL_get_error(ssl, result)){
+                case SSL_ERROR_ZERO_RETURN:
+                    return net::error::eof;
+                case SSL_ERROR_SYSCALL:
+                    if(auto code = ::ERR_get_error())
+                        return {static_cast<int>(code), net::error::get_ssl_category()};
+                    // the peer closed the connection without close_notify
+                    return errno == 0 ? beast::error_code(net::ssl::error::stream_truncated)
+                                      : beast::error_code(errno, boost::system::system_category());
+                default:{
+                    auto code = ::ERR_get_error();
+#if defined(SSL_R_UNEXPECTED_EOF_WHILE_READING)
+                    // reported like ssl::stream does
+                    if(ERR_GET_REASON(code) == SSL_R_UNEXPECTED_EOF_WHILE_READING)
+                        return net::ssl::error::stream_truncated;
+#endif
+                    return {static_cast<int>(code), net::error::get_ssl_category()};
+                }
+            }
+        }
+
+        // Run an OpenSSL call on the strand of the socket until it neither wants to read nor write.
+        // operation returns 1 on success and stores the bytes it moved in its argument.
+        template<class Operation, class Handler>
+        auto run(Operation operation, Handler&& handler){
+            return net::async_compose<Handler, void(beast::error_code, std::size_t)>(
+                    [impl = impl_, operation, phase = 0](auto& self, beast::error_code ec = {}) mutable {
+                        if(phase == 0){
+                            // every OpenSSL call on the connection happens on its strand, never inline
+                            phase = 1;
+                            return net::post(impl->socket.get_executor(), std::move(self));
+                        }
+                        if(phase == 1){
+                            phase = 2;
+                            if(!begin(impl))
+                                return self.complete(beast::error::timeout, 0);
+                        }
+                        if(ec)
+                            return end(impl, self, ec, std::size_t(0));
+
+                        std::size_t transferred = 0;
+                        ::ERR_clear_error();
+                        errno = 0;
+                        auto result = operation(impl->ssl.get(), transferred);
+                        if(result == 1)
+                            return end(impl, self, beast::error_code(), transferred);
+
+                        switch(SSL_get_error(impl->ssl.get(), result)){
+                            case SSL_ERROR_WANT_READ:
+                                return impl->socket.async_wait(tcp::socket::wait_read, std::move(self));
+                            case SSL_ERROR_WANT_WRITE:
+                                return impl->socket.async_wait(tcp::socket::wait_write, std::move(self));
+                            default:
+                                return end(impl, self, sslError(impl->ssl.get(), result), std::size_t(0));
+                        }
+                    }, handler, impl_->socket);
+        }
+
+    public:
+        typedef net::any_io_executor executor_type;
+
+        KtlsStream(const executor_type& executor, ssl::context& context) : impl_(std::make_shared<Impl>(executor, context)){
+        }
+
+        // HttpClient opens its connections through this stream when set, BANK_APP_KTLS. Turned off again
+        // by the first handshake the kernel takes no direction of.
+        static void enable(bool enabled){
+            enabled_ = enabled;
+        }
+
+        static bool enabled(){
+            return enabled_;
+        }
+
+        static Stats& stats(){
+            static Stats stats;
+            return stats;
+        }
+
+        executor_type get_executor(){
+            return impl_->socket.get_executor();
+        }
+
+        SSL* native_handle(){
+            return impl_->ssl.get();
+        }
+
+        // operations started after this fail with beast::error::timeout once it is reached
+        void expires_at(std::chrono::steady_clock::time_point expiry){
+            impl_->expiry = expiry;
+        }
+
+        void close(){
+            beast::error_code ignored;
+            impl_->timer.cancel();
+            impl_->socket.close(ignored);
+        }
+
+        template<class EndpointSequence, class ConnectHandler>
+        auto async_connect(const EndpointSequence& endpoints, ConnectHandler&& handler){
+            return net::async_compose<ConnectHandler, void(beast::error_code, tcp::endpoint)>(
+                    [impl = impl_, endpoints, phase = 0](auto& self, beast::error_code ec = {}, tcp::endpoint endpoint = {}) mutable {
+                        if(phase == 0){
+                            phase = 1;
+                            return net::post(impl->socket.get_executor(), std::move(self));
+                        }
+                        if(phase == 1){
+                            phase = 2;
+                            if(!begin(impl))
+                                return self.complete(beast::error::timeout, endpoint);
+                            return net::async_connect(impl->socket, endpoints, std::move(self));
+                        }
+                        end(impl, self, ec, endpoint);
+                    }, handler, impl_->socket);
+        }
+
+        template<class HandshakeHandler>
+        auto async_handshake(ssl::stream_base::handshake_type, HandshakeHandler&& handler){
+            auto& impl = *impl_;
+            impl.socket.non_blocking(true);
+            SSL_set_fd(impl.ssl.get(), static_cast<int>(impl.socket.native_handle()));
+            SSL_set_connect_state(impl.ssl.get());
+
+            return run([](SSL* ssl, std::size_t&){
+                auto result = SSL_do_handshake(ssl);
+                if(result == 1){
+                    auto& counters = stats();
+                    auto kernelSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+                    auto kernelReceive = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+
+                    counters.handshakes++;
+                    counters.kernelSend += kernelSend ? 1 : 0;
+                    counters.kernelReceive += kernelReceive ? 1 : 0;
+
+                    // no tls module or cipher support, userspace TLS is cheaper through ssl::stream
+                    if(!kernelSend && !kernelReceive && enabled_.exchange(false))
+                        Logger::warn("ktls", "kernel tls unavailable, using userspace tls");
+                }
+                return result;
+            }, [handler = std::forward<HandshakeHandler>(handler)](beast::error_code ec, std::size_t) mutable {
+                handler(ec);
+            });
+        }
+
+        template<class ShutdownHandler>
+        auto async_shutdown(ShutdownHandler&& handler){
+            return run([](SSL* ssl, std::size_t&){
+                // the first call sends close_notify, the next ones wait for the one of the peer
+                auto result = SSL_shutdown(ssl);
+                return result == 0 ? SSL_shutdown(ssl) : result;
+            }, [handler = std::forward<ShutdownHandler>(handler)](beast::error_code ec, std::size_t) mutable {
+                handler(ec);
+            });
+        }
+
+        template<class MutableBufferSequence, class ReadHandler>
+        auto async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler){
+            net::mutable_buffer buffer = beast::buffers_front(buffers);
+            return run([buffer](SSL* ssl, std::size_t& transferred){
+                if(buffer.size() == 0)
+                    return 1;
+
+                auto data = static_cast<char*>(buffer.data());
+                auto size = std::min<std::size_t>(buffer.size(), INT_MAX);
+                auto result = SSL_read_ex(ssl, data, size, &transferred);
+
+                // take the records which already arrived too, one completion instead of one per record
+                std::size_t more = 0;
+                while(result == 1 && transferred < size && SSL_read_ex(ssl, data + transferred, size - transferred, &more) == 1){
+                    transferred += more;
+                }
+                return result;
+            }, std::forward<ReadHandler>(handler));
+        }
+
+        template<class ConstBufferSequence, class WriteHandler>
+        auto async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler){
+            net::const_buffer buffer = beast::buffers_front(buffers);
+            return run([buffer](SSL* ssl, std::size_t& transferred){
+                if(buffer.size() == 0)
+                    return 1;
+                return SSL_write_ex(ssl, buffer.data(), std::min<std::size_t>(buffer.size(), INT_MAX), &transferred);
+            }, std::forward<WriteHandler>(handler));
+        }
+    };
+}
+
+#endif //BANK_APP_KTLSSTREAM_H
@@ -0,0 +1,231 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_MEMORYACCOUNTING_H
+#define BANK_APP_MEMORYACCOUNTING_H
+
+#include <lexbor/core/lexbor.h>
+#include <openssl/crypto.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace bank_app{
+    enum class MemorySubsystem{
+        LEXBOR,
+        OPENSSL,
+        COUNT
+    };
+
+    struct MemoryCounters{
+        std::size_t liveBytes = 0;
+        std::size_t liveAllocations = 0;
+        uint64_t allocations = 0;
+    };
+
+    struct MemoryBudgets{
+        // 0 is no limit
+        std::size_t process = 0;
+        std::size_t lexbor = 0;
+        std::size_t openssl = 0;
+    };
+
+    // one cache line per subsystem, the libraries allocate from every thread
+    struct alignas(64) MemoryCounter{
+        std::atomic<std::size_t> liveBytes = 0;
+        std::atomic<std::size_t> liveAllocations = 0;
+        std::atomic<uint64_t> allocations = 0;
+    };
+
+    // Live bytes of the C libraries allocating behind our back, counted through their allocator hooks.
+    // Every block carries a header with its size, freed blocks are subtracted exactly.
+    class MemoryAccounting{
+        // keeps the block behind it aligned like malloc does
+        static constexpr std::size_t HEADER = alignof(std::max_align_t);
+
+        static inline MemoryCounter counters_[static_cast<std::size_t>(MemorySubsystem::COUNT)];
+        static inline std::atomic<bool> installed_ = false;
+
+        static MemoryCounter& counter(MemorySubsystem subsystem){
+            return counters_[static_cast<std::size_t>(subsystem)];
+        }
+
+        template<MemorySubsystem Subsystem>
+        static void* allocated(void* block, std::size_t size){
+            if(!block)
+                return nullptr;
+
+            std::memcpy(block, &size, sizeof(size));
+            auto& accounted = counter(Subsystem);
+            accounted.liveBytes.fetch_add(size, std::memory_order_relaxed);
+            accounted.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+            accounted.allocations.fetch_add(1, std::memory_order_relaxed);
+            return static_cast<char*>(block) + HEADER;
+        }
+
+        // the block of a user pointer and forget its size
+        template<MemorySubsystem Subsystem>
+        static void* released(void* pointer){
+            auto block = static_cast<char*>(pointer) - HEADER;
+            std::size_t size;
+            std::memcpy(&size, block, sizeof(size));
+
+            auto& accounted = counter(Subsystem);
+            accounted.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+            accounted.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        template<MemorySubsystem Subsystem>
+        static void* allocate(std::size_t size){
+            return allocated<Subsystem>(std::malloc(size + HEADER), size);
+        }
+
+        template<MemorySubsystem Subsystem>
+        static void* reallocate(void* pointer, std::size_t size){
+            if(!pointer)
+                return allocate<Subsystem>(size);
+
+            // accounted as freed and allocated again, the old block is gone either way unless realloc fails
+            std::size_t previous;
+            std::memcpy(&previous, static_cast<char*>(pointer) - HEADER, sizeof(previous));
+            auto block = released<Subsystem>(pointer);
+
+            auto moved = std::realloc(block, size + HEADER);
+            if(!moved){
+                allocated<Subsystem>(block, previous);
+                return nullptr;
+            }
+            return allocated<Subsystem>(moved, size);
+        }
+
+        template<MemorySubsystem Subsystem>
+        static void deallocate(void* pointer){
+            if(pointer)
+                std::free(released<Subsystem>(pointer));
+        }
+
+        static void* lexborCalloc(std::size_t count, std::size_t size){
+            if(size != 0 && count > (SIZE_MAX - HEADER) / size)
+                return nullptr;
+
+            auto bytes = count * size;
+            return allocated<MemorySubsystem::LEXBOR>(std::calloc(1, bytes + HEADER), bytes);
+        }
+
+        static void* opensslMalloc(std::size_t size, const char*, int){
+            return allocate<MemorySubsystem::OPENSSL>(size);
+        }
+
+        static void* opensslRealloc(void* pointer, std::size_t size, const char*, int){
+            return reallocate<MemorySubsystem::OPENSSL>(pointer, size);
+        }
+
+        static void opensslFree(void* pointer, const char*, int){
+            deallocate<MemorySubsystem::OPENSSL>(pointer);
+        }
+
+    public:
+        // Route the lexbor and OpenSSL allocations through the counters. Has to run before either library
+        // allocated anything, see the constructor function below. BANK_APP_MEMORY_ACCOUNTING=0 skips it.
+        static void install(){
+            auto disabled = std::getenv("BANK_APP_MEMORY_ACCOUNTING");
+            if((disabled && std::string_view(disabled) == "0") || installed_.exchange(true))
+                return;
+
+            // OpenSSL refuses once it allocated, its blocks then simply stay unaccounted
+            CRYPTO_set_mem_functions(&opensslMalloc, &opensslRealloc, &opensslFree);
+            lexbor_memory_setup(&allocate<MemorySubsystem::LEXBOR>, &reallocate<MemorySubsystem::LEXBOR>,
+                                &lexborCalloc, &deallocate<MemorySubsystem::LEXBOR>);
+        }
+
+        static bool installed(){
+            return installed_;
+        }
+
+        static MemoryCounters counters(MemorySubsystem subsystem){
+            auto& accounted = counter(subsystem);
+            return {accounted.liveBytes.load(std::memory_order_relaxed),
+                    accounted.liveAllocations.load(std::memory_order_relaxed),
+                    accounted.allocations.load(std::memory_order_relaxed)};
+        }
+
+        static std::size_t residentBytes(){
+#if defined(_WIN32)
+            return 0;
+#else
+            std::size_t pages = 0, resident = 0;
+            std::ifstream("/proc/self/statm") >> pages >> resident;
+            return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+        }
+
+        // bytes handed out by malloc, every subsystem included
+        static std::size_t heapBytes(){
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+            auto info = mallinfo2();
+            return info.uordblks + info.hblkhd;
+#else
+            return 0;
+#endif
+        }
+
+        // What the process budget is held against. Bytes malloc handed out follow frees right away, the
+        // resident size rarely shrinks once glibc kept the pages. Resident size only without mallinfo2.
+        static std::size_t processBytes(){
+            auto heap = heapBytes();
+            return heap ? heap : residentBytes();
+        }
+
+        // give the free pages at the top of the malloc arenas back to the system
+        static void trim(){
+#if defined(__GLIBC__)
+            malloc_trim(0);
+#endif
+        }
+
+        // the bytes measured against the budget of the given name
+        static std::size_t usage(std::string_view budget){
+            if(budget == "process")
+                return processBytes();
+            if(budget == "lexbor")
+                return counters(MemorySubsystem::LEXBOR).liveBytes;
+            if(budget == "openssl")
+                return counters(MemorySubsystem::OPENSSL).liveBytes;
+            return 0;
+        }
+
+        // the first budget exceeded, empty when all hold
+        static std::string_view overBudget(const MemoryBudgets& budgets){
+            if(budgets.process && processBytes() > budgets.process)
+                return "process";
+            if(budgets.lexbor && counters(MemorySubsystem::LEXBOR).liveBytes > budgets.lexbor)
+                return "lexbor";
+            if(budgets.openssl && counters(MemorySubsystem::OPENSSL).liveBytes > budgets.openssl)
+                return "openssl";
+            return {};
+        }
+    };
+
+#if defined(__GNUC__)
+    // ahead of the static initializers, Boost.Asio initializes OpenSSL from one
+    __attribute__((constructor(101))) static void installMemoryAccounting(){
+        MemoryAccounting::install();
+    }
+#endif
+}
+
+#endif //BANK_APP_MEMORYACCOUNTING_H
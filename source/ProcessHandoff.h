@@ -0,0 +1,283 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_PROCESSHANDOFF_H
+#define BANK_APP_PROCESSHANDOFF_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "Logger.h"
+
+namespace bank_app{
+    struct InheritedListener{
+        unsigned short port;
+        int fd;
+    };
+
+    // The new process's end of a handoff. The old process keeps accepting on the sockets until ready()
+    // asks it to drain, and keeps serving for good when this is dropped before.
+    class HandoffTakeover{
+        static constexpr std::string_view READY = "READY";
+
+        int fd_;
+        std::vector<InheritedListener> listeners_;
+
+    public:
+        HandoffTakeover(int fd, std::vector<InheritedListener> listeners) : fd_(fd), listeners_(std::move(listeners)){
+        }
+
+        ~HandoffTakeover(){
+#if !defined(_WIN32)
+            if(fd_ >= 0)
+                ::close(fd_);
+#endif
+        }
+
+        HandoffTakeover(const HandoffTakeover&) = delete;
+        HandoffTakeover& operator=(const HandoffTakeover&) = delete;
+
+        static constexpr std::string_view readyMessage(){
+            return READY;
+        }
+
+        const std::vector<InheritedListener>& listeners() const {
+            return listeners_;
+        }
+
+        // Let the old process stop accepting and drain, then wait up to timeout for it to exit. Nobody
+        // accepts from here until this process serves, new connections wait in the listen backlog.
+        void ready(std::chrono::seconds timeout){
+#if !defined(_WIN32)
+            if(::send(fd_, READY.data(), READY.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(READY.size()))
+                throw std::runtime_error(std::string("handoff: ") + std::strerror(errno));
+
+            pollfd waiting{fd_, POLLIN, 0};
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while(true){
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if(left.count() <= 0)
+                    break;
+
+                auto ready = ::poll(&waiting, 1, static_cast<int>(left.count()));
+                if(ready < 0 && errno == EINTR)
+                    continue;
+
+                char ignored;
+                if(ready != 0 && ::recv(fd_, &ignored, 1, 0) <= 0)
+                    break;
+            }
+            ::close(fd_);
+            fd_ = -1;
+#endif
+        }
+    };
+
+    // Hands the listening sockets of a running process to its replacement over a Unix domain socket.
+    // The old process passes the sockets with SCM_RIGHTS and keeps accepting on them while the new one
+    // starts. Once the new one is ready the old one stops accepting, drains its requests and exits;
+    // only then does the new one open the session snapshot and the transfer journal, whose locks the
+    // old process held. Sessions resume from the snapshot. Upstream TLS connections are not handed over,
+    // OpenSSL can not export a live connection.
+    class ProcessHandoff{
+    public:
+        typedef std::function<std::vector<InheritedListener>()> ListenerProvider;
+        // stop accepting, drain the requests in flight and exit the process
+        typedef std::function<void()> Drain;
+
+    private:
+        static constexpr std::string_view TAKEOVER = "TAKEOVER";
+        static constexpr std::size_t MAX_LISTENERS = 8;
+
+        std::string path_;
+        ListenerProvider listeners_;
+        Drain drain_;
+        int serverFd_ = -1;
+        std::thread worker_;
+
+#if !defined(_WIN32)
+        static sockaddr_un address(const std::string& path){
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if(path.size() >= sizeof(address.sun_path))
+                throw std::invalid_argument("handoff socket path too long: " + path);
+
+            std::memcpy(address.sun_path, path.data(), path.size());
+            return address;
+        }
+
+        static bool sendListeners(int fd, const std::vector<InheritedListener>& listeners){
+            uint16_t ports[MAX_LISTENERS];
+            int fds[MAX_LISTENERS];
+            auto count = std::min(listeners.size(), MAX_LISTENERS);
+            for(std::size_t i = 0; i < count; i++){
+                ports[i] = listeners[i].port;
+                fds[i] = listeners[i].fd;
+            }
+
+            // the ports travel as the payload, the descriptors as ancillary data in the same order
+            iovec payload{ports, count * sizeof(uint16_t)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+
+            msghdr message{};
+            message.msg_iov = &payload;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+            auto header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(count * sizeof(int));
+            std::memcpy(CMSG_DATA(header), fds, count * sizeof(int));
+
+            return ::sendmsg(fd, &message, MSG_NOSIGNAL) >= 0;
+        }
+
+        static std::vector<InheritedListener> receiveListeners(int fd){
+            uint16_t ports[MAX_LISTENERS];
+            alignas(cmsghdr) char control[CMSG_SPACE(MAX_LISTENERS * sizeof(int))]{};
+            iovec payload{ports, sizeof(ports)};
+
+            msghdr message{};
+            message.msg_iov = &payload;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            auto received = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+            if(received < 0)
+                throw std::runtime_error(std::string("handoff: ") + std::strerror(errno));
+
+            std::vector<InheritedListener> listeners;
+            auto header = CMSG_FIRSTHDR(&message);
+            if(!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+                return listeners;
+
+            auto count = std::min<std::size_t>((header->cmsg_len - CMSG_LEN(0)) / sizeof(int), received / sizeof(uint16_t));
+            for(std::size_t i = 0; i < count; i++){
+                int inherited;
+                std::memcpy(&inherited, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                listeners.push_back({ports[i], inherited});
+            }
+            return listeners;
+        }
+
+        void serve(){
+            while(true){
+                auto client = ::accept(serverFd_, nullptr, nullptr);
+                if(client < 0){
+                    if(errno == EINTR)
+                        continue;
+                    return;
+                }
+
+                char request[TAKEOVER.size()];
+                if(::recv(client, request, sizeof(request), MSG_WAITALL) != static_cast<ssize_t>(sizeof(request)) ||
+                   std::string_view(request, sizeof(request)) != TAKEOVER ||
+                   !sendListeners(client, listeners_())){
+                    ::close(client);
+                    continue;
+                }
+
+                // the sockets stay ours to accept on until the new process is ready, without it we keep serving
+                constexpr auto ready = HandoffTakeover::readyMessage();
+                char answer[ready.size()];
+                if(::recv(client, answer, sizeof(answer), MSG_WAITALL) != static_cast<ssize_t>(sizeof(answer)) ||
+                   std::string_view(answer, sizeof(answer)) != ready){
+                    Logger::warn("handoff", "the new process went away before it was ready, serving on");
+                    ::close(client);
+                    continue;
+                }
+
+                // client stays open until the process is gone, its EOF tells the new process the locks are free
+                Logger::info("handoff", "handing off to the new process");
+                drain_();
+                return;
+            }
+        }
+#endif
+
+    public:
+        // Take over from the process serving the handoff socket at path, nullptr when no process serves it.
+        // It keeps accepting on the sockets received until HandoffTakeover::ready().
+        static std::unique_ptr<HandoffTakeover> takeOver(const std::string& path){
+#if defined(_WIN32)
+            return nullptr;
+#else
+            auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            auto target = address(path);
+            if(fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&target), sizeof(target)) < 0){
+                if(fd >= 0)
+                    ::close(fd);
+                return nullptr;
+            }
+
+            if(::send(fd, TAKEOVER.data(), TAKEOVER.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(TAKEOVER.size())){
+                ::close(fd);
+                return nullptr;
+            }
+
+            try{
+                return std::make_unique<HandoffTakeover>(fd, receiveListeners(fd));
+            }
+            catch(std::exception& err){
+                ::close(fd);
+                throw;
+            }
+#endif
+        }
+
+        // Serve the handoff socket for the next process
+        ProcessHandoff(std::string path, ListenerProvider listeners, Drain drain)
+                : path_(std::move(path)), listeners_(std::move(listeners)), drain_(std::move(drain)){
+#if !defined(_WIN32)
+            auto local = address(path_);
+            ::unlink(path_.c_str());
+
+            serverFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(serverFd_ < 0 || ::bind(serverFd_, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0 ||
+               ::listen(serverFd_, 1) < 0){
+                auto reason = std::string(std::strerror(errno));
+                if(serverFd_ >= 0)
+                    ::close(serverFd_);
+                throw std::runtime_error("handoff socket " + path_ + ": " + reason);
+            }
+
+            worker_ = std::thread([this]{ serve(); });
+#endif
+        }
+
+        ~ProcessHandoff(){
+#if !defined(_WIN32)
+            ::shutdown(serverFd_, SHUT_RDWR);
+            ::close(serverFd_);
+            if(worker_.joinable())
+                worker_.join();
+#endif
+        }
+
+        ProcessHandoff(const ProcessHandoff&) = delete;
+        ProcessHandoff& operator=(const ProcessHandoff&) = delete;
+    };
+}
+
+#endif //BANK_APP_PROCESSHANDOFF_H
@@ -0,0 +1,83 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_REQUESTCONTEXT_H
+#define BANK_APP_REQUESTCONTEXT_H
+
+#include <memory_resource>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+namespace bank_app{
+    // Counts what the per request arenas had to take from the heap once their inline buffer was full
+    class ArenaUpstream : public std::pmr::memory_resource{
+        std::atomic<uint64_t> allocations_ = 0;
+        std::atomic<uint64_t> bytes_ = 0;
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+    public:
+        static ArenaUpstream& instance(){
+            static ArenaUpstream upstream;
+            return upstream;
+        }
+
+        uint64_t allocations() const {
+            return allocations_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t bytes() const {
+            return bytes_.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Per request state handed to the event handlers. Everything allocated from the arena is
+    // released at once when the session starts reading its next request.
+    struct RequestContext{
+        std::pmr::memory_resource* arena;
+        // the response is worthless after this, upstream calls give up at it
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // Deadline of the request handled on this thread, the upstream clients read it for every step
+    // so it reaches them without being passed through each bank operation
+    class RequestDeadline{
+        static inline thread_local std::optional<std::chrono::steady_clock::time_point> current_;
+        std::optional<std::chrono::steady_clock::time_point> previous_;
+
+    public:
+        explicit RequestDeadline(std::chrono::steady_clock::time_point deadline) : previous_(current_){
+            current_ = deadline;
+        }
+
+        ~RequestDeadline(){
+            current_ = previous_;
+        }
+
+        RequestDeadline(const RequestDeadline&) = delete;
+        RequestDeadline& operator=(const RequestDeadline&) = delete;
+
+        // nullopt outside of a request, e.g. on the background threads
+        static std::optional<std::chrono::steady_clock::time_point> current(){
+            return current_;
+        }
+    };
+}
+
+#endif //BANK_APP_REQUESTCONTEXT_H
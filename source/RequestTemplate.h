@@ -0,0 +1,140 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_REQUESTTEMPLATE_H
+#define BANK_APP_REQUESTTEMPLATE_H
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <string>
+#include <string_view>
+#include <array>
+#include <charconv>
+
+namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace http = boost::beast::http;    // from <boost/beast/http.hpp>
+
+namespace bank_app{
+    // The request line and the headers every upstream request carries, serialized once per endpoint
+    class RequestTemplate{
+        std::string head_;
+        bool expectsBody_;
+
+    public:
+        RequestTemplate(http::verb method, std::string_view target, std::string_view host, std::string_view userAgent)
+                : expectsBody_(method == http::verb::post || method == http::verb::put || method == http::verb::patch){
+            auto verb = http::to_string(method);
+            head_.append(verb.data(), verb.size()).append(" ").append(target).append(" HTTP/1.1\r\n")
+                 .append("Host: ").append(host).append("\r\n")
+                 .append("Cache-Control: max-age=0\r\n")
+                 .append("Upgrade-Insecure-Requests: 1\r\n")
+                 .append("User-Agent: ").append(userAgent).append("\r\n")
+                 .append("Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n")
+                 .append("Accept-Encoding: gzip, deflate, sdch, br\r\n")
+                 .append("Accept-Language: en-US,en;q=0.8,id;q=0.6,fr;q=0.4\r\n")
+                 .append("Content-Type: application/x-www-form-urlencoded\r\n");
+        }
+
+        std::string_view text() const {
+            return head_;
+        }
+
+        // requests of this method always state their length, an empty body as Content-Length: 0
+        bool expectsBody() const {
+            return expectsBody_;
+        }
+    };
+
+    // A request to the upstream: the template of its endpoint plus the parts which differ per request.
+    // Written as a gather of the template, the dynamic headers and the body, nothing is serialized again.
+    class UpstreamRequest{
+        static constexpr std::string_view COOKIE = "Cookie: ";
+        static constexpr std::string_view REFERER = "Referer: ";
+        static constexpr std::string_view CONTENT_LENGTH = "Content-Length: ";
+        static constexpr std::string_view CRLF = "\r\n";
+
+        const RequestTemplate* head_ = nullptr;
+        std::string cookie_;
+        // a path of getBCAPath, or another string outliving the request
+        std::string_view referer_;
+        std::string body_;
+        bool hasBody_ = false;
+        std::array<char, 20> length_{};
+        std::size_t lengthSize_ = 0;
+
+        static net::const_buffer buffer(std::string_view text, bool present = true){
+            return present ? net::const_buffer(text.data(), text.size()) : net::const_buffer();
+        }
+
+        bool statesLength() const {
+            return hasBody_ || head_->expectsBody();
+        }
+
+        std::string_view length() const {
+            return hasBody_ ? std::string_view(length_.data(), lengthSize_) : std::string_view("0");
+        }
+
+    public:
+        UpstreamRequest() = default;
+
+        explicit UpstreamRequest(const RequestTemplate& head) : head_(&head){
+        }
+
+        // start over on another endpoint
+        void reset(const RequestTemplate& head){
+            head_ = &head;
+            cookie_.clear();
+            referer_ = {};
+            body_.clear();
+            hasBody_ = false;
+        }
+
+        UpstreamRequest& cookie(std::string cookie){
+            cookie_ = std::move(cookie);
+            return *this;
+        }
+
+        UpstreamRequest& referer(std::string_view referer){
+            referer_ = referer;
+            return *this;
+        }
+
+        UpstreamRequest& body(std::string body){
+            body_ = std::move(body);
+            hasBody_ = true;
+            lengthSize_ = std::to_chars(length_.data(), length_.data() + length_.size(), body_.size()).ptr - length_.data();
+            return *this;
+        }
+
+        bool empty() const {
+            return head_ == nullptr;
+        }
+
+        std::size_t capacity() const {
+            return cookie_.capacity() + body_.capacity();
+        }
+
+        // Views into the template and this request, valid while neither changes
+        std::array<net::const_buffer, 12> buffers() const {
+            return {
+                buffer(head_->text()),
+                buffer(COOKIE, !cookie_.empty()), buffer(cookie_), buffer(CRLF, !cookie_.empty()),
+                buffer(REFERER, !referer_.empty()), buffer(referer_), buffer(CRLF, !referer_.empty()),
+                buffer(CONTENT_LENGTH, statesLength()), buffer(length(), statesLength()), buffer(CRLF, statesLength()),
+                buffer(CRLF),
+                buffer(body_)
+            };
+        }
+
+        // the same bytes in one piece, for streams which write one buffer at a time
+        void serializeTo(std::string& out) const {
+            out.clear();
+            for(auto& part : buffers()){
+                out.append(static_cast<const char*>(part.data()), part.size());
+            }
+        }
+    };
+}
+
+#endif //BANK_APP_REQUESTTEMPLATE_H
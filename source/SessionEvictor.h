@@ -0,0 +1,119 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_SESSIONEVICTOR_H
+#define BANK_APP_SESSIONEVICTOR_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+#include "BcaBank.h"
+#include "SessionMailbox.h"
+#include "Logger.h"
+
+namespace bank_app{
+    struct SessionEvictorConfig{
+        // logouts sent upstream per interval
+        std::size_t batchSize = 10;
+        std::chrono::milliseconds interval{1000};
+    };
+
+    // Logs evicted sessions out of BCA from a background thread, a batch per interval, so a mass
+    // eviction does not turn into a burst of upstream requests.
+    class SessionEvictor{
+        struct Pending{
+            std::shared_ptr<BcaBank> bank;
+            std::shared_ptr<SessionMailbox> mailbox;
+        };
+
+        SessionEvictorConfig config_;
+        std::function<void()> sweep_;
+        std::deque<Pending> pending_;
+        std::atomic<uint64_t> loggedOut_ = 0;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::thread worker_;
+
+        void run(){
+            std::unique_lock lock(mutex_);
+
+            while(!stopping_){
+                if(wakeup_.wait_for(lock, config_.interval, [this]{ return stopping_; }))
+                    break;
+
+                std::deque<Pending> batch;
+                while(!pending_.empty() && batch.size() < config_.batchSize){
+                    batch.push_back(std::move(pending_.front()));
+                    pending_.pop_front();
+                }
+
+                auto sweep = sweep_;
+                lock.unlock();
+
+                if(sweep)
+                    sweep();
+
+                for(auto& session : batch){
+                    // queued behind the operations still pending on the session
+                    try{
+                        session.mailbox->call([&]{
+                            return session.bank->logout();
+                        });
+                    }
+                    catch(std::exception& err){
+                        Logger::warn("evicted_logout", err.what());
+                    }
+                    loggedOut_++;
+                }
+                batch.clear();
+
+                lock.lock();
+            }
+        }
+
+    public:
+        SessionEvictor(SessionEvictorConfig config = {}) : config_(config){
+            worker_ = std::thread([this]{ run(); });
+        }
+
+        ~SessionEvictor(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            worker_.join();
+        }
+
+        // called once per interval from the background thread, used to expire idle sessions
+        void setSweep(std::function<void()> sweep){
+            std::lock_guard lock(mutex_);
+            sweep_ = std::move(sweep);
+        }
+
+        void enqueue(std::shared_ptr<BcaBank> bank, std::shared_ptr<SessionMailbox> mailbox){
+            std::lock_guard lock(mutex_);
+            pending_.push_back({std::move(bank), std::move(mailbox)});
+        }
+
+        std::size_t pending(){
+            std::lock_guard lock(mutex_);
+            return pending_.size();
+        }
+
+        uint64_t loggedOut() const {
+            return loggedOut_;
+        }
+    };
+}
+
+#endif //BANK_APP_SESSIONEVICTOR_H
@@ -0,0 +1,329 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_SESSIONMAILBOX_H
+#define BANK_APP_SESSIONMAILBOX_H
+
+#include <boost/beast/core/error.hpp>
+#include <boost/system/error_code.hpp>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include "RequestContext.h"
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+
+namespace bank_app{
+    struct SessionExecutorConfig{
+        std::size_t workers = 8;
+        // operations waiting on one session, more are turned away as busy
+        std::size_t maxQueue = 32;
+        // operations of one session run back to back before the worker moves on to the next session
+        std::size_t batchSize = 8;
+        // wait of an operation started outside of a request, e.g. by the refresher or the evictor
+        std::chrono::milliseconds maxWait{30000};
+    };
+
+    struct SessionExecutorGauges{
+        uint64_t queued = 0;
+        uint64_t busyWorkers = 0;
+        uint64_t completed = 0;
+        uint64_t rejected = 0;
+        uint64_t expired = 0;
+        uint64_t waitMicros = 0;
+        uint64_t maxWaitMicros = 0;
+    };
+
+    class SessionMailbox;
+
+    // Workers running the mailboxes which have operations queued, one mailbox per worker at a time
+    class SessionExecutor{
+        friend class SessionMailbox;
+
+        SessionExecutorConfig config_;
+        std::deque<std::shared_ptr<SessionMailbox>> ready_;
+        bool stopping_ = false;
+        // workers asked to leave by resize(), the first ones to go idle do
+        std::size_t retiring_ = 0;
+        std::size_t running_ = 0;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::vector<std::thread> workers_;
+        std::vector<std::thread::id> retired_;
+
+        std::atomic<uint64_t> queued_ = 0;
+        std::atomic<uint64_t> busy_ = 0;
+        std::atomic<uint64_t> completed_ = 0;
+        std::atomic<uint64_t> rejected_ = 0;
+        std::atomic<uint64_t> expired_ = 0;
+        std::atomic<uint64_t> waitMicros_ = 0;
+        std::atomic<uint64_t> maxWaitMicros_ = 0;
+
+        void schedule(std::shared_ptr<SessionMailbox> mailbox){
+            {
+                std::lock_guard lock(mutex_);
+                ready_.push_back(std::move(mailbox));
+            }
+            wakeup_.notify_one();
+        }
+
+        void recordWait(std::chrono::steady_clock::duration waited){
+            auto micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+            waitMicros_ += micros;
+
+            auto longest = maxWaitMicros_.load();
+            while(micros > longest && !maxWaitMicros_.compare_exchange_weak(longest, micros)){
+            }
+        }
+
+        void run();
+
+    public:
+        SessionExecutor(SessionExecutorConfig config = {}) : config_(config){
+            resize(config_.workers);
+        }
+
+        // the queued operations still run, their callers wait for them
+        ~SessionExecutor(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            for(auto& worker : workers_){
+                worker.join();
+            }
+        }
+
+        SessionExecutor(const SessionExecutor&) = delete;
+        SessionExecutor& operator=(const SessionExecutor&) = delete;
+
+        // Grow or shrink the pool, a worker running a batch finishes it before it leaves
+        void resize(std::size_t workers){
+            workers = std::max<std::size_t>(workers, 1);
+            std::vector<std::thread> finished;
+            {
+                std::lock_guard lock(mutex_);
+                std::erase_if(workers_, [&](auto& worker){
+                    if(std::find(retired_.begin(), retired_.end(), worker.get_id()) == retired_.end())
+                        return false;
+
+                    finished.push_back(std::move(worker));
+                    return true;
+                });
+                retired_.clear();
+
+                // cancel pending retirements first, then start what is still missing
+                while(running_ < workers && retiring_ > 0){
+                    retiring_--;
+                    running_++;
+                }
+                for(; running_ < workers; running_++){
+                    workers_.emplace_back([this]{ run(); });
+                }
+                if(running_ > workers){
+                    retiring_ += running_ - workers;
+                    running_ = workers;
+                }
+            }
+            wakeup_.notify_all();
+
+            for(auto& worker : finished){
+                worker.join();
+            }
+        }
+
+        std::size_t size(){
+            std::lock_guard lock(mutex_);
+            return running_;
+        }
+
+        const SessionExecutorConfig& config() const {
+            return config_;
+        }
+
+        SessionExecutorGauges gauges() const {
+            return {queued_, busy_, completed_, rejected_, expired_, waitMicros_, maxWaitMicros_};
+        }
+    };
+
+    // Runs the operations on one session in the order they arrived, one at a time on the executor.
+    // A BcaBank owns a single upstream stream, every operation on it has to go through its mailbox.
+    class SessionMailbox : public std::enable_shared_from_this<SessionMailbox>{
+        friend class SessionExecutor;
+
+        enum State{
+            QUEUED,
+            RUNNING,
+            CANCELLED
+        };
+
+        struct Task{
+            std::function<void()> run;
+            std::chrono::steady_clock::time_point enqueued;
+            std::shared_ptr<std::atomic<int>> state;
+        };
+
+        SessionExecutor& executor_;
+        std::deque<Task> tasks_;
+        bool scheduled_ = false;
+        bool running_ = false;
+        std::mutex mutex_;
+
+        // Run up to batch operations, true when more are left
+        bool drain(std::size_t batch){
+            for(std::size_t i = 0; i < batch; i++){
+                Task task;
+                {
+                    std::lock_guard lock(mutex_);
+                    if(tasks_.empty()){
+                        scheduled_ = false;
+                        return false;
+                    }
+
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                    running_ = true;
+                }
+                executor_.queued_--;
+
+                // the caller gave up waiting and no longer holds what the operation refers to
+                int expected = QUEUED;
+                if(task.state->compare_exchange_strong(expected, RUNNING)){
+                    executor_.recordWait(std::chrono::steady_clock::now() - task.enqueued);
+                    task.run();
+                    executor_.completed_++;
+                }
+
+                std::lock_guard lock(mutex_);
+                running_ = false;
+            }
+
+            std::lock_guard lock(mutex_);
+            if(tasks_.empty()){
+                scheduled_ = false;
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        explicit SessionMailbox(SessionExecutor& executor) : executor_(executor){
+        }
+
+        SessionMailbox(const SessionMailbox&) = delete;
+        SessionMailbox& operator=(const SessionMailbox&) = delete;
+
+        // Queue an operation and wait for its result. The wait ends at the deadline of the request on
+        // this thread, which the operation also runs under; an operation not started by then is dropped
+        // and beast::error::timeout thrown. A full mailbox throws errc::device_or_resource_busy.
+        template<class Operation>
+        auto call(Operation&& operation) -> std::invoke_result_t<Operation&>{
+            typedef std::invoke_result_t<Operation&> Result;
+
+            auto now = std::chrono::steady_clock::now();
+            auto deadline = RequestDeadline::current().value_or(now + executor_.config_.maxWait);
+            auto state = std::make_shared<std::atomic<int>>(QUEUED);
+            auto promise = std::make_shared<std::promise<Result>>();
+            auto future = promise->get_future();
+
+            // the operation stays on this stack, the caller only leaves before the task ran when it cancelled it
+            Task task{[&operation, promise, deadline]{
+                RequestDeadline deadlineScope(deadline);
+                try{
+                    if constexpr(std::is_void_v<Result>){
+                        operation();
+                        promise->set_value();
+                    }
+                    else{
+                        promise->set_value(operation());
+                    }
+                }
+                catch(...){
+                    promise->set_exception(std::current_exception());
+                }
+            }, now, state};
+
+            bool schedule;
+            {
+                std::lock_guard lock(mutex_);
+                if(tasks_.size() >= executor_.config_.maxQueue){
+                    executor_.rejected_++;
+                    throw beast::system_error{boost::system::errc::make_error_code(boost::system::errc::device_or_resource_busy)};
+                }
+
+                tasks_.push_back(std::move(task));
+                schedule = !scheduled_;
+                scheduled_ = true;
+            }
+            executor_.queued_++;
+
+            if(schedule)
+                executor_.schedule(shared_from_this());
+
+            if(future.wait_until(deadline) == std::future_status::timeout){
+                int expected = QUEUED;
+                if(state->compare_exchange_strong(expected, CANCELLED)){
+                    executor_.expired_++;
+                    throw beast::system_error{beast::error::timeout};
+                }
+                // already running, its upstream steps give up at the same deadline
+            }
+
+            return future.get();
+        }
+
+        // nothing queued or running, background work leaves busy sessions to the requests
+        bool idle(){
+            std::lock_guard lock(mutex_);
+            return tasks_.empty() && !running_;
+        }
+
+        std::size_t depth(){
+            std::lock_guard lock(mutex_);
+            return tasks_.size();
+        }
+    };
+
+    inline void SessionExecutor::run(){
+        std::unique_lock lock(mutex_);
+
+        while(true){
+            wakeup_.wait(lock, [this]{ return stopping_ || retiring_ > 0 || !ready_.empty(); });
+            if(retiring_ > 0){
+                retiring_--;
+                retired_.push_back(std::this_thread::get_id());
+                return;
+            }
+            if(ready_.empty())
+                return;
+
+            auto mailbox = std::move(ready_.front());
+            ready_.pop_front();
+            lock.unlock();
+
+            busy_++;
+            auto more = mailbox->drain(config_.batchSize);
+            busy_--;
+
+            lock.lock();
+            // to the back of the line, the other sessions get their turn first
+            if(more){
+                ready_.push_back(std::move(mailbox));
+                wakeup_.notify_one();
+            }
+        }
+    }
+}
+
+#endif //BANK_APP_SESSIONMAILBOX_H
@@ -0,0 +1,172 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_SESSIONREFRESHER_H
+#define BANK_APP_SESSIONREFRESHER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <optional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+
+namespace bank_app{
+    struct SessionRefresherConfig{
+        // how long before expiry a session is refreshed
+        std::chrono::seconds lead{45};
+        // refreshes are spread randomly over this window before the lead time
+        std::chrono::seconds jitter{30};
+        // refreshes started per second, with a burst of the same size
+        double ratePerSecond = 5;
+        std::chrono::milliseconds tick{250};
+        std::size_t wheelSize = 4096;
+    };
+
+    // Hashed timing wheel over the live sessions which logs them in again in the background
+    // shortly before their login expires, so the request path only logs in when a session is dead.
+    class SessionRefresher{
+    public:
+        typedef std::chrono::system_clock::time_point Expiry;
+        // refresh the session, returning its new expiry or nullopt when it is gone
+        typedef std::function<std::optional<Expiry>(const std::string& token)> RefreshHandler;
+
+    private:
+        struct Timer{
+            std::string token;
+            std::size_t rounds;
+            uint64_t generation;
+        };
+
+        SessionRefresherConfig config_;
+        RefreshHandler refresh_;
+        std::vector<std::vector<Timer>> wheel_;
+        std::unordered_map<std::string, uint64_t> generations_;
+        std::size_t cursor_ = 0;
+        uint64_t nextGeneration_ = 0;
+        double tokens_;
+        std::chrono::steady_clock::time_point lastRefill_;
+        std::mt19937 random_;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::thread worker_;
+
+        void insertLocked(const std::string& token, std::chrono::milliseconds delay){
+            auto ticks = static_cast<std::size_t>(std::max<int64_t>(1, delay / config_.tick));
+            auto generation = ++nextGeneration_;
+
+            generations_[token] = generation;
+            wheel_[(cursor_ + ticks) % wheel_.size()].push_back({token, (ticks - 1) / wheel_.size(), generation});
+        }
+
+        bool acquireLocked(){
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed = now - lastRefill_;
+
+            tokens_ = std::min(config_.ratePerSecond, tokens_ + elapsed.count() * config_.ratePerSecond);
+            lastRefill_ = now;
+
+            if(tokens_ < 1)
+                return false;
+
+            tokens_ -= 1;
+            return true;
+        }
+
+        void run(){
+            std::unique_lock lock(mutex_);
+            auto nextTick = std::chrono::steady_clock::now() + config_.tick;
+
+            while(!stopping_){
+                if(wakeup_.wait_until(lock, nextTick, [this]{ return stopping_; }))
+                    break;
+
+                nextTick += config_.tick;
+                cursor_ = (cursor_ + 1) % wheel_.size();
+
+                std::vector<Timer> due;
+                auto& slot = wheel_[cursor_];
+                for(auto it = slot.begin(); it != slot.end();){
+                    if(it->rounds > 0){
+                        it->rounds--;
+                        ++it;
+                        continue;
+                    }
+
+                    auto current = generations_.find(it->token);
+                    if(current != generations_.end() && current->second == it->generation)
+                        due.push_back(std::move(*it));
+
+                    it = slot.erase(it);
+                }
+
+                for(auto& timer : due){
+                    // over the rate limit, try again on the next tick
+                    if(!acquireLocked()){
+                        insertLocked(timer.token, config_.tick);
+                        continue;
+                    }
+
+                    generations_.erase(timer.token);
+
+                    lock.unlock();
+                    auto expiry = refresh_(timer.token);
+                    lock.lock();
+
+                    if(expiry && !generations_.contains(timer.token))
+                        insertLocked(timer.token, delayFor(*expiry));
+                }
+            }
+        }
+
+        std::chrono::milliseconds delayFor(Expiry expiry){
+            std::uniform_int_distribution<int64_t> jitter(0, std::chrono::milliseconds(config_.jitter).count());
+            auto fireAt = expiry - config_.lead - std::chrono::milliseconds(jitter(random_));
+
+            return std::chrono::duration_cast<std::chrono::milliseconds>(fireAt - std::chrono::system_clock::now());
+        }
+
+    public:
+        SessionRefresher(RefreshHandler refresh, SessionRefresherConfig config = {})
+                : config_(config), refresh_(std::move(refresh)), wheel_(config.wheelSize),
+                  tokens_(config.ratePerSecond), lastRefill_(std::chrono::steady_clock::now()),
+                  random_(std::random_device{}()){
+            worker_ = std::thread([this]{ run(); });
+        }
+
+        ~SessionRefresher(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            worker_.join();
+        }
+
+        // (Re)arm the refresh of a session whose login expires at the given time
+        void schedule(const std::string& token, Expiry expiry){
+            std::lock_guard lock(mutex_);
+            insertLocked(token, delayFor(expiry));
+        }
+
+        void cancel(const std::string& token){
+            std::lock_guard lock(mutex_);
+            generations_.erase(token);
+        }
+
+        std::size_t scheduled(){
+            std::lock_guard lock(mutex_);
+            return generations_.size();
+        }
+    };
+}
+
+#endif //BANK_APP_SESSIONREFRESHER_H
@@ -0,0 +1,486 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_SESSIONREGISTRY_H
+#define BANK_APP_SESSIONREGISTRY_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <type_traits>
+#include <functional>
+#include <chrono>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include "BcaBank.h"
+#include "SessionSnapshot.h"
+#include "SessionMailbox.h"
+#include "Logger.h"
+#include "TokenService.h"
+
+namespace bank_app{
+    struct SessionLimits{
+        std::size_t maxSessions = 10000;
+        std::size_t memoryBudget = 512 * 1024 * 1024;
+        std::chrono::seconds idleTtl{30 * 60};
+    };
+
+    struct SessionGauges{
+        std::size_t resident = 0;
+        std::size_t pendingRestore = 0;
+        std::size_t bytes = 0;
+        uint64_t evicted = 0;
+    };
+
+    struct SessionUsage{
+        // enough of the token to tell sessions apart, never the whole of it
+        std::string tokenPrefix;
+        std::size_t bytes = 0;
+        bool resident = false;
+    };
+
+    // Live BCA sessions by token, checkpointed to a SessionSnapshot when one is attached.
+    // Sessions restored from the snapshot stay as plain state until they are first used.
+    // The sessions are split over shards by the shard the token carries, each with its own lock and
+    // recency order. Limits hold for the whole registry, the shard which grew past them evicts.
+    // With a TokenService attached tokens it did not mint are turned away before any shard is locked.
+    class SessionRegistry{
+    public:
+        // called with the new login expiry whenever a session logged in
+        typedef std::function<void(const std::string& token, std::chrono::system_clock::time_point expiry)> LoginObserver;
+        // receives the sessions dropped by the eviction policy so they can be logged out
+        typedef std::function<void(std::shared_ptr<BcaBank> bank, std::shared_ptr<SessionMailbox> mailbox)> EvictionHandler;
+
+    private:
+        struct Entry{
+            std::shared_ptr<BcaBank> bank;
+            // serializes the operations on one session, a BcaBank owns a single upstream stream
+            std::shared_ptr<SessionMailbox> mailbox;
+            std::optional<BcaSessionState> restored;
+            uint64_t checkpointedVersion = 0;
+            std::chrono::system_clock::time_point observedExpiry;
+            std::list<std::string>::iterator lruPosition;
+            std::chrono::steady_clock::time_point lastAccess;
+            std::size_t bytes = 0;
+        };
+
+        typedef std::unordered_map<std::string, Entry> Sessions;
+
+        static constexpr std::size_t SHARDS = 16;
+
+        struct alignas(64) Shard{
+            Sessions sessions;
+            // least recently used session at the back
+            std::list<std::string> lru;
+            std::mutex mutex;
+        };
+
+        net::io_context& ioc_;
+        SessionExecutor& executor_;
+        SessionSnapshot* snapshot_;
+        const TokenService* tokens_;
+        LoginObserver loginObserver_;
+        EvictionHandler evictionHandler_;
+        SessionLimits limits_;
+        std::array<Shard, SHARDS> shards_;
+        std::atomic<std::size_t> count_ = 0;
+        std::atomic<std::size_t> totalBytes_ = 0;
+        std::atomic<uint64_t> evicted_ = 0;
+        std::mutex limitsMutex_;
+
+        Shard& shardOf(const std::string& token){
+            return shards_[TokenService::shard(token, SHARDS)];
+        }
+
+        bool accepted(const std::string& token) const {
+            return !tokens_ || tokens_->verify(token);
+        }
+
+        SessionLimits limits(){
+            std::lock_guard lock(limitsMutex_);
+            return limits_;
+        }
+
+        static std::size_t estimateBytes(const BcaSessionState& state){
+            auto bytes = sizeof(Entry) + state.username.size() + state.password.size() + state.currentIp.size();
+            for(auto& cookie : state.cookies){
+                bytes += cookie.size();
+            }
+            return bytes;
+        }
+
+        Entry& addLocked(Shard& shard, const std::string& token){
+            auto [found, inserted] = shard.sessions.try_emplace(token);
+            auto& entry = found->second;
+
+            if(inserted){
+                shard.lru.push_front(token);
+                entry.lruPosition = shard.lru.begin();
+                entry.mailbox = std::make_shared<SessionMailbox>(executor_);
+                count_++;
+            }
+
+            entry.lastAccess = std::chrono::steady_clock::now();
+            return entry;
+        }
+
+        void accountLocked(Entry& entry, std::size_t bytes){
+            totalBytes_ = totalBytes_ - entry.bytes + bytes;
+            entry.bytes = bytes;
+        }
+
+        void eraseLocked(Shard& shard, Sessions::iterator found){
+            totalBytes_ -= found->second.bytes;
+            count_--;
+            shard.lru.erase(found->second.lruPosition);
+            if(snapshot_)
+                snapshot_->remove(found->first);
+
+            shard.sessions.erase(found);
+        }
+
+        void evictLocked(Shard& shard, Sessions::iterator found){
+            auto& entry = found->second;
+            if(entry.bank && evictionHandler_)
+                evictionHandler_(entry.bank, entry.mailbox);
+
+            evicted_++;
+            eraseLocked(shard, found);
+        }
+
+        // Drop least recently used sessions of the shard until the count and memory limits hold. The most
+        // recent one stays, what other shards hold over the limits they give back on their own next turn.
+        void enforceLocked(Shard& shard, const SessionLimits& limits){
+            while(shard.lru.size() > 1 && (count_ > limits.maxSessions || totalBytes_ > limits.memoryBudget)){
+                evictLocked(shard, shard.sessions.find(shard.lru.back()));
+            }
+        }
+
+        // What a checkpoint needs of a session. Taken inside its mailbox once the session is shared,
+        // so the state it reads is not changed by an operation running meanwhile.
+        struct Capture{
+            std::chrono::system_clock::time_point expiry;
+            uint64_t version = 0;
+            std::size_t bytes = 0;
+            // only when the version differs from the one last checkpointed
+            std::optional<BcaSessionState> state;
+        };
+
+        Capture capture(BcaBank& bank, uint64_t checkpointedVersion){
+            Capture result{bank.loginExpiry(), bank.stateVersion(), bank.residentBytes()};
+            if(snapshot_ && result.version != checkpointedVersion)
+                result.state = bank.exportState();
+            return result;
+        }
+
+        // Expiry and version only grow, captures which arrive out of order never move them back
+        void checkpointLocked(const std::string& token, Entry& entry, const Capture& capture){
+            if(capture.expiry > entry.observedExpiry){
+                entry.observedExpiry = capture.expiry;
+                if(loginObserver_)
+                    loginObserver_(token, capture.expiry);
+            }
+
+            if(!capture.state || capture.version <= entry.checkpointedVersion)
+                return;
+
+            snapshot_->store(token, *capture.state);
+            entry.checkpointedVersion = capture.version;
+        }
+
+        struct Materialized{
+            std::shared_ptr<BcaBank> bank;
+            std::shared_ptr<SessionMailbox> mailbox;
+            uint64_t checkpointedVersion = 0;
+        };
+
+        Materialized materialize(const std::string& token){
+            if(!accepted(token))
+                return {};
+
+            auto& shard = shardOf(token);
+            std::lock_guard lock(shard.mutex);
+
+            auto found = shard.sessions.find(token);
+            if(found == shard.sessions.end())
+                return {};
+
+            auto& entry = found->second;
+            if(entry.restored){
+                entry.bank = std::make_shared<BcaBank>(ioc_, *entry.restored);
+                entry.restored.reset();
+                entry.checkpointedVersion = entry.bank->stateVersion();
+
+                // without the password an expired session can not be logged in again
+                if(entry.bank->isLoginTimeout() && !entry.bank->canRelogin()){
+                    eraseLocked(shard, found);
+                    return {};
+                }
+
+                // not shared with any caller yet, nothing else runs on it
+                checkpointLocked(token, entry, capture(*entry.bank, entry.checkpointedVersion));
+            }
+
+            entry.lastAccess = std::chrono::steady_clock::now();
+            shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPosition);
+
+            return {entry.bank, entry.mailbox, entry.checkpointedVersion};
+        }
+
+        void afterOperation(const std::string& token, const Capture& capture){
+            auto currentLimits = limits();
+            auto& shard = shardOf(token);
+            std::lock_guard lock(shard.mutex);
+            auto found = shard.sessions.find(token);
+            if(found == shard.sessions.end())
+                return;
+
+            checkpointLocked(token, found->second, capture);
+            accountLocked(found->second, capture.bytes);
+            enforceLocked(shard, currentLimits);
+        }
+
+        // evict from every shard until the limits hold, e.g. after they were lowered
+        void enforce(){
+            auto currentLimits = limits();
+            for(auto& shard : shards_){
+                std::lock_guard lock(shard.mutex);
+                enforceLocked(shard, currentLimits);
+            }
+        }
+
+    public:
+        SessionRegistry(net::io_context& ioc, SessionExecutor& executor, SessionSnapshot* snapshot = nullptr,
+                        const TokenService* tokens = nullptr)
+                : ioc_(ioc), executor_(executor), snapshot_(snapshot), tokens_(tokens){
+        }
+
+        void setLoginObserver(LoginObserver observer){
+            loginObserver_ = std::move(observer);
+        }
+
+        void setEvictionHandler(EvictionHandler handler){
+            evictionHandler_ = std::move(handler);
+        }
+
+        void setLimits(SessionLimits limits){
+            {
+                std::lock_guard lock(limitsMutex_);
+                limits_ = limits;
+            }
+            enforce();
+        }
+
+        // Register the sessions found in the snapshot without reconnecting them
+        std::size_t restore(){
+            if(!snapshot_)
+                return 0;
+
+            auto states = snapshot_->load();
+            std::size_t restored = 0;
+
+            for(auto& [token, state] : states){
+                // minted under another key, expired meanwhile or of an older format, nobody can use it anymore
+                if(!accepted(token)){
+                    snapshot_->remove(token);
+                    continue;
+                }
+
+                auto& shard = shardOf(token);
+                std::lock_guard lock(shard.mutex);
+                auto& entry = addLocked(shard, token);
+                accountLocked(entry, estimateBytes(state));
+                entry.restored = std::move(state);
+                restored++;
+            }
+            enforce();
+
+            return restored;
+        }
+
+        void insert(const std::string& token, std::shared_ptr<BcaBank> bank){
+            auto currentLimits = limits();
+            auto& shard = shardOf(token);
+            std::lock_guard lock(shard.mutex);
+
+            auto& entry = addLocked(shard, token);
+            auto initial = capture(*bank, 0);
+            accountLocked(entry, initial.bytes);
+            entry.bank = std::move(bank);
+            entry.restored.reset();
+            entry.checkpointedVersion = 0;
+            entry.observedExpiry = {};
+
+            checkpointLocked(token, entry, initial);
+            enforceLocked(shard, currentLimits);
+        }
+
+        // evict the sessions nobody used for longer than the idle ttl
+        void sweepIdle(){
+            auto deadline = std::chrono::steady_clock::now() - limits().idleTtl;
+
+            for(auto& shard : shards_){
+                std::lock_guard lock(shard.mutex);
+                while(!shard.lru.empty()){
+                    auto found = shard.sessions.find(shard.lru.back());
+                    if(found->second.lastAccess > deadline)
+                        break;
+
+                    evictLocked(shard, found);
+                }
+            }
+            enforce();
+        }
+
+        // Evict up to count least recently used sessions, e.g. when a memory budget is exceeded.
+        // Taken evenly from the shards, the oldest of each first.
+        std::size_t evictOldest(std::size_t count){
+            std::size_t evicted = 0;
+            auto perShard = (count + SHARDS - 1) / SHARDS;
+
+            for(auto& shard : shards_){
+                std::lock_guard lock(shard.mutex);
+                for(std::size_t taken = 0; taken < perShard && evicted < count && !shard.lru.empty(); taken++, evicted++){
+                    evictLocked(shard, shard.sessions.find(shard.lru.back()));
+                }
+            }
+            return evicted;
+        }
+
+        // the count sessions taking the most memory, largest first
+        std::vector<SessionUsage> largest(std::size_t count){
+            std::vector<SessionUsage> usage;
+            usage.reserve(count_);
+            for(auto& shard : shards_){
+                std::lock_guard lock(shard.mutex);
+                for(auto& [token, entry] : shard.sessions){
+                    usage.push_back({token.substr(0, 8), entry.bytes, entry.bank != nullptr});
+                }
+            }
+
+            count = std::min(count, usage.size());
+            std::partial_sort(usage.begin(), usage.begin() + count, usage.end(), [](auto& a, auto& b){
+                return a.bytes > b.bytes;
+            });
+            usage.resize(count);
+            return usage;
+        }
+
+        SessionGauges gauges(){
+            SessionGauges result;
+
+            for(auto& shard : shards_){
+                std::lock_guard lock(shard.mutex);
+                for(auto& [token, entry] : shard.sessions){
+                    if(entry.bank)
+                        result.resident++;
+                    else
+                        result.pendingRestore++;
+                }
+            }
+            result.bytes = totalBytes_;
+            result.evicted = evicted_;
+
+            return result;
+        }
+
+        bool contains(const std::string& token){
+            if(!accepted(token))
+                return false;
+
+            auto& shard = shardOf(token);
+            std::lock_guard lock(shard.mutex);
+            return shard.sessions.contains(token);
+        }
+
+        // Run an operation on the session of the given token through its mailbox, nullopt when there is
+        // no such session. Throws what SessionMailbox::call throws when the session is too busy.
+        template<class Operation>
+        auto use(const std::string& token, Operation&& operation)
+                -> std::optional<std::invoke_result_t<Operation, BcaBank&>>{
+            auto [bank, mailbox, checkpointedVersion] = materialize(token);
+            if(!bank)
+                return std::nullopt;
+
+            auto [result, state] = mailbox->call([&]{
+                auto result = operation(*bank);
+                bank->releaseBuffers();
+                return std::make_pair(std::move(result), capture(*bank, checkpointedVersion));
+            });
+
+            afterOperation(token, state);
+
+            return std::move(result);
+        }
+
+        // Log a session in again ahead of its expiry. Sessions which are busy are left to the
+        // request path, sessions still waiting to be restored are not reconnected.
+        std::optional<std::chrono::system_clock::time_point> refresh(const std::string& token){
+            std::shared_ptr<BcaBank> bank;
+            std::shared_ptr<SessionMailbox> mailbox;
+            uint64_t checkpointedVersion = 0;
+            std::chrono::system_clock::time_point observedExpiry;
+            if(!accepted(token))
+                return std::nullopt;
+            {
+                auto& shard = shardOf(token);
+                std::lock_guard lock(shard.mutex);
+                auto found = shard.sessions.find(token);
+                if(found == shard.sessions.end() || !found->second.bank)
+                    return std::nullopt;
+
+                bank = found->second.bank;
+                mailbox = found->second.mailbox;
+                checkpointedVersion = found->second.checkpointedVersion;
+                observedExpiry = found->second.observedExpiry;
+            }
+
+            // the bank belongs to the operation running on it, go by the expiry seen last
+            if(!mailbox->idle())
+                return observedExpiry;
+
+            std::optional<Capture> state;
+            try{
+                state = mailbox->call([&]() -> std::optional<Capture>{
+                    if(!bank->relogin())
+                        return std::nullopt;
+
+                    bank->releaseBuffers();
+                    return capture(*bank, checkpointedVersion);
+                });
+            }
+            catch(std::exception& err){
+                Logger::warn("session_refresh", err.what());
+                return std::nullopt;
+            }
+            if(!state)
+                return std::nullopt;
+
+            afterOperation(token, *state);
+
+            return state->expiry;
+        }
+
+        std::shared_ptr<BcaBank> remove(const std::string& token){
+            auto [bank, mailbox, checkpointedVersion] = materialize(token);
+            if(!bank)
+                return bank;
+
+            auto& shard = shardOf(token);
+            std::lock_guard lock(shard.mutex);
+            auto found = shard.sessions.find(token);
+            if(found != shard.sessions.end())
+                eraseLocked(shard, found);
+
+            return bank;
+        }
+    };
+}
+
+#endif //BANK_APP_SESSIONREGISTRY_H
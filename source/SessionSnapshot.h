@@ -0,0 +1,436 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_SESSIONSNAPSHOT_H
+#define BANK_APP_SESSIONSNAPSHOT_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+namespace bank_app{
+    // Everything needed to resume a logged in BCA session without talking to BCA
+    struct BcaSessionState{
+        std::string username;
+        std::string password;
+        std::string currentIp;
+        int64_t loginTimestamp = 0; // milliseconds since epoch
+        std::vector<std::string> cookies; // Set-Cookie formatted
+    };
+
+    // Memory mapped, versioned checkpoint of the live sessions.
+    // The file is split in fixed size slots, one per session, so a checkpoint only rewrites the slot
+    // of the session that changed. A slot sequence number is odd while it is being written which lets
+    // a torn slot be detected and skipped on restore.
+    // Written slots are only marked dirty, a background thread syncs them to disk in batches, so callers
+    // holding locks of their own never wait for an msync.
+    class SessionSnapshot{
+        static constexpr char MAGIC[8] = {'B', 'N', 'K', 'S', 'N', 'A', 'P', '\0'};
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t SLOT_SIZE = 4096;
+        static constexpr uint32_t TOKEN_SIZE = 64;
+        static constexpr uint32_t INITIAL_SLOTS = 64;
+        // how long slots written in a burst collect before they are synced together
+        static constexpr std::chrono::milliseconds FLUSH_DELAY{50};
+
+        struct FileHeader{
+            char magic[8];
+            uint32_t version;
+            uint32_t slotSize;
+            uint32_t slotCount;
+            uint32_t reserved[11];
+        };
+
+        struct SlotHeader{
+            uint32_t sequence;
+            uint32_t length;
+            uint64_t checksum;
+            char token[TOKEN_SIZE];
+        };
+
+        static constexpr uint32_t PAYLOAD_SIZE = SLOT_SIZE - sizeof(SlotHeader);
+
+        std::string path_;
+        std::optional<std::array<unsigned char, 32>> key_;
+        boost::interprocess::file_lock fileLock_;
+        std::unique_ptr<boost::interprocess::mapped_region> region_;
+        std::unordered_map<std::string, uint32_t> slotOf_;
+        std::vector<uint32_t> freeSlots_;
+        std::mutex mutex_;
+        // held shared while syncing outside mutex_, exclusive while the region is mapped again
+        std::shared_mutex regionMutex_;
+        std::vector<uint32_t> dirty_;
+        std::condition_variable dirtyChanged_;
+        bool stopping_ = false;
+        std::thread flusher_;
+
+        FileHeader* header(){
+            return static_cast<FileHeader*>(region_->get_address());
+        }
+
+        SlotHeader* slot(uint32_t index){
+            return reinterpret_cast<SlotHeader*>(static_cast<char*>(region_->get_address()) + SLOT_SIZE * (index + 1));
+        }
+
+        static uint64_t checksum(const char* data, std::size_t size){
+            uint64_t h = 14695981039346656037ull;
+            for(std::size_t i = 0; i < size; ++i){
+                h ^= static_cast<unsigned char>(data[i]);
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        void map(uint32_t slotCount){
+            auto fileSize = static_cast<std::uintmax_t>(SLOT_SIZE) * (slotCount + 1);
+
+            if(std::filesystem::file_size(path_) < fileSize){
+                std::filesystem::resize_file(path_, fileSize);
+            }
+
+            std::unique_lock lock(regionMutex_);
+            region_.reset();
+            boost::interprocess::file_mapping mapping(path_.c_str(), boost::interprocess::read_write);
+            region_ = std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_write, 0, fileSize);
+        }
+
+        void markDirty(uint32_t index){
+            dirty_.push_back(index);
+            dirtyChanged_.notify_one();
+        }
+
+        // sync the slots in runs of neighbours, one msync per run
+        void sync(std::vector<uint32_t>& slots){
+            std::sort(slots.begin(), slots.end());
+            slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+            std::shared_lock lock(regionMutex_);
+            for(std::size_t first = 0; first < slots.size();){
+                auto last = first;
+                while(last + 1 < slots.size() && slots[last + 1] == slots[last] + 1){
+                    last++;
+                }
+
+                region_->flush(static_cast<std::size_t>(SLOT_SIZE) * (slots[first] + 1),
+                               static_cast<std::size_t>(SLOT_SIZE) * (last - first + 1), true);
+                first = last + 1;
+            }
+        }
+
+        void runFlusher(){
+            std::unique_lock lock(mutex_);
+            while(true){
+                dirtyChanged_.wait(lock, [this]{ return stopping_ || !dirty_.empty(); });
+                if(dirty_.empty())
+                    return;
+
+                if(!stopping_)
+                    dirtyChanged_.wait_for(lock, FLUSH_DELAY, [this]{ return stopping_; });
+
+                auto slots = std::move(dirty_);
+                dirty_.clear();
+
+                lock.unlock();
+                sync(slots);
+                lock.lock();
+            }
+        }
+
+        void grow(){
+            auto oldCount = header()->slotCount;
+            auto newCount = oldCount * 2;
+
+            map(newCount);
+
+            for(auto i = newCount; i > oldCount; --i){
+                freeSlots_.push_back(i - 1);
+            }
+
+            header()->slotCount = newCount;
+            region_->flush(0, sizeof(FileHeader), false);
+        }
+
+        void initialize(){
+            std::filesystem::resize_file(path_, 0);
+            map(INITIAL_SLOTS);
+
+            auto fileHeader = header();
+            std::memset(fileHeader, 0, sizeof(FileHeader));
+            std::memcpy(fileHeader->magic, MAGIC, sizeof(MAGIC));
+            fileHeader->version = VERSION;
+            fileHeader->slotSize = SLOT_SIZE;
+            fileHeader->slotCount = INITIAL_SLOTS;
+            region_->flush(0, sizeof(FileHeader), false);
+        }
+
+        // length prefixed encoding of the session fields
+        static void putString(std::string& out, std::string_view value){
+            auto size = static_cast<uint16_t>(value.size());
+            out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.append(value.data(), size);
+        }
+
+        static bool getString(std::string_view& in, std::string& value){
+            uint16_t size = 0;
+            if(in.size() < sizeof(size))
+                return false;
+
+            std::memcpy(&size, in.data(), sizeof(size));
+            in.remove_prefix(sizeof(size));
+            if(in.size() < size)
+                return false;
+
+            value.assign(in.data(), size);
+            in.remove_prefix(size);
+            return true;
+        }
+
+        // The password is only persisted sealed with AES-256-GCM under BANK_APP_SNAPSHOT_KEY
+        std::string seal(const std::string& secret){
+            if(!key_ || secret.empty())
+                return {};
+
+            unsigned char iv[12];
+            unsigned char tag[16];
+            std::string cipher(secret.size(), '\0');
+            int outLen = 0;
+
+            RAND_bytes(iv, sizeof(iv));
+
+            std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+            EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key_->data(), iv);
+            EVP_EncryptUpdate(ctx.get(), reinterpret_cast<unsigned char*>(cipher.data()), &outLen,
+                              reinterpret_cast<const unsigned char*>(secret.data()), static_cast<int>(secret.size()));
+            EVP_EncryptFinal_ex(ctx.get(), nullptr, &outLen);
+            EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, sizeof(tag), tag);
+
+            return std::string(reinterpret_cast<char*>(iv), sizeof(iv)) +
+                   std::string(reinterpret_cast<char*>(tag), sizeof(tag)) + cipher;
+        }
+
+        std::string unseal(const std::string& sealed){
+            constexpr std::size_t prefix = 12 + 16;
+            if(!key_ || sealed.size() <= prefix)
+                return {};
+
+            auto iv = reinterpret_cast<const unsigned char*>(sealed.data());
+            auto tag = const_cast<unsigned char*>(iv + 12);
+            std::string plain(sealed.size() - prefix, '\0');
+            int outLen = 0;
+
+            std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+            EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key_->data(), iv);
+            EVP_DecryptUpdate(ctx.get(), reinterpret_cast<unsigned char*>(plain.data()), &outLen,
+                              iv + prefix, static_cast<int>(plain.size()));
+            EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, 16, tag);
+
+            if(EVP_DecryptFinal_ex(ctx.get(), nullptr, &outLen) != 1)
+                return {};
+
+            return plain;
+        }
+
+    public:
+        SessionSnapshot(std::string path, const std::string& secretKey = "") : path_(std::move(path)){
+            if(!secretKey.empty()){
+                std::array<unsigned char, 32> key{};
+                SHA256(reinterpret_cast<const unsigned char*>(secretKey.data()), secretKey.size(), key.data());
+                key_ = key;
+            }
+
+            if(!std::filesystem::exists(path_)){
+                std::ofstream(path_, std::ios::binary);
+                std::filesystem::permissions(path_, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+            }
+
+            // only one process may own the snapshot at a time
+            fileLock_ = boost::interprocess::file_lock(path_.c_str());
+            if(!fileLock_.try_lock()){
+                throw std::runtime_error("session snapshot " + path_ + " is locked by another process");
+            }
+
+            auto fileSize = std::filesystem::file_size(path_);
+            bool valid = false;
+
+            if(fileSize >= SLOT_SIZE){
+                FileHeader existing{};
+                std::ifstream(path_, std::ios::binary).read(reinterpret_cast<char*>(&existing), sizeof(existing));
+
+                valid = std::memcmp(existing.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                        existing.version == VERSION &&
+                        existing.slotSize == SLOT_SIZE &&
+                        existing.slotCount > 0 &&
+                        fileSize >= static_cast<std::uintmax_t>(SLOT_SIZE) * (existing.slotCount + 1);
+
+                if(valid)
+                    map(existing.slotCount);
+            }
+
+            // unknown layout, start over rather than misreading it
+            if(!valid)
+                initialize();
+
+            flusher_ = std::thread([this]{ runFlusher(); });
+        }
+
+        // slots still dirty are synced before the region is unmapped
+        ~SessionSnapshot(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            dirtyChanged_.notify_one();
+            flusher_.join();
+        }
+
+        SessionSnapshot(const SessionSnapshot&) = delete;
+        SessionSnapshot& operator=(const SessionSnapshot&) = delete;
+
+        // sync every slot written so far, e.g. before the process exits without unwinding
+        void flush(){
+            std::vector<uint32_t> slots;
+            {
+                std::lock_guard lock(mutex_);
+                slots = std::move(dirty_);
+                dirty_.clear();
+            }
+            sync(slots);
+        }
+
+        // Scan the slots, returning every intact session and indexing the slots they occupy
+        std::vector<std::pair<std::string, BcaSessionState>> load(){
+            std::lock_guard lock(mutex_);
+            std::vector<std::pair<std::string, BcaSessionState>> result;
+
+            slotOf_.clear();
+            freeSlots_.clear();
+
+            auto slotCount = header()->slotCount;
+            for(auto i = slotCount; i > 0; --i){
+                auto index = i - 1;
+                auto current = slot(index);
+                auto payload = reinterpret_cast<const char*>(current + 1);
+
+                if(current->length == 0 || current->sequence % 2 != 0 || current->length > PAYLOAD_SIZE ||
+                   checksum(payload, current->length) != current->checksum){
+                    freeSlots_.push_back(index);
+                    continue;
+                }
+
+                std::string_view in(payload, current->length);
+                BcaSessionState state;
+                std::string sealedPassword, timestamp, cookie;
+                bool ok = getString(in, state.username) && getString(in, sealedPassword) &&
+                          getString(in, state.currentIp) && getString(in, timestamp) &&
+                          timestamp.size() == sizeof(state.loginTimestamp);
+
+                while(ok && !in.empty()){
+                    ok = getString(in, cookie);
+                    state.cookies.push_back(cookie);
+                }
+
+                if(!ok){
+                    freeSlots_.push_back(index);
+                    continue;
+                }
+
+                std::memcpy(&state.loginTimestamp, timestamp.data(), sizeof(state.loginTimestamp));
+                state.password = unseal(sealedPassword);
+
+                std::string token(current->token, strnlen(current->token, TOKEN_SIZE));
+                slotOf_[token] = index;
+                result.emplace_back(std::move(token), std::move(state));
+            }
+
+            return result;
+        }
+
+        // Checkpoint one session, only its slot is rewritten and synced by the background thread
+        bool store(const std::string& token, const BcaSessionState& state){
+            std::string out;
+            putString(out, state.username);
+            putString(out, seal(state.password));
+            putString(out, state.currentIp);
+            putString(out, std::string_view(reinterpret_cast<const char*>(&state.loginTimestamp), sizeof(state.loginTimestamp)));
+            for(auto& cookie : state.cookies){
+                putString(out, cookie);
+            }
+
+            if(out.size() > PAYLOAD_SIZE || token.size() >= TOKEN_SIZE)
+                return false;
+
+            std::lock_guard lock(mutex_);
+
+            uint32_t index;
+            auto found = slotOf_.find(token);
+            if(found != slotOf_.end()){
+                index = found->second;
+            }
+            else{
+                if(freeSlots_.empty())
+                    grow();
+
+                index = freeSlots_.back();
+                freeSlots_.pop_back();
+                slotOf_[token] = index;
+            }
+
+            auto current = slot(index);
+            current->sequence |= 1;
+            std::atomic_thread_fence(std::memory_order_release);
+
+            std::memset(current->token, 0, TOKEN_SIZE);
+            std::memcpy(current->token, token.data(), token.size());
+            std::memcpy(current + 1, out.data(), out.size());
+            current->length = static_cast<uint32_t>(out.size());
+            current->checksum = checksum(out.data(), out.size());
+
+            std::atomic_thread_fence(std::memory_order_release);
+            current->sequence += 1;
+
+            markDirty(index);
+            return true;
+        }
+
+        void remove(const std::string& token){
+            std::lock_guard lock(mutex_);
+
+            auto found = slotOf_.find(token);
+            if(found == slotOf_.end())
+                return;
+
+            auto current = slot(found->second);
+            current->length = 0;
+            current->sequence += 2;
+            markDirty(found->second);
+
+            freeSlots_.push_back(found->second);
+            slotOf_.erase(found);
+        }
+    };
+}
+
+#endif //BANK_APP_SESSIONSNAPSHOT_H
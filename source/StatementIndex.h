@@ -0,0 +1,193 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_STATEMENTINDEX_H
+#define BANK_APP_STATEMENTINDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include "StatementTable.h"
+
+namespace bank_app{
+    struct StatementQuery{
+        // matched case insensitively anywhere in the description, empty matches every row
+        std::string text;
+        int64_t minAmount = std::numeric_limits<int64_t>::min();
+        int64_t maxAmount = std::numeric_limits<int64_t>::max();
+        int32_t from = std::numeric_limits<int32_t>::min();
+        int32_t to = std::numeric_limits<int32_t>::max();
+        std::optional<bool> credit;
+        std::size_t limit = 100;
+    };
+
+    // Every statement row fetched for an account, with trigram postings over the descriptions so a
+    // search only verifies the rows sharing all trigrams of the query. Fetches are merged in as they
+    // come, rows already known from an overlapping range are not added twice.
+    class StatementIndex{
+        typedef uint32_t Trigram;
+        // row key used to recognise rows seen in an earlier fetch
+        typedef std::tuple<int32_t, int64_t, bool, std::string_view> RowKey;
+
+        StatementTable rows_;
+        std::unordered_map<Trigram, std::vector<uint32_t>> postings_;
+        std::size_t postingCount_ = 0;
+
+        static char upper(char c){
+            return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+        }
+
+        static Trigram trigramAt(std::string_view text, std::size_t i){
+            return static_cast<Trigram>(static_cast<unsigned char>(upper(text[i]))) << 16 |
+                   static_cast<Trigram>(static_cast<unsigned char>(upper(text[i + 1]))) << 8 |
+                   static_cast<Trigram>(static_cast<unsigned char>(upper(text[i + 2])));
+        }
+
+        static std::vector<Trigram> trigrams(std::string_view text){
+            std::vector<Trigram> result;
+            for(std::size_t i = 0; i + 3 <= text.size(); i++){
+                result.push_back(trigramAt(text, i));
+            }
+
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        static bool containsIgnoreCase(std::string_view text, std::string_view needle){
+            if(needle.size() > text.size())
+                return false;
+
+            for(std::size_t i = 0; i + needle.size() <= text.size(); i++){
+                std::size_t j = 0;
+                while(j < needle.size() && upper(text[i + j]) == upper(needle[j])){
+                    j++;
+                }
+                if(j == needle.size())
+                    return true;
+            }
+            return false;
+        }
+
+        void indexRow(uint32_t row){
+            for(auto trigram : trigrams(rows_.description(row))){
+                postings_[trigram].push_back(row);
+                postingCount_++;
+            }
+        }
+
+        bool accepts(const StatementQuery& query, uint32_t row) const {
+            auto amount = rows_.amount(row);
+            auto date = rows_.date(row);
+
+            return amount >= query.minAmount && amount <= query.maxAmount &&
+                   date >= query.from && date <= query.to &&
+                   (!query.credit || *query.credit == rows_.credit(row)) &&
+                   containsIgnoreCase(rows_.description(row), query.text);
+        }
+
+        // rows holding every trigram of the query, nullopt when the query is too short to use the postings
+        std::optional<std::vector<uint32_t>> candidates(std::string_view text) const {
+            if(text.size() < 3)
+                return std::nullopt;
+
+            std::vector<const std::vector<uint32_t>*> lists;
+            for(auto trigram : trigrams(text)){
+                auto found = postings_.find(trigram);
+                if(found == postings_.end())
+                    return std::vector<uint32_t>();
+
+                lists.push_back(&found->second);
+            }
+
+            std::sort(lists.begin(), lists.end(), [](auto a, auto b){ return a->size() < b->size(); });
+
+            // the shortest list drives, the others are probed with a binary search as rows only grow
+            std::vector<uint32_t> result;
+            for(auto row : *lists.front()){
+                bool inAll = true;
+                for(std::size_t i = 1; i < lists.size() && inAll; i++){
+                    inAll = std::binary_search(lists[i]->begin(), lists[i]->end(), row);
+                }
+                if(inAll)
+                    result.push_back(row);
+            }
+
+            return result;
+        }
+
+    public:
+        // Merge the rows of a fetch covering the dates [from, to]. A row is new when the fetch holds it
+        // more often than the rows already indexed for that range do.
+        std::size_t merge(const StatementTable& fetched, int32_t from, int32_t to){
+            std::map<RowKey, std::size_t> known;
+            for(std::size_t row = 0; row < rows_.size(); row++){
+                auto date = rows_.date(row);
+                if(date >= from && date <= to)
+                    known[{date, rows_.amount(row), rows_.credit(row), rows_.description(row)}]++;
+            }
+
+            std::size_t added = 0;
+            for(std::size_t row = 0; row < fetched.size(); row++){
+                auto found = known.find({fetched.date(row), fetched.amount(row), fetched.credit(row), fetched.description(row)});
+                if(found != known.end() && found->second > 0){
+                    found->second--;
+                    continue;
+                }
+
+                rows_.append(fetched.date(row), fetched.amount(row), fetched.credit(row), fetched.description(row));
+                indexRow(static_cast<uint32_t>(rows_.size() - 1));
+                added++;
+            }
+
+            return added;
+        }
+
+        // matching rows, oldest fetched first
+        std::vector<uint32_t> search(const StatementQuery& query) const {
+            std::vector<uint32_t> result;
+            if(query.limit == 0)
+                return result;
+
+            auto accept = [&](uint32_t row){
+                if(accepts(query, row))
+                    result.push_back(row);
+                return result.size() < query.limit;
+            };
+
+            if(auto rows = candidates(query.text)){
+                for(auto row : *rows){
+                    if(!accept(row))
+                        break;
+                }
+            }
+            else{
+                for(uint32_t row = 0; row < rows_.size(); row++){
+                    if(!accept(row))
+                        break;
+                }
+            }
+
+            return result;
+        }
+
+        const StatementTable& rows() const {
+            return rows_;
+        }
+
+        std::size_t residentBytes() const {
+            return rows_.residentBytes() + postingCount_ * sizeof(uint32_t) +
+                   postings_.size() * (sizeof(Trigram) + sizeof(std::vector<uint32_t>) + 2 * sizeof(void*));
+        }
+    };
+}
+
+#endif //BANK_APP_STATEMENTINDEX_H
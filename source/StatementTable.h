@@ -0,0 +1,307 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_STATEMENTTABLE_H
+#define BANK_APP_STATEMENTTABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace bank_app{
+    // Each distinct description is stored once, rows refer to it by id
+    class StringInterner{
+        std::deque<std::string> strings_;
+        std::unordered_map<std::string_view, uint32_t> ids_;
+
+    public:
+        uint32_t intern(std::string_view text){
+            auto found = ids_.find(text);
+            if(found != ids_.end())
+                return found->second;
+
+            auto id = static_cast<uint32_t>(strings_.size());
+            auto& stored = strings_.emplace_back(text);
+            ids_.emplace(stored, id);
+
+            return id;
+        }
+
+        std::string_view operator[](uint32_t id) const {
+            return strings_[id];
+        }
+
+        std::size_t size() const {
+            return strings_.size();
+        }
+
+        std::size_t residentBytes() const {
+            std::size_t bytes = ids_.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+            for(auto& text : strings_){
+                bytes += sizeof(std::string) + (text.size() > 15 ? text.capacity() : 0);
+            }
+            return bytes;
+        }
+    };
+
+    struct StatementTotals{
+        uint64_t count = 0;
+        int64_t sum = 0;
+        int64_t min = 0;
+        int64_t max = 0;
+    };
+
+    struct StatementSummary{
+        StatementTotals credit;
+        StatementTotals debit;
+    };
+
+    // Statement rows parsed once into columns. Amounts are in minor units (sen), dates are yyyymmdd
+    // and the direction of every row is a bit, set for credits.
+    class StatementTable{
+        std::vector<int32_t> dates_;
+        std::vector<int64_t> amounts_;
+        std::vector<uint64_t> creditBits_;
+        std::vector<uint32_t> descriptions_;
+        StringInterner interner_;
+
+        // eight ascii digits to their value in a few multiplications, little endian load
+        static uint32_t parseEightDigits(const char* digits){
+            uint64_t value;
+            std::memcpy(&value, digits, sizeof(value));
+
+            value -= 0x3030303030303030ULL;
+            value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFULL;
+            value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFULL;
+            value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFFULL;
+
+            return static_cast<uint32_t>(value);
+        }
+
+        static bool isSpace(char c){
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        static std::string_view trim(std::string_view text){
+            while(!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+            while(!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+            return text;
+        }
+
+    public:
+        // Amount in minor units out of "1.234.567,00", "1,234,567.00", "Rp. 50.000" or "10000.00 CR".
+        // The separator followed by exactly two digits at the end is the decimal one. A trailing CR or
+        // DB sets credit when given.
+        static std::optional<int64_t> parseAmount(std::string_view text, bool* credit = nullptr, bool requireFraction = false){
+            text = trim(text);
+
+            if(text.size() > 2){
+                auto suffix = text.substr(text.size() - 2);
+                if(suffix == "CR" || suffix == "DB"){
+                    if(credit)
+                        *credit = suffix == "CR";
+                    text = trim(text.substr(0, text.size() - 2));
+                }
+            }
+            if(text.starts_with("Rp"))
+                text.remove_prefix(2);
+            else if(text.starts_with("IDR"))
+                text.remove_prefix(3);
+            if(text.starts_with("."))
+                text.remove_prefix(1);
+            text = trim(text);
+
+            bool negative = text.starts_with("-");
+            if(negative)
+                text.remove_prefix(1);
+
+            auto decimal = text.size() >= 3 && (text[text.size() - 3] == ',' || text[text.size() - 3] == '.')
+                    ? text.size() - 3 : std::string_view::npos;
+
+            // digits right aligned in a zero padded buffer, two of them always the fraction
+            char digits[16];
+            std::memset(digits, '0', sizeof(digits));
+            std::size_t count = 0;
+            char compact[18];
+
+            for(std::size_t i = 0; i < text.size(); i++){
+                auto c = text[i];
+                if(c >= '0' && c <= '9'){
+                    if(count == sizeof(compact))
+                        return std::nullopt;
+                    compact[count++] = c;
+                }
+                else if(i == decimal || c == '.' || c == ','){
+                    continue;
+                }
+                else{
+                    return std::nullopt;
+                }
+            }
+
+            if(count == 0 || (requireFraction && decimal == std::string_view::npos))
+                return std::nullopt;
+
+            // a whole amount gets the two fraction digits appended, the result has to fit digits
+            std::size_t fraction = decimal == std::string_view::npos ? 2 : 0;
+            if(count + fraction > sizeof(digits))
+                return std::nullopt;
+            for(; fraction > 0; fraction--){
+                compact[count++] = '0';
+            }
+
+            std::memcpy(digits + sizeof(digits) - count, compact, count);
+            auto amount = static_cast<int64_t>(parseEightDigits(digits)) * 100000000 + parseEightDigits(digits + 8);
+
+            return negative ? -amount : amount;
+        }
+
+        // "dd/mm" of the statement page, the year is the one which puts the date on or before the end of
+        // the range. Pending rows ("PEND") are dated at the end of the range.
+        static int32_t parseDate(std::string_view text, int32_t rangeEnd){
+            text = trim(text);
+            auto isDigit = [](char c){ return c >= '0' && c <= '9'; };
+
+            if(text.size() != 5 || text[2] != '/' ||
+               !isDigit(text[0]) || !isDigit(text[1]) || !isDigit(text[3]) || !isDigit(text[4]))
+                return rangeEnd;
+
+            int32_t day = (text[0] - '0') * 10 + (text[1] - '0');
+            int32_t month = (text[3] - '0') * 10 + (text[4] - '0');
+            int32_t year = rangeEnd / 10000;
+
+            if(month * 100 + day > rangeEnd % 10000)
+                year--;
+
+            return year * 10000 + month * 100 + day;
+        }
+
+        static std::string formatAmount(int64_t amount){
+            auto negative = amount < 0;
+            auto magnitude = negative ? -static_cast<uint64_t>(amount) : static_cast<uint64_t>(amount);
+            auto fraction = magnitude % 100;
+
+            return (negative ? "-" : "") + std::to_string(magnitude / 100) + "." +
+                   static_cast<char>('0' + fraction / 10) + static_cast<char>('0' + fraction % 10);
+        }
+
+        void append(int32_t date, int64_t amount, bool credit, std::string_view description){
+            auto row = amounts_.size();
+            if(row % 64 == 0)
+                creditBits_.push_back(0);
+
+            dates_.push_back(date);
+            amounts_.push_back(amount);
+            creditBits_.back() |= static_cast<uint64_t>(credit) << (row % 64);
+            descriptions_.push_back(interner_.intern(description));
+        }
+
+        // Parse the three cells of a statement row. Descriptions keep their lines joined by spaces,
+        // the amount is the last line which reads as one unless the direction cell carries it.
+        bool appendRow(std::string_view dateCell, std::string_view descriptionCell, std::string_view directionCell, int32_t rangeEnd){
+            std::vector<std::string_view> lines;
+            std::string_view rest = descriptionCell;
+            while(!rest.empty()){
+                auto lineEnd = rest.find('<');
+                auto line = trim(rest.substr(0, lineEnd));
+                if(!line.empty())
+                    lines.push_back(line);
+
+                if(lineEnd == std::string_view::npos)
+                    break;
+
+                auto tagEnd = rest.find('>', lineEnd);
+                rest = tagEnd == std::string_view::npos ? std::string_view() : rest.substr(tagEnd + 1);
+            }
+
+            bool credit = trim(directionCell) == "CR";
+            auto amount = parseAmount(directionCell, &credit);
+            std::size_t amountLine = lines.size();
+
+            for(std::size_t i = lines.size(); !amount && i > 0; i--){
+                amount = parseAmount(lines[i - 1], &credit, true);
+                if(amount)
+                    amountLine = i - 1;
+            }
+
+            if(!amount)
+                return false;
+
+            std::string description;
+            for(std::size_t i = 0; i < lines.size(); i++){
+                if(i == amountLine)
+                    continue;
+                if(!description.empty())
+                    description.push_back(' ');
+                description.append(lines[i]);
+            }
+
+            append(parseDate(dateCell, rangeEnd), *amount, credit, description);
+            return true;
+        }
+
+        std::size_t size() const {
+            return amounts_.size();
+        }
+
+        int32_t date(std::size_t row) const {
+            return dates_[row];
+        }
+
+        int64_t amount(std::size_t row) const {
+            return amounts_[row];
+        }
+
+        bool credit(std::size_t row) const {
+            return (creditBits_[row / 64] >> (row % 64)) & 1;
+        }
+
+        std::string_view description(std::size_t row) const {
+            return interner_[descriptions_[row]];
+        }
+
+        std::size_t residentBytes() const {
+            return dates_.capacity() * sizeof(int32_t) + amounts_.capacity() * sizeof(int64_t) +
+                   creditBits_.capacity() * sizeof(uint64_t) + descriptions_.capacity() * sizeof(uint32_t) +
+                   interner_.residentBytes();
+        }
+
+        // totals per direction of the rows dated within [from, to]
+        StatementSummary summarize(int32_t from = std::numeric_limits<int32_t>::min(),
+                                   int32_t to = std::numeric_limits<int32_t>::max()) const {
+            StatementTotals totals[2];
+            totals[0].min = totals[1].min = std::numeric_limits<int64_t>::max();
+            totals[0].max = totals[1].max = std::numeric_limits<int64_t>::min();
+
+            for(std::size_t row = 0; row < amounts_.size(); row++){
+                auto date = dates_[row];
+                if(date < from || date > to)
+                    continue;
+
+                auto& total = totals[credit(row)];
+                auto amount = amounts_[row];
+                total.count++;
+                total.sum += amount;
+                total.min = std::min(total.min, amount);
+                total.max = std::max(total.max, amount);
+            }
+
+            for(auto& total : totals){
+                if(total.count == 0)
+                    total.min = total.max = 0;
+            }
+
+            return {totals[1], totals[0]};
+        }
+    };
+}
+
+#endif //BANK_APP_STATEMENTTABLE_H
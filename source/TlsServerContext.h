@@ -0,0 +1,204 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_TLSSERVERCONTEXT_H
+#define BANK_APP_TLSSERVERCONTEXT_H
+
+#include <boost/asio/ssl.hpp>
+#include <openssl/ssl.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/core_names.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <cstring>
+#include "Logger.h"
+
+namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace ssl = net::ssl;               // from <boost/asio/ssl.hpp>
+
+namespace bank_app{
+    // ALPN protocols in order of preference, in wire format. A protocol added here also needs a session type.
+    constexpr unsigned char ALPN_PROTOCOLS[] = {8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+
+    // Session ticket keys, in the 80 byte layout nginx uses: name, HMAC key, AES key. The first key of the
+    // file encrypts new tickets, all of them decrypt. Replicas sharing the file resume each other's
+    // sessions; to rotate, prepend a new key (openssl rand 80) and drop the oldest once tickets expired.
+    class TlsTicketKeys{
+        struct Key{
+            unsigned char name[16];
+            unsigned char hmac[32];
+            unsigned char aes[32];
+        };
+        static_assert(sizeof(Key) == 80);
+
+        static constexpr std::chrono::seconds RELOAD_INTERVAL{30};
+
+        std::string path_;
+        std::shared_mutex mutex_;
+        std::vector<Key> keys_;
+        std::filesystem::file_time_type loadedWrite_{};
+        std::atomic<int64_t> nextCheck_ = 0;
+
+        void load(){
+            std::ifstream file(path_, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            if(content.empty() || content.size() % sizeof(Key) != 0)
+                throw std::runtime_error("ticket key file " + path_ + " must hold one or more 80 byte keys");
+
+            std::vector<Key> keys(content.size() / sizeof(Key));
+            std::memcpy(keys.data(), content.data(), content.size());
+
+            std::unique_lock lock(mutex_);
+            keys_ = std::move(keys);
+            loadedWrite_ = std::filesystem::last_write_time(path_);
+        }
+
+        // pick up a rotated file, checked at most once per interval from the handshakes
+        void reloadIfChanged(){
+            if(path_.empty())
+                return;
+
+            auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+            auto nextCheck = nextCheck_.load();
+            if(now < nextCheck || !nextCheck_.compare_exchange_strong(nextCheck, now + std::chrono::steady_clock::duration(RELOAD_INTERVAL).count()))
+                return;
+
+            try{
+                std::error_code ec;
+                auto written = std::filesystem::last_write_time(path_, ec);
+                std::shared_lock lock(mutex_);
+                if(ec || written == loadedWrite_)
+                    return;
+                lock.unlock();
+
+                load();
+            }
+            catch(std::exception& err){
+                Logger::warn("tls_ticket_keys", "not reloaded", err.what());
+            }
+        }
+
+        static bool useKey(const Key& key, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt){
+            OSSL_PARAM params[] = {
+                    OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, const_cast<unsigned char*>(key.hmac), sizeof(key.hmac)),
+                    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+                    OSSL_PARAM_construct_end()
+            };
+
+            return EVP_MAC_CTX_set_params(mac, params) == 1 &&
+                   EVP_CipherInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv, encrypt) == 1;
+        }
+
+    public:
+        // without a file a random key is generated, tickets then only resume on this process
+        explicit TlsTicketKeys(std::string path = "") : path_(std::move(path)){
+            if(!path_.empty()){
+                load();
+                return;
+            }
+
+            keys_.resize(1);
+            if(RAND_bytes(reinterpret_cast<unsigned char*>(keys_.data()), sizeof(Key)) != 1)
+                throw std::runtime_error("no randomness for the ticket key");
+        }
+
+        // SSL_CTX_set_tlsext_ticket_key_evp_cb contract: 1 ticket ok, 2 ok but renew it, 0 full handshake
+        int ticket(unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt){
+            reloadIfChanged();
+            std::shared_lock lock(mutex_);
+
+            if(encrypt){
+                auto& key = keys_.front();
+                if(RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1)
+                    return -1;
+
+                std::memcpy(name, key.name, sizeof(key.name));
+                return useKey(key, iv, cipher, mac, 1) ? 1 : -1;
+            }
+
+            for(std::size_t i = 0; i < keys_.size(); i++){
+                if(std::memcmp(name, keys_[i].name, sizeof(keys_[i].name)) != 0)
+                    continue;
+
+                if(!useKey(keys_[i], iv, cipher, mac, 0))
+                    return -1;
+                return i == 0 ? 1 : 2;
+            }
+
+            return 0;
+        }
+    };
+
+    // Server side TLS of the inbound listener: certificate, session tickets and ALPN
+    class TlsServerContext{
+        struct Stats{
+            std::atomic<uint64_t> handshakes = 0;
+            std::atomic<uint64_t> resumed = 0;
+            std::atomic<uint64_t> failed = 0;
+        };
+
+        ssl::context context_{ssl::context::tls_server};
+        TlsTicketKeys ticketKeys_;
+
+        static int ticketCallback(SSL* connection, unsigned char* name, unsigned char* iv,
+                                  EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt){
+            auto self = static_cast<TlsServerContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(connection)));
+            return self->ticketKeys_.ticket(name, iv, cipher, mac, encrypt);
+        }
+
+        static int alpnCallback(SSL*, const unsigned char** out, unsigned char* outSize,
+                                const unsigned char* offered, unsigned int offeredSize, void*){
+            unsigned char* selected = nullptr;
+            if(SSL_select_next_proto(&selected, outSize, ALPN_PROTOCOLS, sizeof(ALPN_PROTOCOLS), offered, offeredSize) != OPENSSL_NPN_NEGOTIATED)
+                return SSL_TLSEXT_ERR_NOACK;
+
+            *out = selected;
+            return SSL_TLSEXT_ERR_OK;
+        }
+
+    public:
+        TlsServerContext(const std::string& certificateChain, const std::string& privateKey, const std::string& ticketKeyPath = "")
+                : ticketKeys_(ticketKeyPath){
+            context_.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3 |
+                                 ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 | ssl::context::single_dh_use);
+            context_.use_certificate_chain_file(certificateChain);
+            context_.use_private_key_file(privateKey, ssl::context::pem);
+
+            auto native = context_.native_handle();
+            SSL_CTX_set_app_data(native, this);
+
+            // resumption is stateless, no server side cache to share between replicas
+            SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(native, &TlsServerContext::ticketCallback);
+            SSL_CTX_set_alpn_select_cb(native, &TlsServerContext::alpnCallback, nullptr);
+        }
+
+        TlsServerContext(const TlsServerContext&) = delete;
+        TlsServerContext& operator=(const TlsServerContext&) = delete;
+
+        ssl::context& context(){
+            return context_;
+        }
+
+        static Stats& stats(){
+            static Stats stats;
+            return stats;
+        }
+    };
+}
+
+#endif //BANK_APP_TLSSERVERCONTEXT_H
@@ -0,0 +1,249 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_TOKENSERVICE_H
+#define BANK_APP_TOKENSERVICE_H
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <string>
+#include <string_view>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+namespace bank_app{
+    // RAND_bytes drawn a block at a time into a buffer of the calling thread, so small draws neither
+    // lock the OpenSSL DRBG nor go through its call overhead. Handed out bytes are wiped from the buffer.
+    class SecureRandom{
+        static constexpr std::size_t POOL_SIZE = 512;
+
+        struct Pool{
+            std::array<unsigned char, POOL_SIZE> bytes{};
+            std::size_t used = POOL_SIZE;
+
+            ~Pool(){
+                OPENSSL_cleanse(bytes.data(), bytes.size());
+            }
+        };
+
+    public:
+        static void fill(void* out, std::size_t size){
+            if(size > POOL_SIZE / 4){
+                if(RAND_bytes(static_cast<unsigned char*>(out), static_cast<int>(size)) != 1)
+                    throw std::runtime_error("RAND_bytes failed");
+                return;
+            }
+
+            static thread_local Pool pool;
+            if(pool.used + size > POOL_SIZE){
+                if(RAND_bytes(pool.bytes.data(), POOL_SIZE) != 1)
+                    throw std::runtime_error("RAND_bytes failed");
+                pool.used = 0;
+            }
+
+            std::memcpy(out, pool.bytes.data() + pool.used, size);
+            OPENSSL_cleanse(pool.bytes.data() + pool.used, size);
+            pool.used += size;
+        }
+
+        template<std::size_t Size>
+        static std::array<unsigned char, Size> bytes(){
+            std::array<unsigned char, Size> result;
+            fill(result.data(), Size);
+            return result;
+        }
+    };
+
+    // Lowercase hex without branches on the data, tokens are secrets and are compared and decoded in constant time
+    struct Hex{
+        static char digit(unsigned value){
+            auto nibble = static_cast<int>(value & 0xf);
+            // 39 moves the digits past 9 from ':' up to 'a'
+            return static_cast<char>('0' + nibble + (((9 - nibble) >> 31) & 39));
+        }
+
+        // the value of a lowercase hex digit, -1 for any other character
+        static int value(char c){
+            int digitOffset = static_cast<unsigned char>(c) - '0';
+            int letterOffset = static_cast<unsigned char>(c) - 'a';
+            int isDigit = ~((digitOffset | (9 - digitOffset)) >> 31);
+            int isLetter = ~((letterOffset | (5 - letterOffset)) >> 31);
+            return (digitOffset & isDigit) | ((letterOffset + 10) & isLetter) | ~(isDigit | isLetter);
+        }
+
+        static void encode(const unsigned char* data, std::size_t size, char* out){
+            for(std::size_t i = 0; i < size; i++){
+                out[2 * i] = digit(data[i] >> 4);
+                out[2 * i + 1] = digit(data[i]);
+            }
+        }
+
+        template<std::size_t Size>
+        static std::string encode(const std::array<unsigned char, Size>& data){
+            std::string text(2 * Size, '\0');
+            encode(data.data(), Size, text.data());
+            return text;
+        }
+
+        // false when text holds anything but lowercase hex digits, out is then garbage
+        static bool decode(std::string_view text, unsigned char* out){
+            int invalid = 0;
+            for(std::size_t i = 0; i < text.size() / 2; i++){
+                auto high = value(text[2 * i]), low = value(text[2 * i + 1]);
+                invalid |= high | low;
+                out[i] = static_cast<unsigned char>((high << 4) | (low & 0xf));
+            }
+            return invalid >= 0 && text.size() % 2 == 0;
+        }
+    };
+
+    // Session tokens which prove themselves: routing point, expiry and a nonce, sealed with a truncated
+    // HMAC-SHA256 under BANK_APP_TOKEN_KEY. Forged, damaged and expired tokens are told apart from live
+    // ones without a lookup. The routing point comes first so the token starts with the routing key of
+    // ClusterRing, its low byte picks the shard of SessionRegistry.
+    class TokenService{
+    public:
+        static constexpr std::size_t ROUTING_BYTES = 4;
+        static constexpr std::size_t EXPIRY_BYTES = 4;
+        static constexpr std::size_t NONCE_BYTES = 8;
+        static constexpr std::size_t MAC_BYTES = 12;
+        static constexpr std::size_t SIGNED_BYTES = ROUTING_BYTES + EXPIRY_BYTES + NONCE_BYTES;
+        static constexpr std::size_t SIZE = SIGNED_BYTES + MAC_BYTES;
+        // characters of a token
+        static constexpr std::size_t LENGTH = 2 * SIZE;
+
+    private:
+        typedef std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> DigestContext;
+
+        // SHA-256 already fed with the key xor ipad and opad, a MAC costs two context copies
+        DigestContext inner_{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        DigestContext outer_{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        std::chrono::seconds ttl_;
+        mutable std::atomic<uint64_t> minted_ = 0;
+        mutable std::atomic<uint64_t> rejected_ = 0;
+
+        static void putUint32(unsigned char* out, uint32_t value){
+            out[0] = static_cast<unsigned char>(value >> 24);
+            out[1] = static_cast<unsigned char>(value >> 16);
+            out[2] = static_cast<unsigned char>(value >> 8);
+            out[3] = static_cast<unsigned char>(value);
+        }
+
+        static uint32_t getUint32(const unsigned char* in){
+            return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | uint32_t(in[3]);
+        }
+
+        static uint32_t now(){
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+        }
+
+        void mac(const unsigned char* data, std::size_t size, unsigned char* out) const {
+            static thread_local DigestContext context{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int digestSize = 0;
+
+            EVP_MD_CTX_copy_ex(context.get(), inner_.get());
+            EVP_DigestUpdate(context.get(), data, size);
+            EVP_DigestFinal_ex(context.get(), digest, &digestSize);
+
+            EVP_MD_CTX_copy_ex(context.get(), outer_.get());
+            EVP_DigestUpdate(context.get(), digest, digestSize);
+            EVP_DigestFinal_ex(context.get(), digest, &digestSize);
+
+            std::memcpy(out, digest, MAC_BYTES);
+        }
+
+    public:
+        // An empty secret draws a random key, tokens then die with the process and no peer accepts them
+        TokenService(std::string_view secret, std::chrono::seconds ttl) : ttl_(ttl){
+            constexpr std::size_t BLOCK = 64;
+            std::array<unsigned char, BLOCK> key{}, pad{};
+
+            if(secret.empty()){
+                SecureRandom::fill(key.data(), 32);
+            }
+            else if(secret.size() > BLOCK){
+                unsigned int size = 0;
+                EVP_Digest(secret.data(), secret.size(), key.data(), &size, EVP_sha256(), nullptr);
+            }
+            else{
+                std::memcpy(key.data(), secret.data(), secret.size());
+            }
+
+            for(auto [context, padByte] : {std::pair{inner_.get(), 0x36}, std::pair{outer_.get(), 0x5c}}){
+                for(std::size_t i = 0; i < BLOCK; i++){
+                    pad[i] = key[i] ^ padByte;
+                }
+                if(!context || EVP_DigestInit_ex(context, EVP_sha256(), nullptr) != 1 ||
+                   EVP_DigestUpdate(context, pad.data(), pad.size()) != 1)
+                    throw std::runtime_error("token key setup failed");
+            }
+
+            OPENSSL_cleanse(key.data(), key.size());
+            OPENSSL_cleanse(pad.data(), pad.size());
+        }
+
+        TokenService(const TokenService&) = delete;
+        TokenService& operator=(const TokenService&) = delete;
+
+        std::string mint(uint32_t routingPoint) const {
+            std::array<unsigned char, SIZE> token;
+            putUint32(token.data(), routingPoint);
+            putUint32(token.data() + ROUTING_BYTES, now() + static_cast<uint32_t>(ttl_.count()));
+            SecureRandom::fill(token.data() + ROUTING_BYTES + EXPIRY_BYTES, NONCE_BYTES);
+            mac(token.data(), SIGNED_BYTES, token.data() + SIGNED_BYTES);
+
+            minted_++;
+            return Hex::encode(token);
+        }
+
+        // true for a token minted under this key which has not expired
+        bool verify(std::string_view token) const {
+            std::array<unsigned char, SIZE> decoded;
+            unsigned char expected[MAC_BYTES];
+
+            if(token.size() != LENGTH || !Hex::decode(token, decoded.data())){
+                rejected_++;
+                return false;
+            }
+
+            mac(decoded.data(), SIGNED_BYTES, expected);
+            if(CRYPTO_memcmp(expected, decoded.data() + SIGNED_BYTES, MAC_BYTES) != 0 ||
+               getUint32(decoded.data() + ROUTING_BYTES) <= now()){
+                rejected_++;
+                return false;
+            }
+
+            return true;
+        }
+
+        // The shard of a token, the low byte of its routing point. Any string maps to some shard,
+        // sessions restored under a previous token format included.
+        static std::size_t shard(std::string_view token, std::size_t shards){
+            if(token.size() < 2 * ROUTING_BYTES)
+                return 0;
+
+            auto low = (Hex::value(token[6]) << 4) | (Hex::value(token[7]) & 0xf);
+            return static_cast<std::size_t>(low & 0xff) % shards;
+        }
+
+        uint64_t minted() const {
+            return minted_;
+        }
+
+        // verifications which failed
+        uint64_t rejected() const {
+            return rejected_;
+        }
+    };
+}
+
+#endif //BANK_APP_TOKENSERVICE_H
@@ -0,0 +1,574 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_TRANSFERJOURNAL_H
+#define BANK_APP_TRANSFERJOURNAL_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <optional>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bank_app{
+    enum class TransferOutcome{
+        SUCCEEDED,
+        FAILED,
+        // started before a crash and never completed, BCA may or may not have executed it
+        IN_DOUBT,
+        // the key was used before for a different transfer
+        MISMATCH,
+        // the first attempt under the key is still running
+        IN_PROGRESS
+    };
+
+    // Append-only, memory mapped journal of transfers by client idempotency key. A transfer is recorded
+    // as started before BCA is called and as completed after, both durable before the caller goes on.
+    // Appends of concurrent transfers are made durable together by one fdatasync from the flusher thread.
+    // Completed keys are kept for the retention, clients retry within it. Compaction rewrites the keys
+    // still live into a new file which replaces the journal, keys in doubt stay until resolved.
+    class TransferJournal{
+        static constexpr char MAGIC[8] = {'B', 'N', 'K', 'J', 'R', 'N', 'L', '\0'};
+        // 2 added the time of every record, journals of version 1 are read and compacted into version 2
+        static constexpr uint32_t VERSION = 2;
+        static constexpr std::size_t INITIAL_SIZE = 1024 * 1024;
+        static constexpr std::size_t MAX_KEY_SIZE = 256;
+
+        enum RecordType : uint8_t{
+            BEGIN = 1,
+            SUCCEEDED = 2,
+            FAILED = 3,
+            // never sent to BCA, the key is free again
+            RELEASED = 4
+        };
+
+        struct FileHeader{
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved[13];
+        };
+
+        struct RecordHeaderV1{
+            uint32_t keyLength;
+            uint8_t type;
+            uint8_t reserved[3];
+            uint64_t fingerprint;
+            uint64_t checksum;
+        };
+
+        struct RecordHeader{
+            uint32_t keyLength;
+            uint8_t type;
+            uint8_t reserved[3];
+            uint64_t fingerprint;
+            // seconds since epoch
+            int64_t time;
+            uint64_t checksum;
+        };
+
+        struct Entry{
+            RecordType state;
+            uint64_t fingerprint;
+            // of the last record of the key, seconds since epoch
+            int64_t time;
+        };
+
+        std::string path_;
+        boost::interprocess::file_lock fileLock_;
+        std::unique_ptr<boost::interprocess::mapped_region> region_;
+#if !defined(_WIN32)
+        int fd_ = -1;
+#endif
+        std::size_t capacity_ = 0;
+        std::size_t end_ = sizeof(FileHeader);
+        uint32_t version_ = VERSION;
+        std::chrono::seconds retention_;
+        std::unordered_map<std::string, Entry> entries_;
+        // records in the file, against the live keys it tells when compaction pays
+        uint64_t fileRecords_ = 0;
+        // time of the oldest completed key, 0 when there is none
+        int64_t oldestCompleted_ = 0;
+        uint64_t compactions_ = 0;
+        // keys whose transfer is running in this process
+        std::unordered_set<std::string> inFlight_;
+        uint64_t appended_ = 0;
+        uint64_t durable_ = 0;
+        uint64_t syncs_ = 0;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable flushWakeup_;
+        std::condition_variable durableChanged_;
+        std::condition_variable completed_;
+        std::thread flusher_;
+
+        static uint64_t hash(const char* data, std::size_t size, uint64_t h = 14695981039346656037ull){
+            for(std::size_t i = 0; i < size; ++i){
+                h ^= static_cast<unsigned char>(data[i]);
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        // version 1 records carry no time, it is left out of their checksum
+        static uint64_t recordChecksum(const RecordHeader& header, const char* key, bool timed = true){
+            auto h = hash(reinterpret_cast<const char*>(&header.keyLength), sizeof(header.keyLength));
+            h = hash(reinterpret_cast<const char*>(&header.type), sizeof(header.type), h);
+            h = hash(reinterpret_cast<const char*>(&header.fingerprint), sizeof(header.fingerprint), h);
+            if(timed)
+                h = hash(reinterpret_cast<const char*>(&header.time), sizeof(header.time), h);
+            return hash(key, header.keyLength, h);
+        }
+
+        static std::size_t recordSize(std::size_t keyLength, std::size_t headerSize = sizeof(RecordHeader)){
+            return (headerSize + keyLength + 7) & ~std::size_t(7);
+        }
+
+        static int64_t now(){
+            return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        static void writeRecord(char* at, RecordType type, const std::string& key, uint64_t fingerprint, int64_t time){
+            RecordHeader header{};
+            header.keyLength = static_cast<uint32_t>(key.size());
+            header.type = type;
+            header.fingerprint = fingerprint;
+            header.time = time;
+            header.checksum = recordChecksum(header, key.data());
+
+            std::memcpy(at + sizeof(RecordHeader), key.data(), key.size());
+            std::memcpy(at, &header, sizeof(header));
+        }
+
+        bool expired(const Entry& entry, int64_t at) const {
+            return entry.state != BEGIN && entry.time + retention_.count() <= at;
+        }
+
+        void completedAt(int64_t time){
+            if(oldestCompleted_ == 0 || time < oldestCompleted_)
+                oldestCompleted_ = time;
+        }
+
+        char* data(){
+            return static_cast<char*>(region_->get_address());
+        }
+
+        void map(std::size_t size){
+            if(std::filesystem::file_size(path_) < size){
+                std::filesystem::resize_file(path_, size);
+            }
+
+            region_.reset();
+            boost::interprocess::file_mapping mapping(path_.c_str(), boost::interprocess::read_write);
+            region_ = std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_write, 0, size);
+            capacity_ = size;
+        }
+
+        void initialize(){
+            std::filesystem::resize_file(path_, 0);
+            map(INITIAL_SIZE);
+
+            auto fileHeader = reinterpret_cast<FileHeader*>(data());
+            std::memset(fileHeader, 0, sizeof(FileHeader));
+            std::memcpy(fileHeader->magic, MAGIC, sizeof(MAGIC));
+            fileHeader->version = VERSION;
+            region_->flush(0, sizeof(FileHeader), false);
+        }
+
+        // Rebuild the key states from the intact records, the first torn or empty record ends the journal.
+        // Records of version 1 count as written now, their keys are kept for one retention from here.
+        void recover(){
+            std::size_t offset = sizeof(FileHeader);
+            auto timed = version_ >= 2;
+            auto headerSize = timed ? sizeof(RecordHeader) : sizeof(RecordHeaderV1);
+            auto loadedAt = now();
+
+            while(offset + headerSize <= capacity_){
+                RecordHeader header{};
+                if(timed){
+                    std::memcpy(&header, data() + offset, sizeof(header));
+                }
+                else{
+                    RecordHeaderV1 old;
+                    std::memcpy(&old, data() + offset, sizeof(old));
+                    header = {old.keyLength, old.type, {}, old.fingerprint, loadedAt, old.checksum};
+                }
+
+                if(header.type < BEGIN || header.type > RELEASED || header.keyLength == 0 || header.keyLength > MAX_KEY_SIZE ||
+                   offset + recordSize(header.keyLength, headerSize) > capacity_)
+                    break;
+
+                auto key = data() + offset + headerSize;
+                if(recordChecksum(header, key, timed) != header.checksum)
+                    break;
+
+                if(header.type == RELEASED)
+                    entries_.erase(std::string(key, header.keyLength));
+                else
+                    entries_[std::string(key, header.keyLength)] = {static_cast<RecordType>(header.type), header.fingerprint, header.time};
+                if(header.type == SUCCEEDED || header.type == FAILED)
+                    completedAt(header.time);
+
+                offset += recordSize(header.keyLength, headerSize);
+                fileRecords_++;
+            }
+
+            // whatever follows is garbage from a torn append, clear it so it is never read as records
+            end_ = offset;
+            std::memset(data() + end_, 0, capacity_ - end_);
+            region_->flush(end_, capacity_ - end_, false);
+        }
+
+        uint64_t appendLocked(RecordType type, const std::string& key, uint64_t fingerprint, int64_t time){
+            auto size = recordSize(key.size());
+            if(end_ + size > capacity_)
+                map(capacity_ * 2);
+
+            writeRecord(data() + end_, type, key, fingerprint, time);
+            end_ += size;
+            fileRecords_++;
+
+            flushWakeup_.notify_one();
+            return ++appended_;
+        }
+
+        // Write the live keys into a new file, sync it and rename it over the journal. Completed keys past
+        // the retention are dropped. Everything appended before is durable first, the flusher is then idle.
+        void compactLocked(std::unique_lock<std::mutex>& lock){
+#if !defined(_WIN32)
+            waitDurable(lock, appended_);
+
+            auto at = now();
+            oldestCompleted_ = 0;
+            std::size_t size = sizeof(FileHeader);
+            for(auto entry = entries_.begin(); entry != entries_.end();){
+                if(expired(entry->second, at) && !inFlight_.contains(entry->first)){
+                    entry = entries_.erase(entry);
+                    continue;
+                }
+                if(entry->second.state != BEGIN)
+                    completedAt(entry->second.time);
+                size += recordSize(entry->first.size());
+                ++entry;
+            }
+
+            auto compactPath = path_ + ".compact";
+            std::ofstream(compactPath, std::ios::binary | std::ios::trunc);
+            std::filesystem::permissions(compactPath, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+            auto capacity = std::max(INITIAL_SIZE, 2 * size);
+            std::filesystem::resize_file(compactPath, capacity);
+
+            // the mapping closes its descriptor right away, that would drop a lock taken before
+            std::unique_ptr<boost::interprocess::mapped_region> region;
+            {
+                boost::interprocess::file_mapping mapping(compactPath.c_str(), boost::interprocess::read_write);
+                region = std::make_unique<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_write, 0, capacity);
+            }
+            auto out = static_cast<char*>(region->get_address());
+
+            FileHeader fileHeader{};
+            std::memcpy(fileHeader.magic, MAGIC, sizeof(MAGIC));
+            fileHeader.version = VERSION;
+            std::memcpy(out, &fileHeader, sizeof(fileHeader));
+
+            std::size_t end = sizeof(FileHeader);
+            for(auto& [key, entry] : entries_){
+                writeRecord(out + end, entry.state, key, entry.fingerprint, entry.time);
+                end += recordSize(key.size());
+            }
+
+            auto fd = ::open(compactPath.c_str(), O_RDWR | O_CLOEXEC);
+            if(fd < 0 || ::fdatasync(fd) != 0 ||
+               ::rename(compactPath.c_str(), path_.c_str()) != 0){
+                if(fd >= 0)
+                    ::close(fd);
+                std::filesystem::remove(compactPath);
+                throw std::runtime_error("transfer journal " + path_ + " could not be compacted");
+            }
+
+            // the rename itself is durable once the directory is
+            auto directory = std::filesystem::absolute(path_).parent_path();
+            auto directoryFd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+            if(directoryFd >= 0){
+                ::fsync(directoryFd);
+                ::close(directoryFd);
+            }
+
+            ::close(fd_);
+            fd_ = fd;
+            region_ = std::move(region);
+            capacity_ = capacity;
+            end_ = end;
+            version_ = VERSION;
+            fileRecords_ = entries_.size();
+            compactions_++;
+
+            // the lock of the old file went with it, take it on the new one
+            fileLock_ = boost::interprocess::file_lock(path_.c_str());
+            fileLock_.try_lock();
+#endif
+        }
+
+        void waitDurable(std::unique_lock<std::mutex>& lock, uint64_t sequence){
+            durableChanged_.wait(lock, [&]{ return durable_ >= sequence || stopping_; });
+        }
+
+        void flush(){
+            std::unique_lock lock(mutex_);
+
+            while(!stopping_){
+                flushWakeup_.wait(lock, [this]{ return appended_ > durable_ || stopping_; });
+                if(stopping_)
+                    break;
+
+                // everything appended so far goes out with this sync, later appends wait for the next one
+                auto target = appended_;
+#if defined(_WIN32)
+                region_->flush(0, end_, false);
+#else
+                lock.unlock();
+                ::fdatasync(fd_);
+                lock.lock();
+#endif
+                durable_ = target;
+                syncs_++;
+                durableChanged_.notify_all();
+            }
+        }
+
+    public:
+        TransferJournal(std::string path, std::chrono::seconds retention = std::chrono::hours(72))
+                : path_(std::move(path)), retention_(retention){
+            if(!std::filesystem::exists(path_)){
+                std::ofstream(path_, std::ios::binary);
+                std::filesystem::permissions(path_, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+            }
+
+            fileLock_ = boost::interprocess::file_lock(path_.c_str());
+            if(!fileLock_.try_lock()){
+                throw std::runtime_error("transfer journal " + path_ + " is locked by another process");
+            }
+
+            auto fileSize = std::filesystem::file_size(path_);
+            bool valid = false;
+
+            if(fileSize >= INITIAL_SIZE){
+                FileHeader existing{};
+                std::ifstream(path_, std::ios::binary).read(reinterpret_cast<char*>(&existing), sizeof(existing));
+
+                valid = std::memcmp(existing.magic, MAGIC, sizeof(MAGIC)) == 0 && existing.version >= 1 && existing.version <= VERSION;
+                if(valid){
+                    version_ = existing.version;
+                    map(fileSize);
+                }
+            }
+
+            // unlike the session snapshot an unreadable journal is not thrown away, it may hold transfers in doubt
+            if(!valid && fileSize > 0)
+                throw std::runtime_error("transfer journal " + path_ + " has an unknown layout");
+
+            if(!valid)
+                initialize();
+
+            recover();
+
+#if !defined(_WIN32)
+            fd_ = ::open(path_.c_str(), O_RDWR | O_CLOEXEC);
+            if(fd_ < 0)
+                throw std::runtime_error("transfer journal " + path_ + " can not be opened");
+#endif
+
+            // an old layout is converted right away, records are never appended to it
+            if(version_ != VERSION){
+                std::unique_lock lock(mutex_);
+                compactLocked(lock);
+            }
+
+            flusher_ = std::thread([this]{ flush(); });
+        }
+
+        ~TransferJournal(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            flushWakeup_.notify_all();
+            durableChanged_.notify_all();
+            completed_.notify_all();
+            flusher_.join();
+
+#if !defined(_WIN32)
+            ::fdatasync(fd_);
+            ::close(fd_);
+#else
+            region_->flush(0, end_, false);
+#endif
+        }
+
+        TransferJournal(const TransferJournal&) = delete;
+        TransferJournal& operator=(const TransferJournal&) = delete;
+
+        // stable digest of the transfer fields, tells a retry from a different transfer under the same key
+        static uint64_t fingerprint(std::string_view transfer){
+            return hash(transfer.data(), transfer.size());
+        }
+
+        // Claim a key before calling BCA. Returns nullopt when the caller owns the transfer and must
+        // complete(), release() or abandon() it, otherwise the outcome recorded for the key. A retry
+        // arriving while the first attempt still runs waits for it until the given time, IN_PROGRESS after.
+        std::optional<TransferOutcome> begin(const std::string& key, uint64_t transferFingerprint,
+                                             std::chrono::steady_clock::time_point until){
+            if(key.empty() || key.size() > MAX_KEY_SIZE)
+                throw std::invalid_argument("idempotency key must be 1 to 256 bytes");
+
+            std::unique_lock lock(mutex_);
+            if(!completed_.wait_until(lock, until, [&]{ return !inFlight_.contains(key) || stopping_; }))
+                return TransferOutcome::IN_PROGRESS;
+
+            auto found = entries_.find(key);
+            if(found != entries_.end()){
+                if(found->second.fingerprint != transferFingerprint)
+                    return TransferOutcome::MISMATCH;
+
+                switch(found->second.state){
+                    case SUCCEEDED:
+                        return TransferOutcome::SUCCEEDED;
+                    case FAILED:
+                        return TransferOutcome::FAILED;
+                    default:
+                        return TransferOutcome::IN_DOUBT;
+                }
+            }
+
+            auto at = now();
+            entries_[key] = {BEGIN, transferFingerprint, at};
+            inFlight_.insert(key);
+
+            auto sequence = appendLocked(BEGIN, key, transferFingerprint, at);
+            waitDurable(lock, sequence);
+
+            return std::nullopt;
+        }
+
+        void complete(const std::string& key, bool succeeded){
+            std::unique_lock lock(mutex_);
+            auto found = entries_.find(key);
+            if(found == entries_.end() || !inFlight_.contains(key))
+                return;
+
+            auto state = succeeded ? SUCCEEDED : FAILED;
+            auto at = now();
+            auto sequence = appendLocked(state, key, found->second.fingerprint, at);
+            waitDurable(lock, sequence);
+
+            found->second = {state, found->second.fingerprint, at};
+            completedAt(at);
+            inFlight_.erase(key);
+            completed_.notify_all();
+        }
+
+        // The transfer never reached BCA, e.g. the session was gone or too busy. A retry runs it anew.
+        void release(const std::string& key){
+            std::unique_lock lock(mutex_);
+            auto found = entries_.find(key);
+            if(found == entries_.end() || !inFlight_.contains(key))
+                return;
+
+            auto sequence = appendLocked(RELEASED, key, found->second.fingerprint, now());
+            waitDurable(lock, sequence);
+
+            entries_.erase(found);
+            inFlight_.erase(key);
+            completed_.notify_all();
+        }
+
+        // BCA may or may not have executed the transfer. The key stays begun, retries are answered IN_DOUBT.
+        void abandon(const std::string& key){
+            std::lock_guard lock(mutex_);
+            if(inFlight_.erase(key) > 0)
+                completed_.notify_all();
+        }
+
+        // Record the outcome of a transfer left in doubt, once someone checked it with BCA. False when the
+        // key is not in doubt, unknown, completed already or still running.
+        bool resolve(const std::string& key, bool succeeded){
+            std::unique_lock lock(mutex_);
+            auto found = entries_.find(key);
+            if(found == entries_.end() || found->second.state != BEGIN || inFlight_.contains(key))
+                return false;
+
+            auto state = succeeded ? SUCCEEDED : FAILED;
+            auto at = now();
+            auto sequence = appendLocked(state, key, found->second.fingerprint, at);
+            waitDurable(lock, sequence);
+
+            found->second = {state, found->second.fingerprint, at};
+            completedAt(at);
+            return true;
+        }
+
+        // the keys whose transfer may or may not have been executed
+        std::vector<std::string> inDoubt(){
+            std::lock_guard lock(mutex_);
+            std::vector<std::string> keys;
+            for(auto& [key, entry] : entries_){
+                if(entry.state == BEGIN && !inFlight_.contains(key))
+                    keys.push_back(key);
+            }
+            std::sort(keys.begin(), keys.end());
+            return keys;
+        }
+
+        // Compact when completed keys outlived the retention or most records in the file are dead. Cheap
+        // otherwise, meant to be called periodically. Transfers wait while it runs.
+        void maintain(){
+            std::unique_lock lock(mutex_);
+            auto expiredKeys = oldestCompleted_ != 0 && oldestCompleted_ + retention_.count() <= now();
+            auto sparse = fileRecords_ > 1024 && fileRecords_ > 2 * entries_.size();
+            if(expiredKeys || sparse)
+                compactLocked(lock);
+        }
+
+        std::size_t size(){
+            std::lock_guard lock(mutex_);
+            return entries_.size();
+        }
+
+        uint64_t compactions(){
+            std::lock_guard lock(mutex_);
+            return compactions_;
+        }
+
+        uint64_t records(){
+            std::lock_guard lock(mutex_);
+            return appended_;
+        }
+
+        uint64_t syncs(){
+            std::lock_guard lock(mutex_);
+            return syncs_;
+        }
+    };
+}
+
+#endif //BANK_APP_TRANSFERJOURNAL_H
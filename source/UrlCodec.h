@@ -0,0 +1,293 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_URLCODEC_H
+#define BANK_APP_URLCODEC_H
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <initializer_list>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace bank_app{
+    // Characters written as they are, everything else is percent encoded. Letters and digits are always safe.
+    class UrlSafeSet{
+        static constexpr std::size_t MAX_VECTOR_EXTRAS = 8;
+
+        std::array<bool, 256> table_{};
+        std::array<char, MAX_VECTOR_EXTRAS> extras_{};
+        std::size_t extraCount_ = 0;
+        bool vectorizable_ = true;
+
+    public:
+        constexpr UrlSafeSet(std::string_view extras = ""){
+            for(int c = '0'; c <= '9'; c++) table_[c] = true;
+            for(int c = 'A'; c <= 'Z'; c++) table_[c] = true;
+            for(int c = 'a'; c <= 'z'; c++) table_[c] = true;
+
+            for(auto c : extras){
+                auto index = static_cast<unsigned char>(c);
+                if(table_[index])
+                    continue;
+
+                table_[index] = true;
+                if(extraCount_ < MAX_VECTOR_EXTRAS)
+                    extras_[extraCount_++] = c;
+                else
+                    vectorizable_ = false;
+            }
+        }
+
+        constexpr bool operator()(char c) const {
+            return table_[static_cast<unsigned char>(c)];
+        }
+
+        constexpr std::size_t extraCount() const { return extraCount_; }
+        constexpr char extra(std::size_t i) const { return extras_[i]; }
+        constexpr bool vectorizable() const { return vectorizable_; }
+    };
+
+    inline constexpr UrlSafeSet URL_ALNUM{};
+    // application/x-www-form-urlencoded keeps these besides letters and digits
+    inline constexpr UrlSafeSet URL_FORM{"*-._"};
+
+    namespace url_detail{
+        inline constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+        inline constexpr std::array<int8_t, 256> HEX_VALUES = []{
+            std::array<int8_t, 256> values{};
+            for(auto& value : values) value = -1;
+            for(int c = '0'; c <= '9'; c++) values[c] = static_cast<int8_t>(c - '0');
+            for(int c = 'A'; c <= 'F'; c++) values[c] = static_cast<int8_t>(c - 'A' + 10);
+            for(int c = 'a'; c <= 'f'; c++) values[c] = static_cast<int8_t>(c - 'a' + 10);
+            return values;
+        }();
+
+        constexpr char* escape(char* out, char c){
+            auto byte = static_cast<unsigned char>(c);
+            out[0] = '%';
+            out[1] = HEX_DIGITS[byte >> 4];
+            out[2] = HEX_DIGITS[byte & 15];
+            return out + 3;
+        }
+
+#if defined(__AVX2__)
+        constexpr std::size_t BLOCK = 32;
+        typedef uint32_t BlockMask;
+
+        // bit set for every byte of the block which is in the safe set
+        inline BlockMask safeMask(const char* data, const UrlSafeSet& set){
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            auto inRange = [&](char low, char high){
+                return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(low - 1))),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), v));
+            };
+
+            auto safe = _mm256_or_si256(_mm256_or_si256(inRange('0', '9'), inRange('A', 'Z')), inRange('a', 'z'));
+            for(std::size_t i = 0; i < set.extraCount(); i++){
+                safe = _mm256_or_si256(safe, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(set.extra(i))));
+            }
+            return static_cast<BlockMask>(_mm256_movemask_epi8(safe));
+        }
+
+        // bit set for every '%' and '+' of the block
+        inline BlockMask escapeMask(const char* data){
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            return static_cast<BlockMask>(_mm256_movemask_epi8(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('%')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')))));
+        }
+#elif defined(__SSE2__)
+        constexpr std::size_t BLOCK = 16;
+        typedef uint32_t BlockMask;
+
+        inline BlockMask safeMask(const char* data, const UrlSafeSet& set){
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            auto inRange = [&](char low, char high){
+                return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(low - 1))),
+                                     _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(high + 1))));
+            };
+
+            auto safe = _mm_or_si128(_mm_or_si128(inRange('0', '9'), inRange('A', 'Z')), inRange('a', 'z'));
+            for(std::size_t i = 0; i < set.extraCount(); i++){
+                safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8(set.extra(i))));
+            }
+            return static_cast<BlockMask>(_mm_movemask_epi8(safe));
+        }
+
+        inline BlockMask escapeMask(const char* data){
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            return static_cast<BlockMask>(_mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('%')), _mm_cmpeq_epi8(v, _mm_set1_epi8('+')))));
+        }
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+        constexpr BlockMask FULL_BLOCK = BLOCK == 32 ? ~BlockMask(0) : (BlockMask(1) << BLOCK) - 1;
+#endif
+    }
+
+    // Percent encoding and decoding. With SSE2/AVX2 runs of safe bytes are found a block at a time
+    // and copied as they are, the tables handle the bytes around them.
+    class UrlCodec{
+    public:
+        static std::size_t encodedSize(std::string_view value, const UrlSafeSet& set = URL_ALNUM){
+            std::size_t size = value.size();
+            std::size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+            if(set.vectorizable()){
+                for(; i + url_detail::BLOCK <= value.size(); i += url_detail::BLOCK){
+                    auto unsafe = ~url_detail::safeMask(value.data() + i, set) & url_detail::FULL_BLOCK;
+                    size += 2 * static_cast<std::size_t>(__builtin_popcount(unsafe));
+                }
+            }
+#endif
+            for(; i < value.size(); i++){
+                if(!set(value[i]))
+                    size += 2;
+            }
+
+            return size;
+        }
+
+        // Write the encoded value to out, which holds at least encodedSize(value) bytes
+        static char* encodeTo(char* out, std::string_view value, const UrlSafeSet& set = URL_ALNUM){
+            std::size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+            if(set.vectorizable()){
+                while(i + url_detail::BLOCK <= value.size()){
+                    auto safe = url_detail::safeMask(value.data() + i, set);
+                    if(safe == url_detail::FULL_BLOCK){
+                        std::memcpy(out, value.data() + i, url_detail::BLOCK);
+                        out += url_detail::BLOCK;
+                        i += url_detail::BLOCK;
+                        continue;
+                    }
+
+                    // copy the safe run in front of the first unsafe byte, then escape it
+                    auto run = static_cast<std::size_t>(__builtin_ctz(~safe));
+                    std::memcpy(out, value.data() + i, run);
+                    out = url_detail::escape(out + run, value[i + run]);
+                    i += run + 1;
+                }
+            }
+#endif
+            for(; i < value.size(); i++){
+                if(set(value[i]))
+                    *out++ = value[i];
+                else
+                    out = url_detail::escape(out, value[i]);
+            }
+
+            return out;
+        }
+
+        static std::string encode(std::string_view value, const UrlSafeSet& set = URL_ALNUM){
+            std::string result(encodedSize(value, set), '\0');
+            encodeTo(result.data(), value, set);
+
+            return result;
+        }
+
+        // '+' becomes a space, a '%' without two hex digits after it is kept as it is
+        static std::string decode(std::string_view value){
+            std::string result(value.size(), '\0');
+            auto out = result.data();
+            std::size_t i = 0;
+
+            while(i < value.size()){
+#if defined(__AVX2__) || defined(__SSE2__)
+                if(i + url_detail::BLOCK <= value.size()){
+                    auto escapes = url_detail::escapeMask(value.data() + i);
+                    auto run = escapes == 0 ? url_detail::BLOCK : static_cast<std::size_t>(__builtin_ctz(escapes));
+
+                    std::memcpy(out, value.data() + i, run);
+                    out += run;
+                    i += run;
+                    if(run == url_detail::BLOCK)
+                        continue;
+                }
+#endif
+                auto ch = value[i];
+                if(ch == '+'){
+                    *out++ = ' ';
+                    i++;
+                }
+                else if(ch == '%' && i + 2 < value.size()
+                        && url_detail::HEX_VALUES[static_cast<unsigned char>(value[i + 1])] >= 0
+                        && url_detail::HEX_VALUES[static_cast<unsigned char>(value[i + 2])] >= 0){
+                    *out++ = static_cast<char>(url_detail::HEX_VALUES[static_cast<unsigned char>(value[i + 1])] << 4
+                                               | url_detail::HEX_VALUES[static_cast<unsigned char>(value[i + 2])]);
+                    i += 3;
+                }
+                else{
+                    *out++ = ch;
+                    i++;
+                }
+            }
+
+            result.resize(out - result.data());
+            return result;
+        }
+    };
+
+    // Form field name encoded at compile time, see formKey
+    template<std::size_t N>
+    struct UrlFormKey{
+        char data[(N - 1) * 3 + 1]{};
+        std::size_t size = 0;
+
+        consteval UrlFormKey(const char (&key)[N]){
+            for(std::size_t i = 0; i + 1 < N; i++){
+                if(URL_FORM(key[i]))
+                    data[size++] = key[i];
+                else
+                    size = url_detail::escape(data + size, key[i]) - data;
+            }
+        }
+    };
+
+    template<UrlFormKey Key>
+    inline constexpr std::string_view formKey{Key.data, Key.size};
+
+    // application/x-www-form-urlencoded body written in one pass into a buffer sized up front
+    class UrlForm{
+    public:
+        struct Field{
+            // already encoded, usually a formKey
+            std::string_view key;
+            std::string_view value;
+        };
+
+        static std::string build(std::initializer_list<Field> fields, const UrlSafeSet& valueSet = URL_FORM){
+            std::size_t size = fields.size() > 0 ? fields.size() - 1 : 0;
+            for(auto& field : fields){
+                size += field.key.size() + 1 + UrlCodec::encodedSize(field.value, valueSet);
+            }
+
+            std::string result(size, '\0');
+            auto out = result.data();
+            for(auto& field : fields){
+                if(out != result.data())
+                    *out++ = '&';
+
+                std::memcpy(out, field.key.data(), field.key.size());
+                out += field.key.size();
+                *out++ = '=';
+                out = UrlCodec::encodeTo(out, field.value, valueSet);
+            }
+
+            return result;
+        }
+    };
+}
+
+#endif //BANK_APP_URLCODEC_H
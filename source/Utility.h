@@ -5,9 +5,11 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <cstdlib>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string_regex.hpp>
-#include "UUIDGenerator.h"
 
 namespace bank_app {
 	using namespace std;
@@ -21,6 +23,41 @@ namespace bank_app {
 			return result;
 		}
 
+		// views into text, allocated from the given resource (the request arena in the handlers)
+		static pmr::vector<string_view> split(string_view text, string_view separator, pmr::memory_resource* resource) {
+			pmr::vector<string_view> result(resource);
+
+			size_t start = 0;
+			for (auto found = text.find(separator); found != string_view::npos; found = text.find(separator, start)) {
+				result.push_back(text.substr(start, found - start));
+				start = found + separator.size();
+			}
+			result.push_back(text.substr(start));
+
+			return result;
+		}
+
+		template<class TextList>
+		static pmr::string join(const TextList& textList, string_view separator, pmr::memory_resource* resource) {
+			pmr::string result(resource);
+
+			size_t size = 0;
+			for (const auto& text : textList) {
+				size += string_view(text).size() + separator.size();
+			}
+			result.reserve(size);
+
+			bool first = true;
+			for (const auto& text : textList) {
+				if (!first)
+					result.append(separator);
+				result.append(string_view(text));
+				first = false;
+			}
+
+			return result;
+		}
+
 		static string join(vector<string>& textList, string separator) {
 			stringstream ss;
 			for (const auto& text : textList) {
@@ -33,6 +70,12 @@ namespace bank_app {
 
 			return ss.str();
 		}
+
+		static string getEnv(const char* name, string defaultValue = "") {
+			auto value = std::getenv(name);
+
+			return value ? string(value) : defaultValue;
+		}
 	};
 }
 #endif
\ No newline at end of file
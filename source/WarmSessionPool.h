@@ -0,0 +1,179 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#ifndef BANK_APP_WARMSESSIONPOOL_H
+#define BANK_APP_WARMSESSIONPOOL_H
+
+#include <deque>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "BcaBank.h"
+#include "Logger.h"
+
+namespace bank_app{
+    struct WarmSessionPoolConfig{
+        std::size_t minSize = 1;
+        std::size_t maxSize = 32;
+        // the pool keeps enough sessions for the logins expected over this window
+        std::chrono::seconds horizon{5};
+        // warm sessions older than this are dropped, BCA closes idle connections
+        std::chrono::seconds ttl{20};
+        std::chrono::milliseconds tick{1000};
+        // weight of the last tick in the login rate average
+        double smoothing = 0.2;
+    };
+
+    struct WarmSessionPoolGauges{
+        std::size_t idle = 0;
+        std::size_t target = 0;
+        double loginRate = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t expired = 0;
+    };
+
+    // Anonymous BCA sessions connected and holding the pre-login cookies, kept ready by a background
+    // thread so a login only has to post the credentials. The pool follows the observed login rate.
+    class WarmSessionPool{
+    public:
+        // builds a session and prepares its login, runs on the pool thread
+        typedef std::function<std::shared_ptr<BcaBank>()> SessionFactory;
+
+    private:
+        WarmSessionPoolConfig config_;
+        SessionFactory factory_;
+        std::deque<std::shared_ptr<BcaBank>> idle_;
+        std::size_t target_;
+        double loginRate_ = 0;
+        uint64_t acquiredThisTick_ = 0;
+        uint64_t hits_ = 0, misses_ = 0, expired_ = 0;
+        bool stopping_ = false;
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::thread worker_;
+
+        bool fresh(BcaBank& bank, std::chrono::steady_clock::time_point now){
+            auto preparedAt = bank.loginPreparedAt();
+            return preparedAt && now - *preparedAt < config_.ttl;
+        }
+
+        void adaptLocked(){
+            std::chrono::duration<double> tick = config_.tick;
+            auto rate = acquiredThisTick_ / tick.count();
+            acquiredThisTick_ = 0;
+
+            loginRate_ = config_.smoothing * rate + (1 - config_.smoothing) * loginRate_;
+            auto wanted = static_cast<std::size_t>(std::ceil(loginRate_ * config_.horizon.count()));
+            target_ = std::clamp(wanted, config_.minSize, config_.maxSize);
+        }
+
+        // drop expired sessions and the ones above the target, oldest first
+        std::deque<std::shared_ptr<BcaBank>> trimLocked(){
+            std::deque<std::shared_ptr<BcaBank>> dropped;
+            auto now = std::chrono::steady_clock::now();
+
+            while(!idle_.empty() && (idle_.size() > target_ || !fresh(*idle_.front(), now))){
+                if(fresh(*idle_.front(), now) == false)
+                    expired_++;
+
+                dropped.push_back(std::move(idle_.front()));
+                idle_.pop_front();
+            }
+
+            return dropped;
+        }
+
+        void run(){
+            std::unique_lock lock(mutex_);
+            auto nextTick = std::chrono::steady_clock::now() + config_.tick;
+
+            while(!stopping_){
+                if(std::chrono::steady_clock::now() >= nextTick){
+                    adaptLocked();
+                    nextTick += config_.tick;
+                }
+
+                auto dropped = trimLocked();
+                auto missing = idle_.size() < target_;
+
+                // closing and opening sessions talks to BCA, never under the lock
+                lock.unlock();
+                dropped.clear();
+
+                std::shared_ptr<BcaBank> session;
+                if(missing){
+                    try{
+                        session = factory_();
+                    }
+                    catch(std::exception& err){
+                        Logger::warn("warm_session", err.what());
+                    }
+                }
+                lock.lock();
+
+                if(session){
+                    idle_.push_back(std::move(session));
+                    continue;
+                }
+
+                wakeup_.wait_until(lock, nextTick, [this]{ return stopping_; });
+            }
+        }
+
+    public:
+        WarmSessionPool(SessionFactory factory, WarmSessionPoolConfig config = {})
+                : config_(config), factory_(std::move(factory)), target_(config.minSize){
+            worker_ = std::thread([this]{ run(); });
+        }
+
+        ~WarmSessionPool(){
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            worker_.join();
+        }
+
+        // a warm session ready to log in, nullptr when the pool is empty
+        std::shared_ptr<BcaBank> acquire(){
+            // declared ahead of the lock, expired sessions close their connection once it is released
+            std::deque<std::shared_ptr<BcaBank>> dropped;
+            std::lock_guard lock(mutex_);
+            acquiredThisTick_++;
+
+            auto now = std::chrono::steady_clock::now();
+            while(!idle_.empty()){
+                auto session = std::move(idle_.back());
+                idle_.pop_back();
+
+                if(fresh(*session, now)){
+                    hits_++;
+                    wakeup_.notify_one();
+                    return session;
+                }
+                expired_++;
+                dropped.push_back(std::move(session));
+            }
+
+            misses_++;
+            wakeup_.notify_one();
+            return nullptr;
+        }
+
+        WarmSessionPoolGauges gauges(){
+            std::lock_guard lock(mutex_);
+            return {idle_.size(), target_, loginRate_, hits_, misses_, expired_};
+        }
+    };
+}
+
+#endif //BANK_APP_WARMSESSIONPOOL_H
@@ -0,0 +1,65 @@
+//
+// Created by dandy on 19/10/2026.
+//
+
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include "../source/StatementTable.h"
+
+namespace{
+    int failures = 0;
+
+    void expect(std::string_view input, std::optional<int64_t> expected, bool* credit = nullptr, bool requireFraction = false){
+        auto parsed = bank_app::StatementTable::parseAmount(input, credit, requireFraction);
+        if(parsed == expected)
+            return;
+
+        failures++;
+        std::cerr << "parseAmount(\"" << input << "\"): expected "
+                  << (expected ? std::to_string(*expected) : "nullopt") << ", got "
+                  << (parsed ? std::to_string(*parsed) : "nullopt") << std::endl;
+    }
+}
+
+int main(){
+    // a whole amount takes two more digits for the fraction, 14 digits is the most that fits
+    expect("12345678901234", 1234567890123400);
+    expect("123456789012345", std::nullopt);
+    expect("1234567890123456", std::nullopt);
+    expect("12345678901234567", std::nullopt);
+    expect("123456789012345678", std::nullopt);
+    expect("1234567890123456789", std::nullopt);
+
+    // with a fraction all 16 digits are there already
+    expect("12345678901234,56", 1234567890123456);
+    expect("123456789012345,67", std::nullopt);
+    expect("1234567890123456,78", std::nullopt);
+
+    expect("Rp. 50.000", 5000000);
+    expect("Rp 1,234,567.89", 123456789);
+    expect("10000.00 CR", 1000000);
+    expect("-", std::nullopt);
+    expect("", std::nullopt);
+    expect("   ", std::nullopt);
+    expect("12a", std::nullopt);
+    expect("-1.500,25", -150025);
+    expect("1.500", 150000, nullptr, false);
+    expect("1.500", std::nullopt, nullptr, true);
+
+    bool credit = false;
+    expect("1.234.567,00 CR", 123456700, &credit);
+    if(!credit){
+        failures++;
+        std::cerr << "parseAmount(\"1.234.567,00 CR\"): expected a credit" << std::endl;
+    }
+    expect("25.000,00 DB", 2500000, &credit);
+    if(credit){
+        failures++;
+        std::cerr << "parseAmount(\"25.000,00 DB\"): expected a debit" << std::endl;
+    }
+
+    if(failures == 0)
+        std::cout << "StatementTable: all checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}